@@ -0,0 +1,151 @@
+// Request/response benchmark comparing the epoll and io_uring event loop
+// backends. A client keeps a window of requests in flight to a server
+// loop that echoes every datagram; the benchmark reports throughput,
+// round-trip latency percentiles and system calls made by the server per
+// request.
+
+#include "include/transport.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace kademlia;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    IOBackend backend;
+    double rpcsPerSecond;
+    double p50Us;
+    double p99Us;
+    double syscallsPerRpc;
+    size_t completed;
+};
+
+Result run(IOBackend backend, size_t rpcs, size_t window, size_t payloadSize) {
+    Result result{backend, 0, 0, 0, 0, 0};
+
+    UDPTransport server;
+    UDPTransport client;
+    if (!server.open(0) || !client.open(0)) {
+        std::cerr << "failed to open sockets" << std::endl;
+        return result;
+    }
+
+    // The server sends every datagram straight back
+    server.startLoop(backend, 32,
+        [&server](const Datagram& datagram) {
+            server.send(datagram.fromIP, datagram.fromPort, datagram.data, datagram.length);
+        },
+        nullptr, 10);
+    result.backend = server.getBackend();
+
+    std::vector<uint8_t> request(std::max<size_t>(payloadSize, sizeof(uint64_t)), 0);
+    std::vector<double> latencies;
+    latencies.reserve(rpcs);
+
+    ReceiveBatch batch(32, request.size());
+    size_t sent = 0;
+    size_t timeouts = 0;
+
+    auto sendRequest = [&]() {
+        uint64_t now = static_cast<uint64_t>(Clock::now().time_since_epoch().count());
+        memcpy(request.data(), &now, sizeof(now));
+        client.send("127.0.0.1", server.getPort(), request.data(), request.size());
+        sent++;
+    };
+
+    TransportStats before = server.getStats();
+    auto start = Clock::now();
+
+    {
+        SendBatch sends(client, window);
+        for (size_t i = 0; i < window && sent < rpcs; ++i) {
+            sendRequest();
+        }
+    }
+
+    while (latencies.size() + timeouts < sent) {
+        size_t count = client.receiveBatch(batch, 1000);
+
+        // A lost datagram frees its window slot after the timeout
+        if (count == 0) {
+            timeouts = sent - latencies.size();
+        }
+
+        SendBatch sends(client, window);
+        auto now = Clock::now();
+
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t stamp = 0;
+            memcpy(&stamp, batch[i].data, sizeof(stamp));
+            Clock::time_point sentAt{Clock::duration(static_cast<Clock::rep>(stamp))};
+            latencies.push_back(std::chrono::duration<double, std::micro>(now - sentAt).count());
+
+            if (sent < rpcs) {
+                sendRequest();
+            }
+        }
+
+        if (count == 0) {
+            while (sent < rpcs && sent - latencies.size() - timeouts < window) {
+                sendRequest();
+            }
+        }
+    }
+
+    auto end = Clock::now();
+    TransportStats after = server.getStats();
+    server.stopLoop();
+
+    std::sort(latencies.begin(), latencies.end());
+    result.completed = latencies.size();
+    if (!latencies.empty()) {
+        result.p50Us = latencies[latencies.size() / 2];
+        result.p99Us = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+        result.rpcsPerSecond = static_cast<double>(latencies.size()) / std::chrono::duration<double>(end - start).count();
+        result.syscallsPerRpc = static_cast<double>(after.syscalls - before.syscalls) / static_cast<double>(latencies.size());
+    }
+    return result;
+}
+
+void report(const char* requested, const Result& result) {
+    std::cout << std::left << std::setw(10) << requested
+              << std::setw(10) << (result.backend == IOBackend::IO_URING ? "io_uring" : "epoll")
+              << std::right << std::fixed << std::setprecision(0)
+              << std::setw(12) << result.rpcsPerSecond
+              << std::setprecision(1)
+              << std::setw(10) << result.p50Us
+              << std::setw(10) << result.p99Us
+              << std::setprecision(3)
+              << std::setw(14) << result.syscallsPerRpc
+              << std::setw(10) << result.completed << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t rpcs = argc > 1 ? std::stoul(argv[1]) : 200000;
+    size_t window = argc > 2 ? std::stoul(argv[2]) : 16;
+    size_t payloadSize = argc > 3 ? std::stoul(argv[3]) : 128;
+
+    std::cout << rpcs << " requests of " << payloadSize << " bytes, window " << window << std::endl;
+    std::cout << std::left << std::setw(10) << "requested"
+              << std::setw(10) << "backend"
+              << std::right << std::setw(12) << "rpc/s"
+              << std::setw(10) << "p50 us"
+              << std::setw(10) << "p99 us"
+              << std::setw(14) << "syscalls/rpc"
+              << std::setw(10) << "done" << std::endl;
+
+    report("epoll", run(IOBackend::EPOLL, rpcs, window, payloadSize));
+    report("io_uring", run(IOBackend::IO_URING, rpcs, window, payloadSize));
+
+    return 0;
+}
@@ -0,0 +1,165 @@
+// Throughput benchmark for large messages sent in acknowledged fragments.
+// Two UDP transports on the loopback interface each run a BulkTransfer;
+// the sender sends one message at a time and waits for the receiver to
+// reassemble it. An optional loss rate drops fragments and acknowledgements
+// in both directions to exercise selective retransmission.
+
+#include "include/bulk_transfer.h"
+#include "include/utils.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace kademlia;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Drops datagrams at random before they reach the socket
+class LossySender {
+public:
+    LossySender(UDPTransport& transport, double lossRate, uint64_t seed)
+        : transport_(transport), lossRate_(lossRate), rng_(seed) {}
+
+    bool operator()(uint32_t ip, uint16_t port, const uint8_t* data, size_t length) {
+        if (lossRate_ > 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (std::uniform_real_distribution<double>(0.0, 1.0)(rng_) < lossRate_) {
+                return true;
+            }
+        }
+        return transport_.send(ip, port, data, length);
+    }
+
+private:
+    UDPTransport& transport_;
+    double lossRate_;
+    std::mutex mutex_;
+    std::mt19937_64 rng_;
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t messages = argc > 1 ? std::stoul(argv[1]) : 50;
+    double lossRate = argc > 2 ? std::stod(argv[2]) : 0.0;
+    size_t fragmentSize = argc > 3 ? std::stoul(argv[3]) : 1400 - wire::FRAGMENT_HEADER_SIZE;
+    size_t window = argc > 4 ? std::stoul(argv[4]) : 64;
+
+    UDPTransport senderTransport;
+    UDPTransport receiverTransport;
+    if (!senderTransport.open(0) || !receiverTransport.open(0)) {
+        std::cerr << "failed to open sockets" << std::endl;
+        return 1;
+    }
+
+    LossySender senderLoss(senderTransport, lossRate, 1);
+    LossySender receiverLoss(receiverTransport, lossRate, 2);
+
+    std::mutex mutex;
+    std::condition_variable delivered;
+    size_t deliveredCount = 0;
+    size_t corrupted = 0;
+    std::vector<uint8_t> expected;
+
+    BulkTransfer sender(fragmentSize, window, std::ref(senderLoss), nullptr);
+    BulkTransfer receiver(fragmentSize, window, std::ref(receiverLoss),
+        [&](const Datagram& datagram) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (datagram.length != expected.size() ||
+                !std::equal(expected.begin(), expected.end(), datagram.data)) {
+                corrupted++;
+            }
+            deliveredCount++;
+            delivered.notify_all();
+        });
+
+    senderTransport.startLoop(IOBackend::EPOLL, 32,
+        [&sender](const Datagram& datagram) {
+            sender.handleDatagram(datagram);
+        },
+        [&sender]() {
+            sender.tick();
+        },
+        10);
+    receiverTransport.startLoop(IOBackend::EPOLL, 32,
+        [&receiver](const Datagram& datagram) {
+            receiver.handleDatagram(datagram);
+        },
+        [&receiver]() {
+            receiver.tick();
+        },
+        10);
+
+    uint32_t loopback = 0;
+    utils::ipToBinary("127.0.0.1", loopback);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << messages << " messages per size, loss " << lossRate << ", fragment " << fragmentSize
+              << " bytes, window " << window << std::endl;
+    std::cout << std::left << std::setw(10) << "size" << std::right << std::setw(10) << "MB/s"
+              << std::setw(12) << "ms/msg" << std::setw(14) << "frags/msg" << std::setw(14) << "resent/msg"
+              << std::setw(12) << "acks/msg" << std::setw(10) << "failed" << std::endl;
+
+    std::mt19937_64 rng(3);
+    for (size_t size : {64 * 1024, 256 * 1024, 1024 * 1024}) {
+        std::vector<uint8_t> message(size);
+        for (auto& byte : message) {
+            byte = static_cast<uint8_t>(rng());
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            expected = message;
+            deliveredCount = 0;
+        }
+
+        BulkTransferStats sentBefore = sender.getStats();
+        BulkTransferStats receivedBefore = receiver.getStats();
+        size_t completed = 0;
+
+        auto start = Clock::now();
+        for (size_t i = 0; i < messages; ++i) {
+            sender.send(loopback, receiverTransport.getPort(), message);
+
+            // Wait for delivery; a message the sender gave up on never arrives
+            std::unique_lock<std::mutex> lock(mutex);
+            if (delivered.wait_for(lock, std::chrono::seconds(5), [&]() {
+                    return deliveredCount > completed;
+                })) {
+                completed++;
+            }
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        BulkTransferStats sentAfter = sender.getStats();
+        BulkTransferStats receivedAfter = receiver.getStats();
+        double perMessage = static_cast<double>(std::max<size_t>(messages, 1));
+
+        std::cout << std::left << std::setw(10) << (std::to_string(size / 1024) + " KB") << std::right
+                  << std::setw(10) << static_cast<double>(completed * size) / seconds / 1e6
+                  << std::setw(12) << seconds * 1000.0 / perMessage
+                  << std::setw(14) << static_cast<double>(sentAfter.fragmentsSent - sentBefore.fragmentsSent) / perMessage
+                  << std::setw(14) << static_cast<double>(sentAfter.fragmentsRetransmitted -
+                                                          sentBefore.fragmentsRetransmitted) / perMessage
+                  << std::setw(12) << static_cast<double>(receivedAfter.acksSent - receivedBefore.acksSent) / perMessage
+                  << std::setw(10) << messages - completed << std::endl;
+    }
+
+    senderTransport.close();
+    receiverTransport.close();
+
+    if (corrupted > 0) {
+        std::cerr << corrupted << " messages arrived corrupted" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,150 @@
+// Microbenchmark of the work done to answer one FIND_NODE request: decoding
+// into an owning RPCMessage and building Node objects, as handleRPC used to,
+// against decoding into a MessageView and copying compact contacts.
+
+#include "include/routing_table.h"
+#include "include/utils.h"
+#include "include/wire_format.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <vector>
+
+using namespace kademlia;
+
+namespace {
+
+std::atomic<size_t> allocations{0};
+
+} // namespace
+
+// Count every heap allocation made by the process
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+struct Measurement {
+    double ns;
+    double allocations;
+};
+
+template<typename F>
+Measurement measure(size_t iterations, F&& body) {
+    size_t before = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        body(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    size_t after = allocations.load();
+    return Measurement{std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(iterations),
+                       static_cast<double>(after - before) / static_cast<double>(iterations)};
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t iterations = argc > 1 ? std::stoul(argv[1]) : 200000;
+
+    // A table filled from a few thousand random nodes
+    NodeID local = NodeID::random();
+    RoutingTable table(local);
+    for (size_t i = 0; i < 2000; ++i) {
+        table.addNode(std::make_shared<Node>(NodeID::random(), "10.0.0." + std::to_string(i % 250 + 1),
+                                             static_cast<uint16_t>(4000 + i)));
+    }
+
+    // Encoded FIND_NODE requests from a pool of senders for a pool of targets
+    const size_t POOL = 256;
+    std::vector<std::vector<uint8_t>> packets;
+    std::vector<uint32_t> senderIPs;
+    for (size_t i = 0; i < POOL; ++i) {
+        RPCMessage request;
+        request.type = RPCType::FIND_NODE;
+        request.sender = NodeID::random();
+        request.receiver = local;
+        request.senderPort = static_cast<uint16_t>(5000 + i);
+        request.transactionID = static_cast<uint32_t>(i);
+        wire::encodeNodeID(NodeID::random(), request.payload);
+
+        std::vector<uint8_t> packet(wire::HEADER_SIZE + request.payload.size());
+        wire::encodeMessage(request, packet.data(), packet.size());
+        packets.push_back(packet);
+
+        uint32_t ip = 0;
+        utils::ipToBinary("192.168.1." + std::to_string(i % 250 + 1), ip);
+        senderIPs.push_back(ip);
+    }
+
+    volatile size_t sink = 0;
+
+    Measurement owning = measure(iterations, [&](size_t i) {
+        const std::vector<uint8_t>& packet = packets[i % POOL];
+        RPCMessage message;
+        wire::decodeMessage(packet.data(), packet.size(), message);
+        message.senderIP = utils::binaryToIP(senderIPs[i % POOL]);
+
+        table.addNode(std::make_shared<Node>(message.sender, message.senderIP, message.senderPort));
+
+        NodeID target;
+        wire::decodeNodeID(message.payload, target);
+        std::vector<NodePtr> closest = table.findClosestNodes(target);
+
+        RPCMessage response;
+        wire::encodeContacts(closest, response.payload);
+        sink = sink + response.payload.size();
+    });
+
+    std::vector<Contact> closest;
+    std::vector<uint8_t> payload;
+    Measurement view = measure(iterations, [&](size_t i) {
+        const std::vector<uint8_t>& packet = packets[i % POOL];
+        MessageView message;
+        wire::decodeMessage(packet.data(), packet.size(), message);
+        message.senderIP = senderIPs[i % POOL];
+
+        Contact sender;
+        sender.id = message.sender;
+        sender.ip = message.senderIP;
+        sender.port = message.senderPort;
+        sender.lastSeen = utils::getCurrentTimeMillis();
+        table.addContact(sender);
+
+        NodeID target;
+        wire::decodeNodeID(message.payload, target);
+        table.findClosestContacts(target, K_VALUE, closest);
+
+        wire::encodeContacts(closest, payload);
+        sink = sink + payload.size();
+    });
+
+    std::cout << "FIND_NODE handling, " << iterations << " requests, "
+              << table.getAllNodes().size() << " contacts" << std::endl;
+    std::cout << std::left << std::setw(16) << "decode into"
+              << std::right << std::setw(12) << "ns/request"
+              << std::setw(16) << "allocs/request" << std::endl;
+    std::cout << std::fixed << std::setprecision(1)
+              << std::left << std::setw(16) << "RPCMessage"
+              << std::right << std::setw(12) << owning.ns << std::setw(16) << owning.allocations << std::endl
+              << std::left << std::setw(16) << "MessageView"
+              << std::right << std::setw(12) << view.ns << std::setw(16) << view.allocations << std::endl;
+
+    return 0;
+}
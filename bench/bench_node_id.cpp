@@ -0,0 +1,159 @@
+// Microbenchmark comparing the word-wise NodeID operations with the
+// byte-at-a-time loops they replaced.
+
+#include "include/node.h"
+#include "include/routing_table.h"
+#include "include/utils.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+using namespace kademlia;
+
+namespace {
+
+using ByteID = std::array<uint8_t, KEY_BYTES>;
+
+// The previous implementation: XOR byte by byte
+ByteID legacyDistance(const ByteID& a, const ByteID& b) {
+    ByteID result;
+    for (size_t i = 0; i < KEY_BYTES; ++i) {
+        result[i] = a[i] ^ b[i];
+    }
+    return result;
+}
+
+// The previous implementation: bounds-checked getBit() in a loop of up to 160 iterations
+bool legacyGetBit(const ByteID& id, size_t position) {
+    if (position >= KEY_BITS) {
+        throw std::out_of_range("Bit position out of range");
+    }
+    return (id[position / 8] & (1 << (7 - position % 8))) != 0;
+}
+
+size_t legacyBucketIndex(const ByteID& local, const ByteID& id) {
+    ByteID distance = legacyDistance(local, id);
+    for (size_t i = 0; i < KEY_BITS; ++i) {
+        if (legacyGetBit(distance, i)) {
+            return i;
+        }
+    }
+    return KEY_BITS - 1;
+}
+
+template<typename F>
+double measureNs(size_t iterations, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    body(iterations);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(iterations);
+}
+
+void report(const char* name, double legacyNs, double wordNs) {
+    std::cout << std::left << std::setw(22) << name
+              << std::right << std::fixed << std::setprecision(2)
+              << std::setw(12) << legacyNs << " ns"
+              << std::setw(12) << wordNs << " ns"
+              << std::setw(10) << legacyNs / wordNs << "x" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t iterations = argc > 1 ? std::stoul(argv[1]) : 10000000;
+
+    // A pool of random IDs; lookups hit IDs at every prefix length
+    const size_t POOL = 1024;
+    std::vector<NodeID> ids;
+    std::vector<ByteID> rawIds;
+    for (size_t i = 0; i < POOL; ++i) {
+        ids.push_back(NodeID::random());
+        rawIds.push_back(ids.back().getRaw());
+    }
+
+    NodeID local = NodeID::random();
+    ByteID rawLocal = local.getRaw();
+    RoutingTable table(local);
+
+    // Accumulate results so the compiler cannot drop the work
+    volatile size_t sink = 0;
+
+    std::cout << std::left << std::setw(22) << "operation"
+              << std::right << std::setw(15) << "byte loop"
+              << std::setw(15) << "word-wise"
+              << std::setw(11) << "speedup" << std::endl;
+
+    double legacyDistanceNs = measureNs(iterations, [&](size_t n) {
+        size_t acc = 0;
+        for (size_t i = 0; i < n; ++i) {
+            acc += legacyDistance(rawIds[i % POOL], rawIds[(i + 1) % POOL])[0];
+        }
+        sink = sink + acc;
+    });
+    double wordDistanceNs = measureNs(iterations, [&](size_t n) {
+        size_t acc = 0;
+        for (size_t i = 0; i < n; ++i) {
+            acc += ids[i % POOL].distance(ids[(i + 1) % POOL]).getWord(0);
+        }
+        sink = sink + acc;
+    });
+    report("distance", legacyDistanceNs, wordDistanceNs);
+
+    double legacyCompareNs = measureNs(iterations, [&](size_t n) {
+        size_t acc = 0;
+        for (size_t i = 0; i < n; ++i) {
+            acc += legacyDistance(rawIds[i % POOL], rawLocal) < legacyDistance(rawIds[(i + 1) % POOL], rawLocal);
+        }
+        sink = sink + acc;
+    });
+    double wordCompareNs = measureNs(iterations, [&](size_t n) {
+        size_t acc = 0;
+        for (size_t i = 0; i < n; ++i) {
+            acc += ids[i % POOL].distance(local) < ids[(i + 1) % POOL].distance(local);
+        }
+        sink = sink + acc;
+    });
+    report("distance compare", legacyCompareNs, wordCompareNs);
+
+    // Near IDs share long prefixes with the local ID, which is the slow case for the bit loop
+    std::vector<ByteID> rawNear;
+    std::vector<NodeID> near;
+    for (size_t i = 0; i < POOL; ++i) {
+        ByteID raw = rawLocal;
+        size_t bit = i % KEY_BITS;
+        raw[bit / 8] ^= static_cast<uint8_t>(1 << (7 - bit % 8));
+        rawNear.push_back(raw);
+        near.emplace_back(raw);
+    }
+
+    // Both implementations must agree before their timings mean anything
+    for (size_t i = 0; i < POOL; ++i) {
+        if (legacyBucketIndex(rawLocal, rawNear[i]) != table.getBucketIndex(near[i]) ||
+            legacyDistance(rawIds[i], rawLocal) != ids[i].distance(local).getRaw()) {
+            std::cerr << "mismatch between byte loop and word-wise results" << std::endl;
+            return 1;
+        }
+    }
+
+    double legacyBucketNs = measureNs(iterations, [&](size_t n) {
+        size_t acc = 0;
+        for (size_t i = 0; i < n; ++i) {
+            acc += legacyBucketIndex(rawLocal, rawNear[i % POOL]);
+        }
+        sink = sink + acc;
+    });
+    double wordBucketNs = measureNs(iterations, [&](size_t n) {
+        size_t acc = 0;
+        for (size_t i = 0; i < n; ++i) {
+            acc += table.getBucketIndex(near[i % POOL]);
+        }
+        sink = sink + acc;
+    });
+    report("bucket index", legacyBucketNs, wordBucketNs);
+
+    return 0;
+}
@@ -0,0 +1,161 @@
+// Lookup benchmark on an in-process overlay. Every node runs on a
+// LoopbackTransport attached to one LoopbackNetwork, so thousands of nodes
+// fit in one process and a run with the same seed is repeatable. Nodes join
+// one at a time through a random earlier node; random lookups then report
+// hops, RPCs, wall time and how often the true closest node was found.
+
+#include "include/kademlia.h"
+#include "include/loopback_transport.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace kademlia;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+NodeID randomID(std::mt19937_64& rng) {
+    std::array<uint8_t, KEY_BYTES> bytes;
+    for (auto& byte : bytes) {
+        byte = static_cast<uint8_t>(rng());
+    }
+    return NodeID(bytes);
+}
+
+template<typename T>
+T percentile(std::vector<T> values, size_t percent) {
+    if (values.empty()) {
+        return T();
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, values.size() * percent / 100)];
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t nodeCount = argc > 1 ? std::stoul(argv[1]) : 10000;
+    size_t lookups = argc > 2 ? std::stoul(argv[2]) : 1000;
+    uint64_t seed = argc > 3 ? std::stoull(argv[3]) : 1;
+
+    if (nodeCount == 0 || nodeCount > 60000) {
+        std::cerr << "node count must be between 1 and 60000" << std::endl;
+        return 1;
+    }
+
+    std::mt19937_64 rng(seed);
+    LoopbackNetwork network;
+    std::vector<std::unique_ptr<Kademlia>> nodes;
+    std::vector<NodeID> ids;
+    nodes.reserve(nodeCount);
+
+    // Nothing runs between events, so there is no maintenance thread to schedule
+    KademliaConfig config;
+    config.maintenanceInterval = std::chrono::milliseconds(0);
+
+    auto joinStart = Clock::now();
+    for (size_t i = 0; i < nodeCount; ++i) {
+        config.nodeID = randomID(rng);
+        ids.push_back(config.nodeID);
+
+        uint16_t port = static_cast<uint16_t>(1024 + i);
+        uint16_t bootstrapPort = i > 0 ? static_cast<uint16_t>(1024 + rng() % i) : 0;
+
+        nodes.push_back(std::make_unique<Kademlia>(port, i > 0 ? "127.0.0.1" : "", bootstrapPort, config,
+                                                   std::make_shared<LoopbackTransport>(network)));
+        nodes.back()->start();
+
+        // Let the join lookup finish before the next node arrives
+        network.run();
+    }
+    double joinSeconds = std::chrono::duration<double>(Clock::now() - joinStart).count();
+    uint64_t joinDatagrams = network.getDeliveredCount();
+
+    std::vector<size_t> hops;
+    std::vector<size_t> rpcs;
+    std::vector<double> micros;
+    size_t exact = 0;
+    size_t failed = 0;
+
+    uint64_t lookupDatagrams = network.getDeliveredCount();
+    for (size_t i = 0; i < lookups; ++i) {
+        Kademlia& source = *nodes[rng() % nodeCount];
+        NodeID target = randomID(rng);
+
+        bool success = false;
+        NodeID closestFound;
+        LookupStats stats;
+
+        auto start = Clock::now();
+        source.findNode(target, [&](bool ok, const std::vector<NodePtr>& result, const LookupStats& lookupStats) {
+            success = ok && !result.empty();
+            if (success) {
+                closestFound = result.front()->getID();
+            }
+            stats = lookupStats;
+        });
+        network.run();
+        micros.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+
+        if (!success) {
+            failed++;
+            continue;
+        }
+
+        // The lookup source never returns itself, so it is not a candidate
+        NodeID best;
+        bool haveBest = false;
+        for (const NodeID& id : ids) {
+            if (id == source.getLocalNode()->getID()) {
+                continue;
+            }
+            if (!haveBest || id.distance(target) < best.distance(target)) {
+                best = id;
+                haveBest = true;
+            }
+        }
+
+        exact += closestFound == best;
+        hops.push_back(stats.hops);
+        rpcs.push_back(stats.rpcs);
+    }
+    lookupDatagrams = network.getDeliveredCount() - lookupDatagrams;
+
+    double meanHops = 0;
+    double meanRpcs = 0;
+    for (size_t i = 0; i < hops.size(); ++i) {
+        meanHops += static_cast<double>(hops[i]);
+        meanRpcs += static_cast<double>(rpcs[i]);
+    }
+    if (!hops.empty()) {
+        meanHops /= static_cast<double>(hops.size());
+        meanRpcs /= static_cast<double>(rpcs.size());
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << nodeCount << " nodes joined in " << joinSeconds << " s, "
+              << joinDatagrams << " datagrams" << std::endl;
+    std::cout << lookups << " lookups, " << failed << " failed, "
+              << 100.0 * static_cast<double>(exact) / static_cast<double>(std::max<size_t>(lookups, 1))
+              << "% found the closest node" << std::endl;
+    std::cout << "hops      mean " << meanHops << "  p50 " << percentile(hops, 50)
+              << "  p99 " << percentile(hops, 99) << std::endl;
+    std::cout << "rpcs      mean " << meanRpcs << "  p50 " << percentile(rpcs, 50)
+              << "  p99 " << percentile(rpcs, 99) << std::endl;
+    std::cout << "wall us   p50 " << percentile(micros, 50) << "  p99 " << percentile(micros, 99) << std::endl;
+    std::cout << "datagrams per lookup " << static_cast<double>(lookupDatagrams) / static_cast<double>(std::max<size_t>(lookups, 1))
+              << std::endl;
+
+    for (auto& node : nodes) {
+        node->stop();
+    }
+
+    return 0;
+}
@@ -0,0 +1,215 @@
+// Multithreaded throughput benchmark of local value storage. Threads run a
+// mix of lookups and stores on random keys against the previous layout (two
+// maps behind one mutex, keyed by DHTKey::toString()) and against the
+// lock-striped Storage keyed by the cached key hash, and the benchmark
+// reports operations per second for each thread count. It then expires the
+// keys in steps, each removing a small share of them, and reports the time
+// one expiry pass takes with a full scan and with Storage's deadline heaps.
+
+#include "include/dht_key.h"
+#include "include/storage.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace kademlia;
+
+namespace {
+
+// Lifetime of values in the throughput runs, which count time in operations; none expires during a run
+constexpr uint64_t VALUE_TTL_MS = 24 * 60 * 60 * 1000;
+
+// The previous layout: values and expirations in parallel maps behind one mutex, keyed by the key's string form
+class LegacyStorage {
+public:
+    void put(const DHTKey& dhtKey, ByteSpan value, uint64_t ttlMs, const NodeID&, uint64_t now) {
+        std::string key = dhtKey.toString();
+        std::lock_guard<std::mutex> lock(mutex_);
+        values_[key].assign(value.begin(), value.end());
+
+        uint64_t expiration = now + ttlMs;
+        auto it = expirations_.find(key);
+        if (it == expirations_.end() || it->second < expiration) {
+            expirations_[key] = expiration;
+        }
+    }
+
+    bool get(const DHTKey& dhtKey, std::vector<uint8_t>& value, uint64_t) const {
+        std::string key = dhtKey.toString();
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = values_.find(key);
+        if (it == values_.end()) {
+            return false;
+        }
+        value = it->second;
+        return true;
+    }
+
+    // Scan every key under the lock, as the node used to
+    size_t expire(uint64_t now) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t removed = 0;
+        for (auto it = expirations_.begin(); it != expirations_.end();) {
+            if (now >= it->second) {
+                values_.erase(it->first);
+                it = expirations_.erase(it);
+                removed++;
+            } else {
+                ++it;
+            }
+        }
+        return removed;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::vector<uint8_t>> values_;
+    std::unordered_map<std::string, uint64_t> expirations_;
+};
+
+// Storage as the node uses it, by the hash cached in the key
+class HashedStorage {
+public:
+    void put(const DHTKey& key, ByteSpan value, uint64_t ttlMs, const NodeID& publisher, uint64_t now) {
+        storage_.put(key.getHash(), value, ttlMs, publisher, now);
+    }
+
+    bool get(const DHTKey& key, std::vector<uint8_t>& value, uint64_t now) const {
+        return storage_.get(key.getHash(), value, now);
+    }
+
+    size_t expire(uint64_t now) {
+        return storage_.expire(now);
+    }
+
+private:
+    Storage storage_;
+};
+
+// Run the workload on the given number of threads and return operations per second
+template<typename Store>
+double run(Store& store, const std::vector<DHTKey>& keys, const std::vector<uint8_t>& value,
+           size_t threads, size_t operations, size_t storePercent) {
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            std::mt19937_64 rng(t + 1);
+            std::vector<uint8_t> out;
+            NodeID publisher;
+            size_t hits = 0;
+
+            for (size_t i = 0; i < operations; ++i) {
+                const DHTKey& key = keys[rng() % keys.size()];
+                if (rng() % 100 < storePercent) {
+                    store.put(key, value, VALUE_TTL_MS, publisher, i);
+                } else {
+                    hits += store.get(key, out, i);
+                }
+            }
+
+            // Keep the lookups from being optimized away
+            if (hits == SIZE_MAX) {
+                std::cout << hits;
+            }
+        });
+    }
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return static_cast<double>(threads * operations) / seconds;
+}
+
+// Store every key with a lifetime spread over the span, then expire them in steps and return microseconds per pass
+template<typename Store>
+double runExpiry(Store& store, const std::vector<DHTKey>& keys, const std::vector<uint8_t>& value,
+                 uint64_t spanMs, size_t steps) {
+    std::mt19937_64 rng(1);
+    NodeID publisher;
+    for (const auto& key : keys) {
+        store.put(key, value, 1 + rng() % spanMs, publisher, 0);
+    }
+
+    size_t removed = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t step = 1; step <= steps; ++step) {
+        removed += store.expire(spanMs * step / steps);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (removed != keys.size()) {
+        std::cout << "expired " << removed << " of " << keys.size() << " keys" << std::endl;
+    }
+    return seconds * 1e6 / static_cast<double>(steps);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t operations = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    size_t keyCount = argc > 2 ? std::stoul(argv[2]) : 100000;
+    size_t valueBytes = argc > 3 ? std::stoul(argv[3]) : 100;
+    size_t storePercent = argc > 4 ? std::stoul(argv[4]) : 10;
+    size_t maxThreads = argc > 5 ? std::stoul(argv[5]) : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+    std::vector<DHTKey> keys;
+    keys.reserve(keyCount);
+    for (size_t i = 0; i < keyCount; ++i) {
+        keys.emplace_back("key-" + std::to_string(i));
+    }
+    std::vector<uint8_t> value(valueBytes, 0xAB);
+
+    std::cout << operations << " operations per thread, " << keyCount << " keys, " << valueBytes
+              << "-byte values, " << storePercent << "% stores" << std::endl;
+    std::cout << std::left << std::setw(10) << "threads" << std::right << std::setw(16) << "one mutex"
+              << std::setw(16) << "sharded" << std::setw(11) << "speedup" << std::endl;
+
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        LegacyStorage legacy;
+        HashedStorage sharded;
+
+        // Fill both stores so lookups find their keys
+        for (const auto& key : keys) {
+            legacy.put(key, value, VALUE_TTL_MS, NodeID(), 0);
+            sharded.put(key, value, VALUE_TTL_MS, NodeID(), 0);
+        }
+
+        double legacyOps = run(legacy, keys, value, threads, operations, storePercent);
+        double shardedOps = run(sharded, keys, value, threads, operations, storePercent);
+
+        std::cout << std::left << std::setw(10) << threads << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(12) << legacyOps / 1e6 << " M/s"
+                  << std::setw(12) << shardedOps / 1e6 << " M/s"
+                  << std::setw(10) << shardedOps / legacyOps << "x" << std::endl;
+    }
+
+    // Each pass removes about 1% of the keys
+    constexpr uint64_t EXPIRY_SPAN_MS = 100000;
+    constexpr size_t EXPIRY_STEPS = 100;
+    {
+        LegacyStorage legacy;
+        HashedStorage sharded;
+        double legacyUs = runExpiry(legacy, keys, value, EXPIRY_SPAN_MS, EXPIRY_STEPS);
+        double shardedUs = runExpiry(sharded, keys, value, EXPIRY_SPAN_MS, EXPIRY_STEPS);
+
+        std::cout << std::endl << "expiry pass over " << keyCount << " keys, 1% due per pass" << std::endl;
+        std::cout << std::left << std::setw(10) << "" << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(13) << legacyUs << " us"
+                  << std::setw(13) << shardedUs << " us"
+                  << std::setw(10) << std::setprecision(2) << legacyUs / shardedUs << "x" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+// Packets-per-second benchmark comparing one syscall per datagram
+// (sendto/recvfrom) with batched sendmmsg/recvmmsg over loopback. The
+// "ns" columns are thread CPU time per datagram, which does not depend on
+// how many cores the sender and receiver share.
+
+#include "include/transport.h"
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <time.h>
+
+using namespace kademlia;
+
+namespace {
+
+struct Result {
+    double sendPps;
+    double receivePps;
+    // CPU time spent per datagram by the sending and receiving threads
+    double sendCpuNs;
+    double receiveCpuNs;
+    size_t received;
+};
+
+double threadCpuNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) * 1e9 + static_cast<double>(ts.tv_nsec);
+}
+
+Result run(bool batched, size_t datagrams, size_t payloadSize, size_t batchSize) {
+    UDPTransport receiver;
+    UDPTransport sender;
+    if (!receiver.open(0) || !sender.open(0)) {
+        std::cerr << "failed to open sockets" << std::endl;
+        return Result{0, 0, 0, 0, 0};
+    }
+
+    std::atomic<bool> sending{true};
+    size_t received = 0;
+    double receiveCpuNs = 0;
+    std::chrono::steady_clock::time_point firstReceive;
+    std::chrono::steady_clock::time_point lastReceive;
+
+    // Receive until the sender is done and the socket stays idle
+    std::thread receiveThread([&]() {
+        ReceiveBatch batch(batched ? batchSize : 1, payloadSize);
+        std::vector<uint8_t> buffer(payloadSize);
+        std::string fromIP;
+        uint16_t fromPort = 0;
+        double cpuStart = threadCpuNs();
+
+        for (;;) {
+            size_t count = 0;
+            if (batched) {
+                count = receiver.receiveBatch(batch, 100);
+            } else {
+                count = receiver.receive(buffer.data(), buffer.size(), fromIP, fromPort, 100) > 0 ? 1 : 0;
+            }
+
+            if (count == 0) {
+                if (!sending) {
+                    break;
+                }
+                continue;
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if (received == 0) {
+                firstReceive = now;
+            }
+            lastReceive = now;
+            received += count;
+        }
+
+        receiveCpuNs = threadCpuNs() - cpuStart;
+    });
+
+    std::vector<uint8_t> payload(payloadSize, 0x5A);
+    auto start = std::chrono::steady_clock::now();
+    double sendCpuStart = threadCpuNs();
+
+    if (batched) {
+        SendBatch batch(sender, batchSize);
+        for (size_t i = 0; i < datagrams; ++i) {
+            sender.send("127.0.0.1", receiver.getPort(), payload.data(), payload.size());
+        }
+    } else {
+        for (size_t i = 0; i < datagrams; ++i) {
+            sender.send("127.0.0.1", receiver.getPort(), payload.data(), payload.size());
+        }
+    }
+
+    auto sent = std::chrono::steady_clock::now();
+    double sendCpuNs = threadCpuNs() - sendCpuStart;
+    sending = false;
+    receiveThread.join();
+
+    double sendSeconds = std::chrono::duration<double>(sent - start).count();
+    double receiveSeconds = std::chrono::duration<double>(lastReceive - firstReceive).count();
+
+    Result result;
+    result.sendPps = static_cast<double>(datagrams) / sendSeconds;
+    result.receivePps = receiveSeconds > 0 ? static_cast<double>(received) / receiveSeconds : 0;
+    result.sendCpuNs = sendCpuNs / static_cast<double>(datagrams);
+    result.receiveCpuNs = received > 0 ? receiveCpuNs / static_cast<double>(received) : 0;
+    result.received = received;
+    return result;
+}
+
+void report(const char* name, const Result& result, size_t datagrams) {
+    std::cout << std::left << std::setw(12) << name
+              << std::right << std::fixed << std::setprecision(0)
+              << std::setw(14) << result.sendPps
+              << std::setw(14) << result.receivePps
+              << std::setw(12) << result.sendCpuNs
+              << std::setw(12) << result.receiveCpuNs
+              << std::setprecision(1)
+              << std::setw(11) << 100.0 * static_cast<double>(result.received) / static_cast<double>(datagrams) << "%"
+              << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t datagrams = argc > 1 ? std::stoul(argv[1]) : 200000;
+    size_t payloadSize = argc > 2 ? std::stoul(argv[2]) : 128;
+    size_t batchSize = argc > 3 ? std::stoul(argv[3]) : 32;
+
+    std::cout << datagrams << " datagrams of " << payloadSize << " bytes, batch size " << batchSize << std::endl;
+    std::cout << std::left << std::setw(12) << "mode"
+              << std::right << std::setw(14) << "send pps"
+              << std::setw(14) << "receive pps"
+              << std::setw(12) << "send ns"
+              << std::setw(12) << "recv ns"
+              << std::setw(12) << "delivered" << std::endl;
+
+    report("per-call", run(false, datagrams, payloadSize, batchSize), datagrams);
+    report("batched", run(true, datagrams, payloadSize, batchSize), datagrams);
+
+    return 0;
+}
@@ -0,0 +1,200 @@
+// Benchmark of the persistent storage backend. It stores every key in a
+// Storage opened on a fresh directory and reports the write rate and the
+// number of group commits, then closes and reopens the store and reports
+// the time until it is ready again, next to the time a full read of the
+// segment files takes, which is the least a restart that replays every
+// record would need. Finally it overwrites half the keys and compacts the
+// log, reporting the log's size before and after.
+
+#include "include/dht_key.h"
+#include "include/storage.h"
+#include "include/utils.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <dirent.h>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace kademlia;
+
+namespace {
+
+// Lifetime of every value; none expires during the run. Times are on the wall clock, which the
+// compaction thread also reads.
+constexpr uint64_t VALUE_TTL_MS = 24 * 60 * 60 * 1000;
+
+// Keys read back after the restart to check the recovered values
+constexpr size_t CHECKED_KEYS = 10000;
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::vector<std::string> listFiles(const std::string& directory) {
+    std::vector<std::string> files;
+    if (DIR* dir = opendir(directory.c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            if (entry->d_name[0] != '.') {
+                files.push_back(directory + "/" + entry->d_name);
+            }
+        }
+        closedir(dir);
+    }
+    return files;
+}
+
+// Read every file in the directory from start to end and return the bytes read
+uint64_t readAllFiles(const std::string& directory) {
+    std::vector<char> buffer(1 << 20);
+    uint64_t total = 0;
+    for (const auto& path : listFiles(directory)) {
+        if (FILE* file = std::fopen(path.c_str(), "rb")) {
+            size_t count;
+            while ((count = std::fread(buffer.data(), 1, buffer.size(), file)) > 0) {
+                total += count;
+            }
+            std::fclose(file);
+        }
+    }
+    return total;
+}
+
+// Each key's value starts with its index and a version, so a restart can be checked
+void fillValue(std::vector<uint8_t>& value, uint64_t index, uint8_t version) {
+    for (size_t i = 0; i < 8 && i < value.size(); ++i) {
+        value[i] = static_cast<uint8_t>(index >> (i * 8));
+    }
+    if (value.size() > 8) {
+        value[8] = version;
+    }
+}
+
+void printStats(const char* label, const ValueLogStats& stats) {
+    std::cout << label << stats.segments << " segments, " << std::fixed << std::setprecision(1)
+              << static_cast<double>(stats.bytes) / (1 << 20) << " MB of records, "
+              << static_cast<double>(stats.deadBytes) / (1 << 20) << " MB dead" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t keyCount = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    size_t valueBytes = argc > 2 ? std::stoul(argv[2]) : 100;
+    size_t syncMs = argc > 3 ? std::stoul(argv[3]) : 100;
+    std::string directory = argc > 4 ? argv[4] : "bench_value_log.data";
+
+    // Start from an empty log
+    mkdir(directory.c_str(), 0755);
+    for (const auto& path : listFiles(directory)) {
+        unlink(path.c_str());
+    }
+
+    std::vector<KeyHash> keys;
+    keys.reserve(keyCount);
+    for (size_t i = 0; i < keyCount; ++i) {
+        keys.push_back(DHTKey("key-" + std::to_string(i)).getHash());
+    }
+    std::vector<uint8_t> value(valueBytes, 0xAB);
+    NodeID publisher;
+
+    uint64_t now = utils::getCurrentTimeMillis();
+
+    ValueLogOptions options;
+    options.syncInterval = std::chrono::milliseconds(syncMs);
+
+    std::cout << keyCount << " keys, " << valueBytes << "-byte values, sync every " << syncMs << " ms in "
+              << directory << std::endl;
+
+    // Write every key once
+    {
+        Storage storage;
+        if (!storage.open(directory, options, now)) {
+            return 1;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < keyCount; ++i) {
+            fillValue(value, i, 1);
+            storage.put(keys[i], value, VALUE_TTL_MS, publisher, now);
+        }
+        storage.sync();
+        double seconds = secondsSince(start);
+
+        ValueLogStats stats = storage.getLogStats();
+        std::cout << "write:   " << std::fixed << std::setprecision(2) << keyCount / seconds / 1e6 << " M puts/s, "
+                  << std::setprecision(1) << static_cast<double>(stats.bytes) / (1 << 20) / seconds << " MB/s, "
+                  << stats.syncs << " syncs in " << std::setprecision(2) << seconds << " s" << std::endl;
+
+        start = std::chrono::steady_clock::now();
+        storage.close();
+        std::cout << "close:   " << std::setprecision(3) << secondsSince(start) << " s" << std::endl;
+    }
+
+    // Reopen, rebuilding the index from the segment footers
+    {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t fileBytes = readAllFiles(directory);
+        double scanSeconds = secondsSince(start);
+
+        Storage storage;
+        start = std::chrono::steady_clock::now();
+        if (!storage.open(directory, options, now)) {
+            return 1;
+        }
+        double openSeconds = secondsSince(start);
+
+        ValueLogStats stats = storage.getLogStats();
+        std::cout << "reopen:  " << std::setprecision(3) << openSeconds << " s to ready, "
+                  << std::setprecision(1) << static_cast<double>(stats.recoveryBytes) / (1 << 20) << " MB read, "
+                  << storage.size() << " keys" << std::endl;
+        std::cout << "replay:  " << std::setprecision(3) << scanSeconds << " s just to read all "
+                  << std::setprecision(1) << static_cast<double>(fileBytes) / (1 << 20) << " MB of segments"
+                  << std::endl;
+
+        // Spot-check recovered values
+        std::mt19937_64 rng(1);
+        std::vector<uint8_t> out;
+        size_t wrong = 0;
+        for (size_t i = 0; i < CHECKED_KEYS && keyCount > 0; ++i) {
+            size_t index = rng() % keyCount;
+            fillValue(value, index, 1);
+            if (!storage.get(keys[index], out, now) || out != value) {
+                wrong++;
+            }
+        }
+        if (wrong > 0) {
+            std::cout << wrong << " of " << CHECKED_KEYS << " checked keys were wrong" << std::endl;
+        }
+
+        // Overwrite every other key, leaving about half of each segment dead, then compact
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < keyCount; i += 2) {
+            fillValue(value, i, 2);
+            storage.put(keys[i], value, VALUE_TTL_MS, publisher, now);
+        }
+        storage.sync();
+        std::cout << "rewrite: " << std::setprecision(2) << (keyCount / 2) / secondsSince(start) / 1e6
+                  << " M puts/s" << std::endl;
+
+        printStats("before:  ", storage.getLogStats());
+        start = std::chrono::steady_clock::now();
+        size_t compacted = 0;
+        while (storage.compact(now)) {
+            compacted++;
+        }
+        storage.sync();
+        double compactSeconds = secondsSince(start);
+        printStats("after:   ", storage.getLogStats());
+        std::cout << "compact: " << compacted << " segments in " << std::setprecision(2) << compactSeconds
+                  << " s, plus " << storage.getLogStats().compactedSegments - compacted
+                  << " by the background thread" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace kademlia {
+
+/**
+ * @brief Struct referring to a range of bytes owned elsewhere
+ */
+struct ByteSpan {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    ByteSpan() = default;
+    ByteSpan(const uint8_t* data, size_t size) : data(data), size(size) {}
+    ByteSpan(const std::vector<uint8_t>& bytes) : data(bytes.data()), size(bytes.size()) {}
+
+    const uint8_t* begin() const {
+        return data;
+    }
+
+    const uint8_t* end() const {
+        return data + size;
+    }
+
+    bool empty() const {
+        return size == 0;
+    }
+};
+
+/**
+ * @brief PooledBuffer class holding a reference to a buffer from a BufferPool
+ *
+ * Copies share the buffer; it returns to its pool when the last copy is
+ * destroyed. The reference count is atomic, so copies may be released on
+ * any thread.
+ */
+class PooledBuffer {
+public:
+    PooledBuffer();
+    PooledBuffer(const PooledBuffer& other);
+    PooledBuffer(PooledBuffer&& other) noexcept;
+    PooledBuffer& operator=(PooledBuffer other) noexcept;
+    ~PooledBuffer();
+
+    // Get the buffer bytes, or nullptr for an empty reference
+    uint8_t* data() const;
+
+    // Get the size of the buffer
+    size_t capacity() const;
+
+    // Get the number of references sharing the buffer
+    size_t useCount() const;
+
+    // Drop this reference
+    void reset();
+
+    explicit operator bool() const {
+        return block_ != nullptr;
+    }
+
+private:
+    friend class BufferPool;
+
+    struct Block;
+
+    explicit PooledBuffer(Block* block);
+
+    Block* block_;
+};
+
+/**
+ * @brief BufferPool class recycling fixed-size buffers
+ *
+ * acquire() hands out a cached buffer if one is free and allocates one
+ * otherwise. Released buffers are cached up to maxCached and freed beyond
+ * that. Buffers may outlive the pool; they are then freed on release.
+ * The pool is thread-safe.
+ */
+class BufferPool {
+public:
+    explicit BufferPool(size_t bufferSize, size_t maxCached = 256);
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // Get a buffer that no one else references
+    PooledBuffer acquire();
+
+    // Get the size of every buffer
+    size_t getBufferSize() const;
+
+    // Get the number of free buffers cached for reuse
+    size_t getCachedCount() const;
+
+private:
+    friend class PooledBuffer;
+
+    struct Shared;
+
+    // Return a buffer whose last reference was dropped
+    static void recycle(PooledBuffer::Block* block);
+
+    Shared* shared_;
+};
+
+} // namespace kademlia
@@ -0,0 +1,202 @@
+#pragma once
+
+#include "transport.h"
+#include "wire_format.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace kademlia {
+
+// Largest message accepted for fragmented transfer, in either direction
+constexpr size_t MAX_BULK_MESSAGE_SIZE = 16 * 1024 * 1024;
+
+// Bytes that messages still being reassembled may hold in total
+constexpr size_t MAX_REASSEMBLY_BYTES = 64 * 1024 * 1024;
+
+// Bytes that messages still being reassembled from any one source IP may hold
+constexpr size_t MAX_REASSEMBLY_BYTES_PER_SOURCE = MAX_BULK_MESSAGE_SIZE;
+
+// Time without an acknowledgement after which unacknowledged fragments are sent again
+constexpr uint64_t BULK_RETRANSMIT_MS = 200;
+
+// Retransmission rounds without progress before an outgoing message is given up
+constexpr size_t BULK_MAX_RETRANSMITS = 8;
+
+// Time after which a partly received message is dropped, and a finished one is forgotten
+constexpr uint64_t BULK_REASSEMBLY_TIMEOUT_MS = 10000;
+
+/**
+ * @brief Struct holding a snapshot of fragmented transfer counters
+ */
+struct BulkTransferStats {
+    uint64_t messagesSent = 0;
+    uint64_t messagesReceived = 0;
+    uint64_t fragmentsSent = 0;
+    uint64_t fragmentsRetransmitted = 0;
+    uint64_t acksSent = 0;
+    uint64_t messagesFailed = 0;
+};
+
+/**
+ * @brief BulkTransfer class moving messages too large for one datagram
+ *
+ * An outgoing message is split into fixed-size fragments, of which up to a
+ * window are unacknowledged at any time. The receiver acknowledges with the
+ * number of leading fragments it holds plus a bitmap of the ones after, so
+ * the sender resends only the holes: a fragment is taken as lost once three
+ * fragments sent after it were acknowledged and it has been in flight for a
+ * few milliseconds, which tolerates reordering between sending threads. When nothing was acknowledged
+ * for BULK_RETRANSMIT_MS, the first missing fragment is resent as a probe,
+ * and once it is acknowledged every fragment sent before it that is still
+ * missing is taken as lost. Completed messages are handed to the
+ * deliver function as one datagram from the sender's address.
+ *
+ * All methods are thread-safe. Sends and deliveries run without the
+ * internal lock held, so the deliver function may send.
+ */
+class BulkTransfer {
+public:
+    using SendFunction = std::function<bool(uint32_t ip, uint16_t port, const uint8_t* data, size_t length)>;
+
+    BulkTransfer(size_t fragmentSize, size_t window, SendFunction send, ReceiveHandler deliver);
+
+    BulkTransfer(const BulkTransfer&) = delete;
+    BulkTransfer& operator=(const BulkTransfer&) = delete;
+
+    // Start sending an encoded message; returns false if it is too large
+    bool send(uint32_t ip, uint16_t port, std::vector<uint8_t> message);
+
+    // Handle a fragment or acknowledgement; returns false if the datagram is neither
+    bool handleDatagram(const Datagram& datagram);
+
+    // Check whether a fragment or acknowledgement belongs to a transfer already under way with its sender:
+    // an ack of a message we are sending, or a fragment of one being reassembled or just finished
+    bool isExpected(const Datagram& datagram) const;
+
+    // Resend overdue fragments and drop stalled transfers; cheap when nothing is in flight
+    void tick();
+
+    // Drop every transfer in either direction
+    void clear();
+
+    // Get the number of outgoing and incoming transfers in progress
+    size_t activeCount() const;
+
+    // Get the payload bytes carried by each fragment
+    size_t getFragmentSize() const;
+
+    // Get a snapshot of the counters
+    BulkTransferStats getStats() const;
+
+private:
+    struct Outgoing {
+        uint32_t ip;
+        uint16_t port;
+        std::vector<uint8_t> data;
+        size_t fragmentCount;
+        // Transmission sequence and time of each fragment's last send, 0 if never sent
+        std::vector<uint64_t> sentSequence;
+        std::vector<uint64_t> sentMs;
+        std::vector<bool> acked;
+        size_t ackedCount;
+        // Highest transmission sequence acknowledged so far
+        uint64_t newestAcked;
+        // Every fragment below this one is acknowledged
+        size_t firstUnacked;
+        // Fragments sent and not yet acknowledged
+        size_t outstanding;
+        size_t nextNew;
+        uint64_t lastProgressMs;
+        size_t retransmitRounds;
+        // Sequence of the fragment resent after a timeout, 0 if none is waiting for its acknowledgement
+        uint64_t probeSequence;
+    };
+
+    struct Incoming {
+        std::vector<uint8_t> data;
+        std::vector<bool> received;
+        size_t receivedCount;
+        size_t contiguous;
+        // One past the highest fragment index received
+        size_t highest;
+        uint16_t fragmentSize;
+        size_t sinceAck;
+        uint64_t lastActivityMs;
+    };
+
+    // Sender address and message ID
+    using IncomingKey = std::pair<uint64_t, uint32_t>;
+
+    // A fragment to send once the lock is released
+    struct PendingFragment {
+        std::shared_ptr<Outgoing> transfer;
+        uint32_t messageID;
+        uint32_t index;
+    };
+
+    struct PendingAck {
+        uint32_t ip;
+        uint16_t port;
+        uint32_t messageID;
+        uint32_t contiguous;
+        std::vector<uint8_t> bitmap;
+    };
+
+    static uint64_t makeAddress(uint32_t ip, uint16_t port);
+
+    // Give back the reassembly bytes of an incoming message that finished or was dropped; called with the lock held
+    void releaseReassembly(const IncomingKey& key, size_t bytes);
+
+    // Recount the transfers tick() has to look at; called with the lock held
+    void updateActive();
+
+    void handleFragment(const Datagram& datagram);
+    void handleAck(const Datagram& datagram);
+
+    // Queue new fragments while the window has room
+    void fillWindow(uint32_t messageID, const std::shared_ptr<Outgoing>& transfer, uint64_t now,
+                    std::vector<PendingFragment>& pending);
+
+    // Queue again the fragments that later acknowledged ones have overtaken
+    void resendLost(uint32_t messageID, const std::shared_ptr<Outgoing>& transfer, uint64_t now,
+                    std::vector<PendingFragment>& pending);
+
+    // Build the acknowledgement describing what has arrived of a message
+    static PendingAck makeAck(uint32_t ip, uint16_t port, uint32_t messageID, const Incoming& incoming);
+
+    void sendFragments(const std::vector<PendingFragment>& pending);
+    void sendAck(const PendingAck& ack);
+
+    size_t fragmentSize_;
+    size_t window_;
+    SendFunction send_;
+    ReceiveHandler deliver_;
+
+    mutable std::mutex mutex_;
+    std::atomic<uint32_t> nextMessageID_;
+    uint64_t nextSequence_;
+    std::map<uint32_t, std::shared_ptr<Outgoing>> outgoing_;
+    std::map<IncomingKey, Incoming> incoming_;
+    // Finished messages and when they finished, so retransmitted fragments are acknowledged again
+    std::map<IncomingKey, uint64_t> completed_;
+    size_t reassemblyBytes_;
+    // Reassembly bytes held per source IP, so one sender cannot take the whole budget
+    std::map<uint32_t, size_t> sourceBytes_;
+    // Transfers in either direction, read without the lock by tick()
+    std::atomic<size_t> active_;
+
+    std::atomic<uint64_t> messagesSent_;
+    std::atomic<uint64_t> messagesReceived_;
+    std::atomic<uint64_t> fragmentsSent_;
+    std::atomic<uint64_t> fragmentsRetransmitted_;
+    std::atomic<uint64_t> acksSent_;
+    std::atomic<uint64_t> messagesFailed_;
+};
+
+} // namespace kademlia
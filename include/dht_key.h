@@ -1,5 +1,6 @@
 #pragma once
 
+#include "node.h"
 #include <vector>
 #include <cstdint>
 #include <string>
@@ -7,8 +8,14 @@
 
 namespace kademlia {
 
+// Identity of a key everywhere inside the DHT: the SHA-1 hash of its bytes, in the node ID space
+using KeyHash = NodeID;
+
 /**
  * @brief DHTKey class representing a key in the DHT
+ *
+ * The key's hash is computed once on construction. Storage, RPC payloads
+ * and lookups use only the hash; the key bytes stay with the caller.
  */
 class DHTKey {
 public:
@@ -19,15 +26,22 @@ public:
     // Get the raw data
     const std::vector<uint8_t>& getData() const;
     
+    // Get the hash of the key
+    const KeyHash& getHash() const;
+    
     // Convert to string
     std::string toString() const;
     
+    // Convert raw key bytes to the same string form without constructing a key
+    static std::string toString(const uint8_t* data, size_t length);
+    
     // Comparison operators
     bool operator==(const DHTKey& other) const;
     bool operator!=(const DHTKey& other) const;
 
 private:
     std::vector<uint8_t> data_;
+    KeyHash hash_;
 };
 
 } // namespace kademlia
@@ -37,15 +51,8 @@ namespace std {
     template<>
     struct hash<kademlia::DHTKey> {
         size_t operator()(const kademlia::DHTKey& key) const {
-            const auto& data = key.getData();
-            size_t hash = 0;
-            
-            // Simple hash function
-            for (const auto& byte : data) {
-                hash = hash * 31 + byte;
-            }
-            
-            return hash;
+            // The cached SHA-1 hash is already uniform
+            return std::hash<kademlia::NodeID>()(key.getHash());
         }
     };
 }
\ No newline at end of file
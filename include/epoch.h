@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace kademlia {
+
+/**
+ * @brief EpochManager class implementing epoch-based memory reclamation
+ *
+ * Readers enter a critical section with a Guard, which announces the
+ * global epoch they observed in a reader slot. Writers unlink an object
+ * and hand it to retire() instead of deleting it. A retired object is
+ * freed once the global epoch has advanced twice past the epoch it was
+ * retired in, which can only happen after every reader that might still
+ * see it has left. Readers never block; retire() is serialized
+ * internally.
+ */
+class EpochManager {
+public:
+    // Maximum number of readers inside a critical section at once; further readers wait for a slot
+    static constexpr size_t MAX_READERS = 128;
+
+    /**
+     * @brief RAII guard marking a read-side critical section
+     */
+    class Guard {
+    public:
+        Guard(Guard&& other) noexcept;
+        ~Guard();
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        Guard& operator=(Guard&&) = delete;
+
+    private:
+        friend class EpochManager;
+        explicit Guard(std::atomic<uint64_t>* slot);
+
+        std::atomic<uint64_t>* slot_;
+    };
+
+    EpochManager();
+    ~EpochManager();
+
+    EpochManager(const EpochManager&) = delete;
+    EpochManager& operator=(const EpochManager&) = delete;
+
+    // Enter a read-side critical section
+    Guard enter();
+
+    // Free the object once no reader can still hold a reference to it
+    template<typename T>
+    void retire(T* object) {
+        retire(object, [](void* p) {
+            delete static_cast<T*>(p);
+        });
+    }
+
+    // Free the object with the given deleter once no reader can still hold a reference to it
+    void retire(void* object, void (*deleter)(void*));
+
+    // Get the number of retired objects not yet freed
+    size_t pendingCount() const;
+
+private:
+    // Marks a reader slot that is not in use
+    static constexpr uint64_t IDLE = ~uint64_t(0);
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{IDLE};
+    };
+
+    struct Retired {
+        void* object;
+        void (*deleter)(void*);
+        uint64_t epoch;
+    };
+
+    // Advance the global epoch if every active reader has observed it; requires retireMutex_
+    void tryAdvance();
+
+    // Free retired objects that no reader can reach; requires retireMutex_
+    void collect();
+
+    std::atomic<uint64_t> epoch_;
+    std::array<Slot, MAX_READERS> slots_;
+    std::vector<Retired> retired_;
+    mutable std::mutex retireMutex_;
+};
+
+} // namespace kademlia
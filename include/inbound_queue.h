@@ -0,0 +1,140 @@
+#pragma once
+
+#include "transport.h"
+#include "wire_format.h"
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace kademlia {
+
+// Bytes the inbound queue may hold in total, however few messages that is
+constexpr size_t MAX_INBOUND_QUEUE_BYTES = 64 * 1024 * 1024;
+
+// Largest message copied out of its pooled receive buffer when queued; larger ones keep the whole buffer
+constexpr size_t INBOUND_COPY_THRESHOLD = 4096;
+
+// Handler of a queued message, decoded once on arrival
+using MessageHandler = std::function<void(const MessageView& message)>;
+
+/**
+ * @brief Enum representing how urgently a received message is handled, most urgent first
+ */
+enum class InboundPriority : uint8_t {
+    // Pings and replies to our own outstanding requests
+    HIGH,
+    // Lookups and other requests
+    NORMAL,
+    // Unsolicited stores
+    LOW
+};
+
+// Number of InboundPriority levels
+constexpr size_t INBOUND_PRIORITY_COUNT = 3;
+
+/**
+ * @brief Enum representing what a full inbound queue drops to make room
+ */
+enum class ShedPolicy {
+    // The message that has waited longest, whatever its priority
+    DROP_OLDEST,
+    // The oldest message of the lowest priority queued, or the new one if nothing queued is less urgent
+    DROP_LOWEST_PRIORITY
+};
+
+/**
+ * @brief Struct holding a snapshot of inbound load counters
+ */
+struct InboundStats {
+    // Messages refused by the per-source rate limit
+    uint64_t rateLimited = 0;
+    // Messages that entered the queue
+    uint64_t queued = 0;
+    // Messages dropped because the queue was full, by priority
+    std::array<uint64_t, INBOUND_PRIORITY_COUNT> shed{};
+};
+
+/**
+ * @brief InboundQueue class handing received messages from event loop threads to handler threads
+ *
+ * The queue holds at most capacity messages and MAX_INBOUND_QUEUE_BYTES,
+ * in one FIFO per priority, and handler threads always take the most
+ * urgent message first. A message that arrives when the queue is full
+ * makes room according to the shed policy or is dropped itself. Messages
+ * up to INBOUND_COPY_THRESHOLD bytes are copied, so their receive buffer
+ * goes straight back to the event loop. Larger ones keep a reference to
+ * their pooled receive buffer and count its whole size against
+ * MAX_INBOUND_QUEUE_BYTES. Each message is queued with the view decoded
+ * when it arrived, whose payload follows the bytes to wherever they are
+ * kept, so handler threads do not decode it again.
+ *
+ * All methods are thread-safe.
+ */
+class InboundQueue {
+public:
+    InboundQueue(size_t capacity, ShedPolicy policy, MessageHandler handler);
+    ~InboundQueue();
+
+    InboundQueue(const InboundQueue&) = delete;
+    InboundQueue& operator=(const InboundQueue&) = delete;
+
+    // Start the handler threads
+    bool start(size_t threads);
+
+    // Stop the handler threads and drop every queued message
+    void stop();
+
+    // Queue a received message along with its decoded view; returns false if it was shed
+    bool push(const Datagram& datagram, const MessageView& message, InboundPriority priority);
+
+    // Get the number of queued messages
+    size_t size() const;
+
+    // Get a snapshot of the counters; rateLimited is left to the caller
+    InboundStats getStats() const;
+
+private:
+    struct Entry {
+        PooledBuffer buffer;
+        std::vector<uint8_t> bytes;
+        // The decoded message, its payload pointing into bytes or buffer
+        MessageView message;
+        // Bytes the entry holds: the message, or the whole pooled buffer it keeps
+        size_t footprint;
+        // Arrival order across all priorities
+        uint64_t sequence;
+    };
+
+    // Drop one queued message of at most the given urgency to make room; returns false if there is none.
+    // Called with the lock held.
+    bool shedFor(InboundPriority priority);
+
+    // Remove the oldest message of a priority and count it as shed; called with the lock held
+    void dropFront(size_t priority);
+
+    void run();
+
+    size_t capacity_;
+    ShedPolicy policy_;
+    MessageHandler handler_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;
+    std::array<std::deque<Entry>, INBOUND_PRIORITY_COUNT> queues_;
+    size_t count_;
+    size_t bytes_;
+    uint64_t nextSequence_;
+    bool running_;
+    std::vector<std::thread> threads_;
+
+    std::atomic<uint64_t> queued_;
+    std::array<std::atomic<uint64_t>, INBOUND_PRIORITY_COUNT> shed_;
+};
+
+} // namespace kademlia
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "transport.h"
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <linux/io_uring.h>
+
+namespace kademlia {
+
+/**
+ * @brief IOUringLoop class driving one UDP socket through an io_uring
+ *
+ * The ring is set up with raw system calls, so no liburing is needed. A
+ * single multishot recvmsg stays armed on the socket and the kernel picks
+ * a buffer from a registered provided-buffer ring for every datagram.
+ * Outgoing batches become one sendmsg entry per datagram and are submitted
+ * together with the next wait, so a busy loop makes one io_uring_enter
+ * call per wakeup for both directions. A one-shot poll on the wake
+ * descriptor ends the wait when the transport stops. Provided buffers come
+ * from a BufferPool; one still referenced by a handler when it is handed
+ * back is replaced with a fresh buffer.
+ *
+ * An IOUringLoop belongs to one thread and is not synchronized.
+ */
+class IOUringLoop {
+public:
+    IOUringLoop();
+    ~IOUringLoop();
+
+    IOUringLoop(const IOUringLoop&) = delete;
+    IOUringLoop& operator=(const IOUringLoop&) = delete;
+
+    // Check once whether the kernel supports everything the loop needs
+    static bool isSupported();
+
+    // Set up the ring and bufferCount provided buffers of bufferSize bytes for the socket
+    bool init(int sockfd, int wakeFd, size_t bufferCount, size_t bufferSize, TransportCounters* counters);
+
+    // Submit queued work, wait up to timeoutMs for completions and handle them; returns the datagrams received
+    size_t poll(int timeoutMs, const ReceiveHandler& onReceive);
+
+    // Queue one sendmsg per prepared datagram; the loop owns the buffers until every send completes
+    void submitSends(SendBuffers&& buffers);
+
+    // Get an empty buffer set, reusing one whose sends have completed
+    SendBuffers takeSpareBuffers();
+
+private:
+    // Kinds of operations, kept in the top byte of user_data
+    enum class Operation : uint8_t {
+        RECEIVE = 1,
+        WAKE = 2,
+        SEND = 3,
+        CANCEL = 4
+    };
+
+    struct InFlightSends {
+        SendBuffers buffers;
+        size_t remaining = 0;
+    };
+
+    // Get a free submission entry, submitting queued ones first if the ring is full
+    struct io_uring_sqe* nextSqe();
+
+    // Call io_uring_enter, counting the system call
+    int enter(unsigned toSubmit, unsigned minComplete, unsigned flags, const void* arg, size_t argSize);
+
+    // Arm the multishot receive and the wake poll if they are not armed
+    void arm();
+
+    // Hand a provided buffer back to the kernel; published by publishBuffers()
+    void recycleBuffer(uint16_t bufferID);
+
+    // Make recycled buffers visible to the kernel
+    void publishBuffers();
+
+    // Handle every available completion; returns the datagrams received
+    size_t reap(const ReceiveHandler& onReceive);
+
+    // Cancel the armed operations and wait until the kernel no longer uses any buffer
+    void drain();
+
+    // Unmap the rings and close the ring descriptor
+    void release();
+
+    static uint64_t makeUserData(Operation operation, uint32_t index);
+
+    int ringFd_;
+    int sockfd_;
+    int wakeFd_;
+    TransportCounters* counters_;
+
+    // Submission queue
+    void* sqRing_;
+    size_t sqRingSize_;
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned sqMask_;
+    unsigned sqEntries_;
+    unsigned* sqArray_;
+    struct io_uring_sqe* sqes_;
+    size_t sqesSize_;
+    unsigned pendingSubmit_;
+
+    // Completion queue
+    void* cqRing_;
+    size_t cqRingSize_;
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned cqMask_;
+    struct io_uring_cqe* cqes_;
+
+    // Provided buffers
+    struct io_uring_buf_ring* bufferRing_;
+    size_t bufferRingSize_;
+    unsigned bufferCount_;
+    size_t bufferSize_;
+    uint16_t bufferTail_;
+    bool buffersRegistered_;
+    std::unique_ptr<BufferPool> bufferPool_;
+    std::vector<PooledBuffer> buffers_;
+
+    // Template header for the multishot receive; only the name and control lengths are used
+    struct msghdr receiveHeader_;
+    bool receiveArmed_;
+    bool wakeArmed_;
+
+    // Send batches whose completions are outstanding, and reusable empty ones
+    std::vector<InFlightSends> sends_;
+    std::vector<uint32_t> freeSendSlots_;
+    std::vector<SendBuffers> spareBuffers_;
+    size_t sendsInFlight_;
+
+    // Reused for every received datagram
+    Datagram datagram_;
+};
+
+} // namespace kademlia
@@ -4,6 +4,15 @@
 #include "routing_table.h"
 #include "dht_key.h"
 #include "holepunch.h"
+#include "transport.h"
+#include "wire_format.h"
+#include "rpc_client.h"
+#include "node_lookup.h"
+#include "bulk_transfer.h"
+#include "rate_limiter.h"
+#include "inbound_queue.h"
+#include "single_flight.h"
+#include "storage.h"
 #include <string>
 #include <vector>
 #include <memory>
@@ -12,45 +21,119 @@
 #include <mutex>
 #include <thread>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 
 namespace kademlia {
 
+// Shortest sleep of the maintenance thread when it wakes early for a key expiry or a paced republish
+constexpr std::chrono::milliseconds MIN_MAINTENANCE_WAIT{1000};
+
+// Parts of the republish interval; keys coming due are collected once per part and sent spread over it
+constexpr size_t REPUBLISH_SLICES = 10;
+
+// Hole punch requests waiting for the hole punch thread before further ones are refused
+constexpr size_t MAX_QUEUED_HOLE_PUNCHES = 16;
+
 // Callback for DHT operations
 using DHTCallback = std::function<void(bool success, const std::vector<uint8_t>& value)>;
 
-// Callback for node lookup
-using NodeLookupCallback = std::function<void(bool success, const std::vector<NodePtr>& nodes)>;
-
-/**
- * @brief Enum representing the type of RPC message
- */
-enum class RPCType {
-    PING,
-    STORE,
-    FIND_NODE,
-    FIND_VALUE,
-    HOLE_PUNCH_REQUEST,
-    HOLE_PUNCH_RESPONSE
-};
+// Callback for node lookup, with statistics about the finished lookup
+using NodeLookupCallback = std::function<void(bool success, const std::vector<NodePtr>& nodes,
+                                              const LookupStats& stats)>;
 
 /**
- * @brief Struct representing an RPC message
+ * @brief Struct holding tunable parameters of a Kademlia node
  */
-struct RPCMessage {
-    RPCType type;
-    NodeID sender;
-    NodeID receiver;
-    std::string senderIP;
-    uint16_t senderPort;
-    std::vector<uint8_t> payload;
+struct KademliaConfig {
+    // Deadline of a request to a peer with no round-trip samples yet. Once a peer has answered, its
+    // deadline follows its measured round-trip time instead, between rpcMinTimeout and rpcMaxTimeout.
+    std::chrono::milliseconds rpcTimeout{1000};
+    
+    // Shortest deadline of a request to a peer with a measured round-trip time
+    std::chrono::milliseconds rpcMinTimeout{200};
+    
+    // Longest deadline of a single attempt, however slow the peer or often the request was resent
+    std::chrono::milliseconds rpcMaxTimeout{8000};
+    
+    // Times an unanswered request is sent again, waiting twice as long each time, before it fails
+    size_t rpcRetries = 1;
+    
+    // Number of lookup queries kept in flight
+    size_t alpha = 3;
+    
+    // Number of closest nodes a lookup returns and a value is replicated to
+    size_t k = K_VALUE;
+    
+    // Lifetime of a stored value; copies cached along a lookup path get a fraction of it
+    std::chrono::milliseconds valueTTL{std::chrono::hours(24)};
+    
+    // Event loop threads, each with its own SO_REUSEPORT socket on the node's port
+    size_t ioThreads = 1;
+    
+    // How the event loop threads wait for and move datagrams; io_uring falls back to epoll if unsupported
+    IOBackend ioBackend = IOBackend::EPOLL;
+    
+    // Datagrams received with one recvmmsg and sent with one sendmmsg (1 sends each reply on its own)
+    size_t ioBatchSize = 32;
+    
+    // Largest encoded message sent as a single datagram; larger ones, such as big values, are split into
+    // acknowledged fragments of at most this size
+    size_t maxDatagramSize = 1400;
+    
+    // Fragments of one large message sent ahead of their acknowledgements
+    size_t fragmentWindow = 64;
+    
+    // Messages per second accepted from one source address, in bursts of up to inboundBurst
+    // (0 disables the limit). Replies to our own outstanding requests are exempt.
+    double inboundRateLimit = 200;
+    double inboundBurst = 400;
+    
+    // Threads handling received messages, fed through a bounded priority queue by the event loop
+    // threads; 0 handles each message on the event loop thread that received it, without a queue
+    size_t handlerThreads = 0;
+    
+    // Messages waiting for a handler thread before the queue sheds, and which ones it sheds
+    size_t inboundQueueCapacity = 4096;
+    ShedPolicy shedPolicy = ShedPolicy::DROP_LOWEST_PRIORITY;
+    
+    // Relaxed bucket splitting: full buckets at depths not divisible by this also split (1 disables)
+    size_t relaxedSplitBits = 1;
+    
+    // Time between maintenance rounds, shortened when a stored key expires sooner; zero runs no maintenance
+    // thread and leaves maintain() to the caller
+    std::chrono::milliseconds maintenanceInterval{std::chrono::minutes(10)};
+    
+    // Time between refreshes of every bucket with a lookup for a random ID in its range
+    std::chrono::milliseconds refreshInterval{std::chrono::minutes(10)};
+    
+    // Time after which a value is stored again on its k closest nodes, counted from the last time it was
+    // stored here by anyone: the publisher, another replica republishing it, or this node
+    // republishing it. Only one replica per interval usually sends it.
+    std::chrono::milliseconds republishInterval{std::chrono::minutes(10)};
+    
+    // Directory of the log that keeps stored values across restarts; empty keeps them only in memory
+    std::string storageDirectory;
+    
+    // Longest time a stored value waits to be written to disk; values stored within it share one fsync
+    std::chrono::milliseconds storageSyncInterval{100};
+    
+    // ID of the local node; the all-zero ID picks a random one
+    NodeID nodeID;
 };
 
 /**
  * @brief Kademlia class implementing the Kademlia DHT
+ *
+ * The node sends and receives through a Transport. By default it owns a
+ * UDPTransport set up from the config; a LoopbackTransport lets many nodes
+ * run in one process.
  */
 class Kademlia {
 public:
-    Kademlia(uint16_t port, const std::string& bootstrapIP = "", uint16_t bootstrapPort = 0);
+    Kademlia(uint16_t port, const std::string& bootstrapIP = "", uint16_t bootstrapPort = 0,
+             const KademliaConfig& config = KademliaConfig(), std::shared_ptr<Transport> transport = nullptr);
     ~Kademlia();
     
     // Start the Kademlia node
@@ -62,15 +145,31 @@ public:
     // Store a key-value pair in the DHT
     void store(const DHTKey& key, const std::vector<uint8_t>& value, DHTCallback callback = nullptr);
     
-    // Find a value by key
+    // Store a value under a key known only by its hash
+    void store(const KeyHash& key, const std::vector<uint8_t>& value, DHTCallback callback = nullptr);
+    
+    // Find a value by key; concurrent calls for the same key share one lookup
     void findValue(const DHTKey& key, DHTCallback callback);
     
-    // Find the k closest nodes to the given key
+    // Find a value by the hash of its key
+    void findValue(const KeyHash& key, DHTCallback callback);
+    
+    // Find the k closest nodes to the given ID; concurrent calls for the same ID share one lookup
     void findNode(const NodeID& id, NodeLookupCallback callback);
     
-    // Ping a node
+    // Ping a node and wait for its reply
     bool ping(const NodePtr& node);
     
+    // Run one maintenance round: retry an unanswered bootstrap, expire old values, refresh if due, then collect
+    // and send the keys due for republishing
+    void maintain();
+    
+    // Check whether a value for the key is held in local storage
+    bool hasValue(const DHTKey& key) const;
+    
+    // Check whether a value for the key hash is held in local storage
+    bool hasValue(const KeyHash& key) const;
+    
     // Get the local node
     NodePtr getLocalNode() const;
     
@@ -80,8 +179,17 @@ public:
     // Get the hole puncher
     std::shared_ptr<HolePuncher> getHolePuncher() const;
     
+    // Get the fragmented transfer of large messages
+    std::shared_ptr<BulkTransfer> getBulkTransfer() const;
+    
+    // Get the client tracking outstanding requests and per-peer round-trip times
+    std::shared_ptr<RPCClient> getRPCClient() const;
+    
+    // Get the counters of messages refused by the rate limit or shed by the inbound queue
+    InboundStats getInboundStats() const;
+    
     // Handle an incoming RPC message
-    void handleRPC(const RPCMessage& message);
+    void handleRPC(const MessageView& message);
 
 private:
     // Bootstrap the node into the network
@@ -90,35 +198,99 @@ private:
     // Refresh buckets
     void refreshBuckets();
     
-    // Republish keys
+    // Group the keys coming due for republishing by their closest nodes and queue the groups, spaced over
+    // one slice of the interval
     void republishKeys();
     
+    // Send the queued republish groups whose time has come
+    void sendPacedRepublish(uint64_t now);
+    
+    // Look up the nodes closest to a group of keys and store all of them on each in batched STOREs,
+    // skipping keys another replica stored here since they were collected
+    void republishGroup(std::vector<KeyHash> keys, uint64_t roundMs);
+    
     // Expire old keys
     void expireKeys();
     
-    // Send an RPC message
-    bool sendRPC(const RPCMessage& message);
+    // Store a key-value pair in local storage for the given lifetime, as a replica or a cached copy; the
+    // only copy of a received value
+    void storeLocal(const KeyHash& key, ByteSpan value, uint64_t ttlMs, const NodeID& publisher, bool cached);
+    
+    // Send an RPC message to the given address
+    bool sendRPC(const RPCMessage& message, const std::string& ip, uint16_t port);
+    
+    // Send an RPC message to an IPv4 address in network byte order
+    bool sendRPC(const RPCMessage& message, uint32_t ip, uint16_t port);
+    
+    // Send a request tracked until its response or deadline, and return its transaction ID
+    uint32_t sendRequest(const NodePtr& node, RPCMessage message, RPCResponseCallback callback);
+    
+    // Create a message from the local node to the given receiver
+    RPCMessage createMessage(RPCType type, const NodeID& receiver) const;
     
-    // Process incoming messages
-    void processMessages();
+    // Fill in a response to the given request, keeping the message's payload allocation
+    void prepareResponse(RPCMessage& response, RPCType type, const MessageView& request) const;
+    
+    // Answer a request with the contacts closest to the target
+    void sendClosestContacts(RPCType type, const MessageView& request, const NodeID& target);
+    
+    // Admit a datagram received by an event loop thread: pass fragments to the bulk transfer and whole
+    // messages on to handleMessage()
+    void handleDatagram(const Datagram& datagram);
+    
+    // Decode a message's header, rate limit it if charge is set, then queue or handle it. A message
+    // reassembled from fragments is not charged again; its sender paid for the transfer.
+    void handleMessage(const Datagram& datagram, bool charge);
+    
+    // Queue a hole punch for the requester and the reply to send once it is done, starting the hole punch
+    // thread on first use
+    void queueHolePunch(const NodePtr& requester, std::vector<uint8_t> reply);
     
     // Node lookup procedure
     void nodeLookup(const NodeID& target, NodeLookupCallback callback);
     
     // Value lookup procedure
-    void valueLookup(const DHTKey& key, DHTCallback callback);
+    void valueLookup(const KeyHash& key, DHTCallback callback);
+    
+    KademliaConfig config_;
+    std::string bootstrapIP_;
+    uint16_t bootstrapPort_;
+    // Set once the bootstrap node has answered; maintain() retries until then
+    std::atomic<bool> bootstrapped_;
     
     NodePtr localNode_;
     std::shared_ptr<RoutingTable> routingTable_;
     std::shared_ptr<HolePuncher> holePuncher_;
-    std::unordered_map<std::string, std::vector<uint8_t>> storage_;
-    std::unordered_map<std::string, uint64_t> storageTimestamps_;
+    std::shared_ptr<Transport> transport_;
+    std::shared_ptr<RPCClient> rpcClient_;
+    std::shared_ptr<BulkTransfer> bulkTransfer_;
+    std::unique_ptr<RateLimiter> rateLimiter_;
+    std::unique_ptr<InboundQueue> inboundQueue_;
+    // Lookups in flight by target, with the callers waiting for each
+    SingleFlight<NodeID, NodeLookupCallback> nodeLookups_;
+    SingleFlight<NodeID, DHTCallback> valueLookups_;
+    Storage storage_;
     
     std::atomic<bool> running_;
-    std::thread messageThread_;
     std::thread maintenanceThread_;
+    std::mutex maintenanceMutex_;
+    std::condition_variable maintenanceWake_;
+    uint64_t nextRefreshMs_;
+    uint64_t nextRepublishMs_;
+    
+    // Republish groups waiting for their turn, the time the next one is due and the spacing between them
+    std::mutex republishMutex_;
+    std::deque<std::vector<KeyHash>> republishQueue_;
+    uint64_t nextRepublishSendMs_;
+    uint64_t republishPacingMs_;
+    // Wall-clock time the queued keys were collected
+    uint64_t republishRoundMs_;
     
-    mutable std::mutex storageMutex_;
+    // Hole punches block for seconds, so they run one at a time on their own thread, joined by stop()
+    std::mutex holePunchMutex_;
+    std::condition_variable holePunchWake_;
+    std::deque<std::pair<NodePtr, std::vector<uint8_t>>> holePunchQueue_;
+    std::thread holePunchThread_;
 };
 
 } // namespace kademlia
\ No newline at end of file
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "transport.h"
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace kademlia {
+
+class LoopbackTransport;
+
+/**
+ * @brief LoopbackNetwork class routing datagrams between transports in one process
+ *
+ * Every LoopbackTransport attached to the network is an endpoint with an
+ * IPv4 address and port. Sent datagrams are queued in one FIFO and
+ * delivered by run() on the calling thread, so a single thread driving the
+ * network sees the same delivery order on every run. Datagrams to an
+ * address with no endpoint are dropped.
+ *
+ * Sending is thread-safe. Endpoints should only be started or stopped
+ * while no other thread is inside run(). A call that blocks for a reply,
+ * such as Kademlia::ping(), needs another thread to run the network.
+ */
+class LoopbackNetwork {
+public:
+    LoopbackNetwork();
+
+    LoopbackNetwork(const LoopbackNetwork&) = delete;
+    LoopbackNetwork& operator=(const LoopbackNetwork&) = delete;
+
+    // Deliver queued datagrams, including ones sent while delivering, until the queue is empty
+    // or maxDatagrams were delivered; returns the number delivered
+    size_t run(size_t maxDatagrams = SIZE_MAX);
+
+    // Run the tick handler of every endpoint
+    void tick();
+
+    // Get the number of datagrams waiting for delivery
+    size_t getPendingCount() const;
+
+    // Get the number of datagrams delivered so far
+    uint64_t getDeliveredCount() const;
+
+    // Get the number of datagrams dropped for lack of an endpoint
+    uint64_t getDroppedCount() const;
+
+    // Get the number of attached endpoints
+    size_t getEndpointCount() const;
+
+private:
+    friend class LoopbackTransport;
+
+    struct Packet {
+        uint32_t fromIP;
+        uint16_t fromPort;
+        uint32_t toIP;
+        uint16_t toPort;
+        std::vector<uint8_t> data;
+    };
+
+    static uint64_t makeAddress(uint32_t ip, uint16_t port);
+
+    // Register an endpoint; port 0 picks a free port, which is written back
+    bool attach(LoopbackTransport* transport, uint32_t ip, uint16_t& port);
+
+    // Remove an endpoint; datagrams still queued for it are dropped on delivery
+    void detach(uint32_t ip, uint16_t port);
+
+    // Copy a datagram into the queue
+    void enqueue(uint32_t fromIP, uint16_t fromPort, uint32_t toIP, uint16_t toPort,
+                 const uint8_t* data, size_t length);
+
+    mutable std::mutex mutex_;
+    // Ordered by address, so ticks run in the same order every time
+    std::map<uint64_t, LoopbackTransport*> endpoints_;
+    std::deque<Packet> queue_;
+    // Payload vectors of delivered packets, reused by later sends
+    std::vector<std::vector<uint8_t>> spareData_;
+    uint16_t nextPort_;
+    uint64_t delivered_;
+    uint64_t dropped_;
+};
+
+/**
+ * @brief LoopbackTransport class attaching a node to a LoopbackNetwork
+ *
+ * Received datagrams are delivered on the thread running the network.
+ * Their bytes are valid only during the receive handler.
+ */
+class LoopbackTransport : public Transport {
+public:
+    explicit LoopbackTransport(LoopbackNetwork& network, const std::string& ip = "127.0.0.1");
+    ~LoopbackTransport() override;
+
+    LoopbackTransport(const LoopbackTransport&) = delete;
+    LoopbackTransport& operator=(const LoopbackTransport&) = delete;
+
+    // Attach to the network at the transport's address and the given port
+    bool start(uint16_t port, ReceiveHandler onReceive, TickHandler onTick) override;
+
+    // Detach from the network
+    void stop() override;
+
+    // Get the bound port
+    uint16_t getPort() const override;
+
+    using Transport::send;
+
+    // Queue a datagram on the network
+    bool send(uint32_t ip, uint16_t port, const uint8_t* data, size_t length) override;
+
+private:
+    friend class LoopbackNetwork;
+
+    LoopbackNetwork& network_;
+    uint32_t ip_;
+    uint16_t port_;
+    bool started_;
+    ReceiveHandler onReceive_;
+    TickHandler onTick_;
+};
+
+} // namespace kademlia
@@ -13,41 +13,94 @@ namespace kademlia {
 constexpr size_t KEY_BITS = 160;
 // Number of bytes in the key (160 bits = 20 bytes)
 constexpr size_t KEY_BYTES = KEY_BITS / 8;
+// A node not seen for this long is considered inactive (15 minutes)
+constexpr uint64_t INACTIVE_THRESHOLD_MS = 15 * 60 * 1000;
 
 /**
  * @brief NodeID class representing a 160-bit identifier
+ *
+ * The ID is held as three big-endian 64-bit words; the last word only uses
+ * its upper 32 bits. XOR, comparison and prefix-length operations work a
+ * word at a time and are constexpr.
  */
 class NodeID {
 public:
-    NodeID();
+    // Number of 64-bit words holding the ID
+    static constexpr size_t WORDS = 3;
+    
+    constexpr NodeID() : words_{{0, 0, 0}} {}
     explicit NodeID(const std::array<uint8_t, KEY_BYTES>& id);
     explicit NodeID(const std::string& hex);
     
+    // Build a NodeID from KEY_BYTES raw big-endian bytes
+    static NodeID fromBytes(const uint8_t* data);
+    
     // Generate a random NodeID
     static NodeID random();
     
+    // Generate a random NodeID whose first prefixBits bits match the prefix
+    static NodeID randomWithPrefix(const NodeID& prefix, size_t prefixBits);
+    
     // Calculate the distance between two NodeIDs (XOR metric)
-    NodeID distance(const NodeID& other) const;
+    constexpr NodeID distance(const NodeID& other) const {
+        return NodeID(words_[0] ^ other.words_[0], words_[1] ^ other.words_[1], words_[2] ^ other.words_[2]);
+    }
+    
+    // Get the number of leading zero bits (KEY_BITS for the all-zero ID)
+    constexpr size_t leadingZeroBits() const {
+        return words_[0] != 0 ? static_cast<size_t>(__builtin_clzll(words_[0]))
+             : words_[1] != 0 ? 64 + static_cast<size_t>(__builtin_clzll(words_[1]))
+             : words_[2] != 0 ? 128 + static_cast<size_t>(__builtin_clzll(words_[2]))
+             : KEY_BITS;
+    }
+    
+    // Get the number of leading bits shared with another NodeID
+    constexpr size_t commonPrefixLength(const NodeID& other) const {
+        return distance(other).leadingZeroBits();
+    }
     
     // Get the bit at the specified position
     bool getBit(size_t position) const;
     
+    // Get a copy of the ID with the bit at the specified position set to value
+    NodeID withBit(size_t position, bool value) const;
+    
     // Get the byte at the specified position
     uint8_t getByte(size_t position) const;
     
+    // Get the 64-bit word at the specified position
+    constexpr uint64_t getWord(size_t position) const {
+        return words_[position];
+    }
+    
+    // Write the KEY_BYTES raw big-endian bytes to the output
+    void copyTo(uint8_t* out) const;
+    
     // Convert to string representation
     std::string toString() const;
     
     // Comparison operators
-    bool operator==(const NodeID& other) const;
-    bool operator!=(const NodeID& other) const;
-    bool operator<(const NodeID& other) const;
+    constexpr bool operator==(const NodeID& other) const {
+        return words_[0] == other.words_[0] && words_[1] == other.words_[1] && words_[2] == other.words_[2];
+    }
+    
+    constexpr bool operator!=(const NodeID& other) const {
+        return !(*this == other);
+    }
     
-    // Get the raw ID
-    const std::array<uint8_t, KEY_BYTES>& getRaw() const;
+    constexpr bool operator<(const NodeID& other) const {
+        return words_[0] != other.words_[0] ? words_[0] < other.words_[0]
+             : words_[1] != other.words_[1] ? words_[1] < other.words_[1]
+             : words_[2] < other.words_[2];
+    }
+    
+    // Get the raw ID bytes
+    std::array<uint8_t, KEY_BYTES> getRaw() const;
 
 private:
-    std::array<uint8_t, KEY_BYTES> id_;
+    constexpr NodeID(uint64_t w0, uint64_t w1, uint64_t w2) : words_{{w0, w1, w2}} {}
+    
+    std::array<uint64_t, WORDS> words_;
 };
 
 /**
@@ -56,11 +109,13 @@ private:
 class Node {
 public:
     Node(const NodeID& id, const std::string& ip, uint16_t port);
+    Node(const NodeID& id, const std::string& ip, uint16_t port, uint64_t lastSeen);
     
     // Getters
     const NodeID& getID() const;
     const std::string& getIP() const;
     uint16_t getPort() const;
+    uint64_t getLastSeen() const;
     
     // Update last seen timestamp
     void updateLastSeen();
@@ -91,13 +146,8 @@ namespace std {
     template<>
     struct hash<kademlia::NodeID> {
         size_t operator()(const kademlia::NodeID& id) const {
-            const auto& raw = id.getRaw();
             // Use the first 8 bytes as a hash
-            size_t result = 0;
-            for (size_t i = 0; i < 8 && i < raw.size(); ++i) {
-                result = (result << 8) | raw[i];
-            }
-            return result;
+            return static_cast<size_t>(id.getWord(0));
         }
     };
 }
\ No newline at end of file
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "node.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace kademlia {
+
+/**
+ * @brief Struct holding statistics about a finished lookup
+ */
+struct LookupStats {
+    // Longest referral chain from a seed contact to a node that answered
+    size_t hops = 0;
+    // Number of queries sent
+    size_t rpcs = 0;
+    // Number of queries that were answered
+    size_t responses = 0;
+    // Time from start to completion, on the monotonic clock in utils
+    uint64_t durationMs = 0;
+};
+
+/**
+ * @brief Struct holding the outcome of a lookup
+ */
+struct LookupResult {
+    bool success = false;
+    // The k closest nodes that answered
+    std::vector<NodePtr> nodes;
+    // Value lookups only: whether a peer returned the value, and the value itself
+    bool foundValue = false;
+    std::vector<uint8_t> value;
+    // Value lookups only: closest node on the path that answered without the value
+    NodePtr cacheNode;
+    // Number of live nodes in the shortlist closer to the target than cacheNode
+    size_t cacheNodeRank = 0;
+    LookupStats stats;
+};
+
+/**
+ * @brief NodeLookup class implementing the iterative Kademlia node and value lookup
+ *
+ * The lookup keeps a shortlist sorted by XOR distance to the target and
+ * keeps up to alpha queries in flight. When a response fails to bring a
+ * closer node, it queries every one of the k closest nodes not yet asked.
+ * It finishes once each of the k closest live nodes has answered. A value
+ * lookup also finishes as soon as any peer returns the value, and cancels
+ * the queries still in flight. Among unqueried nodes at the same log
+ * distance from the target, which are equally good next steps, the one
+ * with the lowest measured round-trip time is queried first.
+ *
+ * Instances are driven entirely by query replies and must be owned by a
+ * std::shared_ptr.
+ */
+class NodeLookup : public std::enable_shared_from_this<NodeLookup> {
+public:
+    enum class Mode {
+        FIND_NODE,
+        FIND_VALUE
+    };
+
+    /**
+     * @brief Struct holding the reply to a single query
+     */
+    struct QueryReply {
+        bool success = false;
+        std::vector<NodePtr> contacts;
+        bool hasValue = false;
+        std::vector<uint8_t> value;
+    };
+
+    // Reply to a single query
+    using QueryResultCallback = std::function<void(const QueryReply& reply)>;
+
+    // Send a query to a node and return a handle that can cancel it (0 if none)
+    using QueryFunction = std::function<uint32_t(const NodePtr& node, QueryResultCallback onReply)>;
+
+    // Cancel a query that is still in flight
+    using CancelFunction = std::function<void(uint32_t handle)>;
+
+    // Final result of the lookup
+    using CompletionCallback = std::function<void(const LookupResult& result)>;
+
+    // Get a node's smoothed round-trip time in milliseconds, or 0 if it was never measured
+    using RTTFunction = std::function<uint64_t(const NodeID& id)>;
+
+    NodeLookup(Mode mode, const NodeID& target, const NodeID& localID, size_t alpha, size_t k,
+               QueryFunction query, CancelFunction cancel, CompletionCallback callback,
+               RTTFunction rtt = nullptr);
+
+    // Start the lookup from the given seed contacts
+    void start(const std::vector<NodePtr>& seeds);
+
+    // Get the lookup target
+    const NodeID& getTarget() const;
+
+private:
+    enum class CandidateState {
+        NOT_QUERIED,
+        IN_FLIGHT,
+        RESPONDED,
+        HAS_VALUE,
+        FAILED
+    };
+
+    struct Candidate {
+        NodePtr node;
+        NodeID distance;
+        CandidateState state;
+        size_t depth;
+        uint32_t handle;
+    };
+
+    // Find the shortlist entry for a node ID
+    std::vector<Candidate>::iterator findCandidate(const NodeID& id);
+
+    // Insert contacts into the shortlist; returns true if the closest distance improved
+    bool mergeContacts(const std::vector<NodePtr>& contacts, size_t depth);
+
+    // Handle the reply to a query sent to the given node
+    void handleReply(const NodeID& id, const QueryReply& reply);
+
+    // Get the order in which to query a node among others at the same log distance, lowest first
+    uint64_t queryRank(const Candidate& candidate) const;
+
+    // Launch new queries or finish the lookup
+    void advance();
+
+    // Finish the lookup with the value returned by a peer
+    void finishWithValue(const std::vector<uint8_t>& value);
+
+    // Record the elapsed time in the statistics
+    void recordDuration();
+
+    Mode mode_;
+    NodeID target_;
+    NodeID localID_;
+    size_t alpha_;
+    size_t k_;
+    QueryFunction query_;
+    CancelFunction cancel_;
+    CompletionCallback callback_;
+    RTTFunction rtt_;
+
+    std::vector<Candidate> shortlist_;
+    size_t inFlight_;
+    bool finalRound_;
+    bool finished_;
+    LookupStats stats_;
+    uint64_t startTimeMs_;
+    std::mutex mutex_;
+};
+
+} // namespace kademlia
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+namespace kademlia {
+
+// Independently locked parts of the rate limiter, so receive threads rarely contend
+constexpr size_t RATE_LIMITER_SHARDS = 16;
+
+// Source addresses tracked at once; beyond this, idle sources are forgotten first
+constexpr size_t MAX_RATE_LIMITED_SOURCES = 65536;
+
+/**
+ * @brief RateLimiter class keeping a token bucket per source address
+ *
+ * Every source IPv4 address has a bucket holding up to burst tokens,
+ * refilled at the given rate. A datagram is allowed if its source address
+ * has a whole token left, and takes it. Ports are not part of the key, so
+ * a sender cannot get a fresh bucket by changing its source port; nodes
+ * behind one NAT address share a bucket. A bucket that has been idle long
+ * enough to refill is the same as none, so idle sources are forgotten when
+ * the table fills up.
+ *
+ * All methods are thread-safe.
+ */
+class RateLimiter {
+public:
+    RateLimiter(double ratePerSecond, double burst);
+
+    RateLimiter(const RateLimiter&) = delete;
+    RateLimiter& operator=(const RateLimiter&) = delete;
+
+    // Take a token from the source address's bucket; returns false if it is empty
+    bool allow(uint32_t ip, uint64_t now);
+
+    // Get the number of datagrams refused so far
+    uint64_t getRejectedCount() const;
+
+    // Get the number of sources with a bucket
+    size_t size() const;
+
+private:
+    struct Bucket {
+        double tokens;
+        uint64_t lastRefillMs;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<uint32_t, Bucket> buckets;
+        uint64_t lastSweepMs = 0;
+    };
+
+    // Make room in a full shard; called with the shard's lock held
+    void evict(Shard& shard, uint64_t now);
+
+    double ratePerMs_;
+    double burst_;
+    // Time an empty bucket takes to refill completely
+    uint64_t refillMs_;
+    std::array<Shard, RATE_LIMITER_SHARDS> shards_;
+    std::atomic<uint64_t> rejected_;
+};
+
+} // namespace kademlia
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "node.h"
-#include <list>
+#include "epoch.h"
+#include <atomic>
+#include <array>
 #include <vector>
 #include <mutex>
 #include <memory>
@@ -10,81 +12,199 @@ namespace kademlia {
 
 // K value for k-buckets (maximum number of nodes per bucket)
 constexpr size_t K_VALUE = 20;
+// A known contact seen again within this long is not moved in its bucket (1 minute)
+constexpr uint64_t LAST_SEEN_RESOLUTION_MS = 60 * 1000;
+
+/**
+ * @brief Struct holding a compact routing contact
+ */
+struct Contact {
+    NodeID id;
+    // IPv4 address in network byte order
+    uint32_t ip = 0;
+    uint16_t port = 0;
+    uint64_t lastSeen = 0;
+
+    // Create a contact from a node
+    static Contact fromNode(const Node& node);
+
+    // Create a node from the contact
+    NodePtr toNode() const;
+
+    // Check if the contact has been seen recently
+    bool isActive(uint64_t now) const;
+};
 
 /**
  * @brief KBucket class representing a k-bucket in the routing table
+ *
+ * Contacts are stored inline in a fixed array. Slots [0, size) are always
+ * occupied, so membership checks are a contiguous scan, and the LRU order
+ * is a separate array of slot indexes from least to most recently seen.
+ * KBucket is not synchronized; the routing table only modifies copies that
+ * readers cannot see yet.
  */
 class KBucket {
 public:
     KBucket();
-    
-    // Copy constructor
-    KBucket(const KBucket& other);
-    
-    // Move constructor
-    KBucket(KBucket&& other) noexcept;
-    
-    // Copy assignment operator
-    KBucket& operator=(const KBucket& other);
-    
-    // Move assignment operator
-    KBucket& operator=(KBucket&& other) noexcept;
-    
+
     // Add a node to the bucket
     bool addNode(const NodePtr& node);
-    
+
+    // Add a contact to the bucket, or mark it most recently seen if present
+    bool addContact(const Contact& contact);
+
+    // Check whether addContact would take a new contact, without modifying the bucket
+    bool hasRoom(uint64_t now) const;
+
     // Remove a node from the bucket
     bool removeNode(const NodeID& id);
-    
+
     // Get a node by ID
     NodePtr getNode(const NodeID& id) const;
-    
-    // Get all nodes in the bucket
+
+    // Get the contact record for an ID, or nullptr if absent
+    const Contact* findContact(const NodeID& id) const;
+
+    // Get all nodes in the bucket, least recently seen first
     std::vector<NodePtr> getNodes() const;
-    
+
     // Check if the bucket is full
     bool isFull() const;
-    
+
     // Get the number of nodes in the bucket
     size_t size() const;
 
+    // Call the visitor for each contact in slot order
+    template<typename Visitor>
+    void visitContacts(Visitor&& visitor) const {
+        for (size_t i = 0; i < size_; ++i) {
+            visitor(contacts_[i]);
+        }
+    }
+    
+    // Distribute the contacts by the bit at the given position, keeping their LRU order
+    void splitInto(size_t bit, KBucket& zero, KBucket& one) const;
+
 private:
-    std::list<NodePtr> nodes_;
-    std::shared_ptr<std::mutex> mutex_;
+    // Find the slot holding the given ID, or K_VALUE if absent
+    size_t findSlot(const NodeID& id) const;
+
+    // Move the slot to the most recently seen end of the LRU order
+    void touch(size_t slot);
+
+    std::array<Contact, K_VALUE> contacts_;
+    std::array<uint8_t, K_VALUE> order_;
+    uint8_t size_;
+};
+
+/**
+ * @brief Struct describing the ID range covered by one leaf bucket
+ */
+struct BucketRange {
+    // Leading bits shared by every ID in the range; the remaining bits are zero
+    NodeID prefix;
+    // Number of leading bits fixed by the prefix
+    size_t depth;
+    // Number of contacts in the bucket
+    size_t size;
 };
 
 /**
  * @brief RoutingTable class implementing the Kademlia routing table
+ *
+ * The table is a binary tree of k-buckets keyed by ID prefix, starting as a
+ * single bucket covering the whole key space. A full bucket is split in two
+ * only if its range covers the local ID, so the table holds more contacts
+ * close to the local node and few far away. With relaxedSplitBits b > 1, a
+ * full bucket at a depth that is not a multiple of b also splits, which
+ * keeps more contacts in unbalanced subtrees far from the local ID.
+ *
+ * Tree nodes are immutable once published. Readers take no lock: they
+ * enter an epoch and walk the current root. Writers are serialized, copy
+ * the path from the root to the leaf they change, publish the new root
+ * atomically and retire the replaced nodes to the EpochManager.
  */
 class RoutingTable {
 public:
-    explicit RoutingTable(const NodeID& localID);
-    
+    explicit RoutingTable(const NodeID& localID, size_t relaxedSplitBits = 1);
+    ~RoutingTable();
+
+    RoutingTable(const RoutingTable&) = delete;
+    RoutingTable& operator=(const RoutingTable&) = delete;
+
     // Add a node to the routing table
     bool addNode(const NodePtr& node);
-    
+
+    // Add a contact to the routing table, or refresh it if present
+    bool addContact(const Contact& contact);
+
     // Remove a node from the routing table
     bool removeNode(const NodeID& id);
-    
+
     // Find the k closest nodes to the given ID
     std::vector<NodePtr> findClosestNodes(const NodeID& id, size_t count = K_VALUE) const;
-    
+
+    // Find the closest contacts to the given ID, closest first, reusing the output vector
+    void findClosestContacts(const NodeID& id, size_t count, std::vector<Contact>& contacts) const;
+
     // Get a node by ID
     NodePtr getNode(const NodeID& id) const;
-    
+
     // Get all nodes in the routing table
     std::vector<NodePtr> getAllNodes() const;
+
+    // Get the ranges covered by the leaf buckets, in key order
+    std::vector<BucketRange> getBucketRanges() const;
     
-    // Get the bucket index for a given node ID
-    size_t getBucketIndex(const NodeID& id) const;
+    // Get the number of leaf buckets
+    size_t getBucketCount() const;
     
+    // Get the log-distance index of an ID (the length of its prefix shared with the local ID)
+    size_t getBucketIndex(const NodeID& id) const;
+
     // Get the local node ID
     const NodeID& getLocalID() const;
 
 private:
+    struct TreeNode {
+        // Leading bits shared by every ID in the subtree
+        NodeID prefix;
+        // Number of leading bits fixed by the prefix
+        size_t depth = 0;
+        // Subtrees for bit `depth` equal to 0 and 1, shared between versions; both null for a leaf
+        const TreeNode* children[2] = {nullptr, nullptr};
+        // Contacts of a leaf
+        KBucket bucket;
+        
+        bool isLeaf() const {
+            return children[0] == nullptr;
+        }
+    };
+    
+    // Find the leaf whose range covers the ID, recording the inner nodes on the way
+    static const TreeNode* findLeaf(const TreeNode* root, const NodeID& id,
+                                    std::vector<const TreeNode*>* path = nullptr);
+    
+    // Check whether a full leaf may be split
+    bool canSplit(const TreeNode& leaf) const;
+    
+    // Split an unpublished leaf into two new children by the next bit and return them
+    std::array<TreeNode*, 2> split(TreeNode& leaf);
+    
+    // Replace the leaf at the end of the path with a new subtree and publish the new root;
+    // requires writeMutex_
+    void publish(const std::vector<const TreeNode*>& path, const TreeNode* oldLeaf, TreeNode* newLeaf);
+    
+    // Delete a whole tree, including shared subtrees
+    static void destroy(const TreeNode* node);
+    
     NodeID localID_;
-    std::vector<KBucket> buckets_;
-    mutable std::mutex mutex_;
+    size_t relaxedSplitBits_;
+    mutable EpochManager epochs_;
+    std::atomic<const TreeNode*> root_;
+    std::atomic<size_t> bucketCount_;
+    std::mutex writeMutex_;
 };
 
-} // namespace kademlia
\ No newline at end of file
+} // namespace kademlia
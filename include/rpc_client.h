@@ -0,0 +1,116 @@
+#pragma once
+
+#include "wire_format.h"
+#include "rtt_estimator.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace kademlia {
+
+/**
+ * @brief Callback for an RPC request, invoked with the response or on failure
+ *
+ * The response views the received datagram and is only valid during the call.
+ */
+using RPCResponseCallback = std::function<void(bool success, const MessageView& response)>;
+
+/**
+ * @brief Function sending a request again under the same transaction ID; returns false if it could not be sent
+ */
+using RPCRetransmitFunction = std::function<bool()>;
+
+/**
+ * @brief RPCClient class tracking outstanding requests by transaction ID
+ *
+ * Pending requests are kept in a table keyed by transaction ID and indexed
+ * by deadline, so expiry only touches the requests that are actually due.
+ * Deadlines follow utils::getMonotonicTimeMillis(), so they move with a
+ * virtual clock. Callbacks are always invoked without the internal lock held.
+ *
+ * Unless a request is given its own timeout, its deadline comes from the
+ * peer's retransmission timeout in an RTTEstimator, which every reply to a
+ * request sent once updates. A request with a retransmit function is sent
+ * again when its deadline passes, up to maxRetries times and with the
+ * deadline doubled each time, and only fails after the last attempt.
+ */
+class RPCClient {
+public:
+    explicit RPCClient(std::chrono::milliseconds defaultTimeout = std::chrono::milliseconds(2000),
+                       std::chrono::milliseconds minTimeout = std::chrono::milliseconds(200),
+                       std::chrono::milliseconds maxTimeout = std::chrono::milliseconds(8000),
+                       size_t maxRetries = 0);
+
+    // Allocate a fresh transaction ID
+    uint32_t nextTransactionID();
+
+    // Track a request sent to the given peer; an all-zero peer ID accepts a reply from any node.
+    // A zero timeout uses the peer's estimated one; a retransmit function enables retries.
+    void addPending(uint32_t transactionID, const NodeID& peer, RPCResponseCallback callback,
+                    std::chrono::milliseconds timeout = std::chrono::milliseconds(0),
+                    RPCRetransmitFunction retransmit = nullptr);
+
+    // Complete the request matching a response; returns false if none was waiting
+    bool handleResponse(const MessageView& response);
+
+    // Check whether a request with the transaction ID is waiting for its response
+    bool isPending(uint32_t transactionID) const;
+
+    // Fail a request immediately
+    bool cancel(uint32_t transactionID);
+
+    // Retry or fail every request whose deadline has passed and return how many failed
+    size_t expire();
+
+    // Fail every outstanding request
+    void cancelAll();
+
+    // Get the number of outstanding requests
+    size_t pendingCount() const;
+
+    // Get the timeout used for a peer without round-trip samples
+    std::chrono::milliseconds getDefaultTimeout() const;
+
+    // Get the timeout the next request to the peer would wait for its first attempt
+    std::chrono::milliseconds getTimeout(const NodeID& peer) const;
+
+    // Get the peer's smoothed round-trip time in milliseconds, or 0 if it has no samples
+    uint64_t getSmoothedRTT(const NodeID& peer) const;
+
+    // Get the earliest deadline of an outstanding request, or 0 if there is none
+    uint64_t getNextDeadline() const;
+
+    // Get the number of requests sent again after a timeout
+    uint64_t getRetransmitCount() const;
+
+private:
+    struct PendingRequest {
+        NodeID peer;
+        RPCResponseCallback callback;
+        std::multimap<uint64_t, uint32_t>::iterator timer;
+        RPCRetransmitFunction retransmit;
+        // Time of the first send, deadline of the current attempt and number of sends so far
+        uint64_t sentMs;
+        uint64_t timeoutMs;
+        size_t attempts;
+    };
+
+    // Remove a request from both indexes and return its callback
+    RPCResponseCallback takePending(std::unordered_map<uint32_t, PendingRequest>::iterator it);
+
+    std::chrono::milliseconds defaultTimeout_;
+    uint64_t maxTimeoutMs_;
+    size_t maxRetries_;
+    std::atomic<uint32_t> nextID_;
+    std::atomic<uint64_t> retransmits_;
+    RTTEstimator rtt_;
+    std::unordered_map<uint32_t, PendingRequest> pending_;
+    // Deadlines in milliseconds of monotonic time
+    std::multimap<uint64_t, uint32_t> timers_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace kademlia
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "node.h"
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+namespace kademlia {
+
+// Peers whose round-trip times are remembered; the least recently updated one is forgotten first
+constexpr size_t MAX_RTT_PEERS = 8192;
+
+// Largest factor a peer's timeout is multiplied by while it only answers resent requests
+constexpr uint32_t MAX_RTT_BACKOFF = 64;
+
+/**
+ * @brief RTTEstimator class keeping a retransmission timeout per peer
+ *
+ * Each peer has a smoothed round-trip time and a mean deviation, updated
+ * from every sample as in TCP (RFC 6298): the timeout is the smoothed time
+ * plus four deviations, clamped between a minimum and a maximum. A peer
+ * without samples gets the initial timeout. Replies to requests that were
+ * sent more than once may answer any of the sends, so instead of a sample
+ * they multiply the peer's timeout by a backoff factor until the next
+ * sample, which lets a peer slower than its estimate answer a first send.
+ * Requests that are never answered leave the estimate alone, so a dead
+ * peer keeps a short timeout.
+ *
+ * RTTEstimator is not synchronized; RPCClient guards it with its own lock.
+ */
+class RTTEstimator {
+public:
+    RTTEstimator(uint64_t initialTimeoutMs, uint64_t minTimeoutMs, uint64_t maxTimeoutMs);
+
+    // Record a measured round trip to a peer and clear its backoff
+    void addSample(const NodeID& peer, uint64_t rttMs);
+
+    // Multiply the peer's timeout by the factor until its next sample
+    void backoff(const NodeID& peer, uint32_t factor);
+
+    // Get the time to wait for a reply from the peer
+    uint64_t getTimeout(const NodeID& peer) const;
+
+    // Get the peer's smoothed round-trip time, or 0 if it has no samples
+    uint64_t getSmoothedRTT(const NodeID& peer) const;
+
+    // Get the number of peers with an entry
+    size_t size() const;
+
+private:
+    struct Entry {
+        // Smoothed round-trip time and mean deviation in milliseconds; srtt is 0 until the first sample
+        double srtt = 0;
+        double rttvar = 0;
+        uint32_t backoff = 1;
+        // The peer's place in the update order
+        std::list<NodeID>::iterator position;
+    };
+
+    // Find or create the entry for a peer and mark it the most recently updated, evicting the stalest
+    // one if the table is full
+    Entry& entry(const NodeID& peer);
+
+    uint64_t initialTimeoutMs_;
+    uint64_t minTimeoutMs_;
+    uint64_t maxTimeoutMs_;
+    std::unordered_map<NodeID, Entry> entries_;
+    // Peers from the most to the least recently updated, so the stalest is found without a scan
+    std::list<NodeID> order_;
+};
+
+} // namespace kademlia
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace kademlia {
+
+/**
+ * @brief SingleFlight class sharing one operation among concurrent callers with the same key
+ *
+ * The first caller to join a key starts the operation; callers that join
+ * while it runs only attach their callback. When the operation completes,
+ * every attached callback is called with the same result, and the next
+ * caller to join starts a fresh operation.
+ *
+ * All methods are thread-safe. Callbacks are called without the internal
+ * lock held, so they may join again.
+ */
+template<typename Key, typename Callback>
+class SingleFlight {
+public:
+    SingleFlight() = default;
+
+    SingleFlight(const SingleFlight&) = delete;
+    SingleFlight& operator=(const SingleFlight&) = delete;
+
+    // Attach a callback to the key; returns true if the caller must start the operation
+    bool join(const Key& key, Callback callback) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto result = waiters_.try_emplace(key);
+        result.first->second.push_back(std::move(callback));
+        return result.second;
+    }
+
+    // Finish the operation for the key and call every attached callback with the result
+    template<typename... Args>
+    void complete(const Key& key, const Args&... args) {
+        std::vector<Callback> callbacks;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = waiters_.find(key);
+            if (it == waiters_.end()) {
+                return;
+            }
+            callbacks = std::move(it->second);
+            waiters_.erase(it);
+        }
+
+        for (const auto& callback : callbacks) {
+            if (callback) {
+                callback(args...);
+            }
+        }
+    }
+
+    // Get the number of operations in flight
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return waiters_.size();
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_map<Key, std::vector<Callback>> waiters_;
+};
+
+} // namespace kademlia
@@ -0,0 +1,202 @@
+#pragma once
+
+#include "node.h"
+#include "dht_key.h"
+#include "buffer_pool.h"
+#include "value_log.h"
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace kademlia {
+
+// Independently locked parts of the store; a power of two
+constexpr size_t STORAGE_SHARDS = 16;
+
+// Due expiry entries one shard handles per lock acquisition
+constexpr size_t STORAGE_EXPIRE_BATCH = 64;
+
+// Time between checks of a persistent store's log for a segment worth compacting
+constexpr std::chrono::milliseconds STORAGE_COMPACTION_INTERVAL{1000};
+
+/**
+ * @brief Struct holding one stored value and its metadata
+ */
+struct StoredValue {
+    // Empty while the value is held in the value log
+    std::vector<uint8_t> value;
+    // Node that sent the value: the local node for values stored through Kademlia::store()
+    NodeID publisher;
+    // Time of the last store, on the wall clock in utils
+    uint64_t storedMs = 0;
+    // Lifetime requested by the last store, and the time the value expires
+    uint64_t ttlMs = 0;
+    uint64_t expiresMs = 0;
+    // Set while the value is only a copy cached on a lookup path, which the node does not republish
+    bool cached = false;
+    // Deadline of the record's entry in its shard's expiry heap, which may be earlier than expiresMs
+    uint64_t scheduledMs = 0;
+    // Latest expiry, past expiresMs, of earlier records for the key that a persistent store's log may still
+    // hold; 0 if there are none. A key that goes before then leaves a tombstone, so they stay gone.
+    uint64_t shadowedMs = 0;
+    // Record holding the value in a persistent store's log; length 0 when the value is held in memory
+    ValueLocation location;
+};
+
+/**
+ * @brief Storage class holding the values a node stores, in lock-striped shards
+ *
+ * Values are keyed by their key's hash. Bits of the hash that the maps do
+ * not use pick one of STORAGE_SHARDS shards, each with its own map and
+ * lock, so operations on different keys rarely contend. Locks are held
+ * only to copy a value in or out, which is shorter than a reader-writer
+ * lock would save. No operation ever locks more than one shard at a time.
+ *
+ * Each shard keeps a min-heap with one expiry deadline per key. A store
+ * that extends a key's lifetime leaves its heap entry alone; when the
+ * entry comes due it is pushed back to the key's current expiry, so
+ * re-stores that extend never grow the heap. One that shortens it pushes
+ * an entry for the new deadline. Due entries are taken from the top of the
+ * heaps in batches of at most STORAGE_EXPIRE_BATCH per lock hold, and
+ * expired keys are invisible to reads from the moment they expire.
+ *
+ * A store opened on a directory is persistent: every put and erase is
+ * appended to a ValueLog there, the shards keep only each key's metadata
+ * and the location of its current record, and values are read from the
+ * log. Opening the directory again rebuilds the shards from the segment
+ * footers. A background thread compacts segments that are mostly dead by
+ * appending their current records again. Locks are always taken shard
+ * first, then log.
+ *
+ * All methods are thread-safe, except that open() must come before any
+ * other use.
+ */
+class Storage {
+public:
+    Storage() = default;
+    ~Storage();
+
+    Storage(const Storage&) = delete;
+    Storage& operator=(const Storage&) = delete;
+
+    // Keep values in a log in the directory, loading the unexpired ones it already holds, and start the
+    // compaction thread; returns false if the log cannot be opened
+    bool open(const std::string& directory, const ValueLogOptions& options, uint64_t now);
+
+    // Stop compacting and close the log, leaving the store empty; does nothing for an in-memory store
+    void close();
+
+    // Check whether values are kept in a log
+    bool isPersistent() const;
+
+    // Store a value for the given lifetime; returns true if the key was new. A replica expires exactly when
+    // its lifetime ends. A cached copy never shortens another cached copy's lifetime and never changes a
+    // replica.
+    bool put(const KeyHash& key, ByteSpan value, uint64_t ttlMs, const NodeID& publisher, uint64_t now,
+             bool cached = false);
+
+    // Copy the value for a key into the output; returns false if the key is absent or expired
+    bool get(const KeyHash& key, std::vector<uint8_t>& value, uint64_t now) const;
+
+    // Copy the whole record for a key into the output; returns false if the key is absent or expired
+    bool getRecord(const KeyHash& key, StoredValue& record, uint64_t now) const;
+
+    // Check whether an unexpired value is stored for the key
+    bool contains(const KeyHash& key, uint64_t now) const;
+
+    // Record that the key's current value was stored again at the given time, changing nothing else;
+    // returns false if the key is absent
+    bool touch(const KeyHash& key, uint64_t now);
+
+    // Remove a key; returns false if it was absent
+    bool erase(const KeyHash& key);
+
+    // Remove up to limit keys that expired at or before the given time and return how many were removed
+    size_t expire(uint64_t now, size_t limit = SIZE_MAX);
+
+    // Get the earliest deadline at which a key may expire, or UINT64_MAX if nothing is stored
+    uint64_t getNextExpiry() const;
+
+    // Rewrite the current records of the log segment with the most dead bytes, if one is past the
+    // threshold, and delete it; returns false if no segment was compacted
+    bool compact(uint64_t now);
+
+    // Make every change durable now, rather than at the log's next group commit
+    bool sync();
+
+    // Get a snapshot of the log's counters; all zero for an in-memory store
+    ValueLogStats getLogStats() const;
+
+    // Call the visitor with each key and record, one shard at a time. The visitor runs under
+    // the shard's lock and must not call back into the storage. The value of a record held in
+    // the log is empty.
+    template<typename Visitor>
+    void forEach(Visitor&& visitor) const {
+        for (const Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (const auto& entry : shard.records) {
+                visitor(entry.first, entry.second);
+            }
+        }
+    }
+
+    // Get the number of stored keys
+    size_t size() const;
+
+private:
+    // Padded to a cache line so shards locked by different threads do not share one
+    using Deadline = std::pair<uint64_t, KeyHash>;
+
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<KeyHash, StoredValue> records;
+        std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> deadlines;
+    };
+
+    // Pop up to limit due heap entries from the shard, adding the keys removed to the count; returns
+    // true if due entries may remain. Called with the shard's lock held.
+    bool expireShard(Shard& shard, uint64_t now, size_t limit, size_t& removed);
+
+    // Apply one record found in the log while opening it. Keys that expired without a tombstone while
+    // earlier records of theirs are still unexpired are added to shadows, with those records' expiry.
+    void recover(LogRecordType type, const KeyHash& key, const LogRecordMeta& meta, const ValueLocation& location,
+                 uint64_t now, std::unordered_map<KeyHash, uint64_t>& shadows);
+
+    // Append a tombstone keeping the key's earlier records from coming back on the next open until the
+    // given time; called with the shard's lock held, or by open()
+    void appendTombstone(const KeyHash& key, uint64_t untilMs);
+
+    // Copy a record's value out of memory or the log; called with the shard's lock held
+    bool readValue(const StoredValue& record, std::vector<uint8_t>& value) const;
+
+    // Drop every record, leaving the log alone
+    void clearShards();
+
+    void runCompaction();
+
+    // The maps hash on the first word of the key, so the shard comes from the second
+    Shard& shardFor(const KeyHash& key);
+    const Shard& shardFor(const KeyHash& key) const;
+
+    std::array<Shard, STORAGE_SHARDS> shards_;
+
+    // Set by open() and cleared by close(), while nothing else uses the store
+    std::unique_ptr<ValueLog> log_;
+
+    std::mutex compactionMutex_;
+    std::condition_variable compactionWake_;
+    bool compacting_ = false;
+    std::thread compactionThread_;
+};
+
+} // namespace kademlia
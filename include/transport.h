@@ -0,0 +1,288 @@
+#pragma once
+
+#include "buffer_pool.h"
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+namespace kademlia {
+
+class UDPTransport;
+class IOUringLoop;
+
+/**
+ * @brief Enum selecting how event loop threads wait for and move datagrams
+ */
+enum class IOBackend {
+    // epoll_wait, then recvmmsg and sendmmsg
+    EPOLL,
+    // One io_uring per thread with multishot receive into provided buffers and batched sends
+    IO_URING
+};
+
+/**
+ * @brief Struct holding a snapshot of transport counters
+ */
+struct TransportStats {
+    uint64_t syscalls = 0;
+    uint64_t datagramsReceived = 0;
+    uint64_t datagramsSent = 0;
+};
+
+/**
+ * @brief Struct holding the live counters behind TransportStats
+ */
+struct TransportCounters {
+    std::atomic<uint64_t> syscalls{0};
+    std::atomic<uint64_t> datagramsReceived{0};
+    std::atomic<uint64_t> datagramsSent{0};
+};
+
+/**
+ * @brief Struct describing one datagram of a received batch
+ */
+struct Datagram {
+    const uint8_t* data = nullptr;
+    size_t length = 0;
+    // IPv4 source address in network byte order
+    uint32_t fromIP = 0;
+    uint16_t fromPort = 0;
+    // Buffer holding the bytes; copy it to keep them valid after the handler returns.
+    // nullptr if the transport does not pool its buffers.
+    const PooledBuffer* buffer = nullptr;
+};
+
+/**
+ * @brief ReceiveBatch class holding pooled buffers for recvmmsg
+ *
+ * Every slot receives into its own buffer from a BufferPool, and the
+ * buffers are reused by every call to UDPTransport::receiveBatch, so
+ * datagrams stay valid only until the next call. A caller that copies a
+ * datagram's buffer reference keeps its bytes; the batch then puts a fresh
+ * buffer in that slot before receiving again.
+ */
+class ReceiveBatch {
+public:
+    explicit ReceiveBatch(size_t maxDatagrams, size_t datagramCapacity = 65536);
+
+    // Get the number of datagrams received by the last call
+    size_t size() const;
+
+    // Get the maximum number of datagrams per call
+    size_t capacity() const;
+
+    // Get a received datagram
+    const Datagram& operator[](size_t index) const;
+
+private:
+    friend class UDPTransport;
+
+    // Give every slot whose buffer is still referenced elsewhere a fresh one
+    void replaceRetainedBuffers();
+
+    size_t datagramCapacity_;
+    size_t count_;
+    BufferPool pool_;
+    std::vector<PooledBuffer> buffers_;
+    std::vector<Datagram> datagrams_;
+    std::vector<struct mmsghdr> headers_;
+    std::vector<struct iovec> iovecs_;
+    std::vector<struct sockaddr_in> addresses_;
+};
+
+/**
+ * @brief Struct holding datagrams queued for one batched send
+ *
+ * Datagrams are copied back to back into one buffer. prepare() builds the
+ * message headers for sendmmsg or io_uring from the queued datagrams.
+ */
+struct SendBuffers {
+    std::vector<uint8_t> data;
+    std::vector<size_t> offsets;
+    std::vector<struct sockaddr_in> destinations;
+    std::vector<struct mmsghdr> headers;
+    std::vector<struct iovec> iovecs;
+
+    // Get the number of queued datagrams
+    size_t size() const;
+
+    // Point the message headers at the queued datagrams
+    void prepare();
+
+    // Drop the queued datagrams, keeping the allocations
+    void clear();
+};
+
+/**
+ * @brief SendBatch class queueing outgoing datagrams for one sendmmsg call
+ *
+ * While a SendBatch is alive, UDPTransport::send calls on the same thread
+ * for the same transport copy the datagram into the batch instead of
+ * sending it. The batch is flushed when it fills up and when it goes out
+ * of scope. Batches are per-thread and need no locking.
+ */
+class SendBatch {
+public:
+    explicit SendBatch(UDPTransport& transport, size_t maxDatagrams = 32);
+    ~SendBatch();
+
+    SendBatch(const SendBatch&) = delete;
+    SendBatch& operator=(const SendBatch&) = delete;
+
+    // Send every queued datagram; returns the number sent
+    size_t flush();
+
+private:
+    friend class UDPTransport;
+
+    // Queue a datagram, flushing first if the batch is full
+    bool add(const struct sockaddr_in& destination, const uint8_t* data, size_t length);
+
+    UDPTransport& transport_;
+    SendBatch* previous_;
+    size_t maxDatagrams_;
+    SendBuffers buffers_;
+};
+
+// Called by an event loop thread for every datagram it receives
+using ReceiveHandler = std::function<void(const Datagram& datagram)>;
+
+// Called by an event loop thread after every wakeup, at least once per tick interval
+using TickHandler = std::function<void()>;
+
+/**
+ * @brief Transport interface moving a node's datagrams
+ *
+ * start() binds the node's port and starts delivering received datagrams
+ * to the receive handler. The tick handler runs regularly on a delivery
+ * thread, so request deadlines are enforced. send() may be called from any
+ * thread while the transport is started.
+ */
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    // Bind to the port (0 picks one) and start delivering datagrams
+    virtual bool start(uint16_t port, ReceiveHandler onReceive, TickHandler onTick) = 0;
+
+    // Stop delivering datagrams and release the port
+    virtual void stop() = 0;
+
+    // Get the bound port
+    virtual uint16_t getPort() const = 0;
+
+    // Send a datagram to an IPv4 address in network byte order
+    virtual bool send(uint32_t ip, uint16_t port, const uint8_t* data, size_t length) = 0;
+
+    // Send a datagram to a dotted IPv4 address
+    bool send(const std::string& ip, uint16_t port, const uint8_t* data, size_t length);
+};
+
+/**
+ * @brief UDPTransport class owning the node's bound UDP sockets
+ *
+ * The transport binds one or more sockets to the node's port. With more
+ * than one, every socket sets SO_REUSEPORT and the kernel spreads incoming
+ * datagrams across them by flow. startLoop() runs one epoll-driven thread
+ * per socket; a send from a loop thread leaves from that thread's socket,
+ * and a send from any other thread uses the first socket, so replies always
+ * leave from the node's advertised port. Datagrams can be received in
+ * batches with recvmmsg and sent in batches with sendmmsg (see SendBatch).
+ * The loop threads use epoll or, where the kernel supports it, io_uring.
+ * start() opens the sockets and starts the loop with the settings given to
+ * the constructor.
+ */
+class UDPTransport : public Transport {
+public:
+    explicit UDPTransport(size_t sockets = 1, IOBackend backend = IOBackend::EPOLL, size_t batchSize = 32);
+    ~UDPTransport() override;
+
+    UDPTransport(const UDPTransport&) = delete;
+    UDPTransport& operator=(const UDPTransport&) = delete;
+
+    // Open the configured sockets and start the event loop threads
+    bool start(uint16_t port, ReceiveHandler onReceive, TickHandler onTick) override;
+
+    // Stop the event loop and close the sockets
+    void stop() override;
+
+    // Open the given number of sockets and bind them to the given port
+    bool open(uint16_t port, size_t sockets = 1);
+
+    // Stop the event loop and close the sockets
+    void close();
+
+    // Check if the sockets are open
+    bool isOpen() const;
+
+    // Get the bound port
+    uint16_t getPort() const override;
+
+    // Get the number of bound sockets
+    size_t getSocketCount() const;
+
+    using Transport::send;
+
+    // Send a datagram to an IPv4 address in network byte order
+    bool send(uint32_t ip, uint16_t port, const uint8_t* data, size_t length) override;
+
+    // Wait up to timeoutMs for a datagram on the first socket and read it into the buffer
+    ssize_t receive(uint8_t* buffer, size_t capacity, std::string& fromIP, uint16_t& fromPort, int timeoutMs);
+
+    // Wait up to timeoutMs for datagrams on the first socket and read as many as the batch holds; returns the count
+    size_t receiveBatch(ReceiveBatch& batch, int timeoutMs);
+
+    // Start one event loop thread per socket, receiving and sending up to batchSize datagrams per syscall;
+    // IO_URING falls back to EPOLL when the kernel does not support it
+    bool startLoop(IOBackend backend, size_t batchSize, ReceiveHandler onReceive, TickHandler onTick,
+                   int tickMs = 100);
+
+    // Stop the event loop threads and wait for them to exit
+    void stopLoop();
+
+    // Get the backend the event loop runs on
+    IOBackend getBackend() const;
+
+    // Get a snapshot of the transport counters
+    TransportStats getStats() const;
+
+private:
+    friend class SendBatch;
+
+    // Get the socket sends from the calling thread should use
+    int socketForThread() const;
+
+    // Send a datagram to a resolved address, bypassing any active batch
+    bool sendTo(const struct sockaddr_in& destination, const uint8_t* data, size_t length);
+
+    // Read as many datagrams as the batch holds from a socket
+    size_t receiveFrom(int sockfd, ReceiveBatch& batch, int timeoutMs);
+
+    // Body of an epoll event loop thread
+    void runLoop(int sockfd, size_t batchSize, int tickMs);
+
+    // Body of an io_uring event loop thread
+    void runURingLoop(int sockfd, size_t batchSize, int tickMs);
+
+    size_t startSockets_;
+    IOBackend startBackend_;
+    size_t startBatchSize_;
+    std::vector<int> sockfds_;
+    uint16_t port_;
+    int wakeFd_;
+    IOBackend backend_;
+    std::atomic<bool> looping_;
+    TransportCounters counters_;
+    std::vector<std::thread> loopThreads_;
+    ReceiveHandler onReceive_;
+    TickHandler onTick_;
+};
+
+} // namespace kademlia
@@ -48,12 +48,33 @@ std::string arrayToHex(const std::array<uint8_t, N>& array) {
     return ss.str();
 }
 
+/**
+ * @brief Source of the current time in milliseconds
+ */
+using TimeSource = std::function<uint64_t()>;
+
+/**
+ * @brief Replace the clock behind getCurrentTimeMillis and getMonotonicTimeMillis
+ *
+ * Meant for simulations that run nodes on a virtual clock. Set it before
+ * any node starts and reset it after they have stopped.
+ *
+ * @param source The new time source, or nullptr to restore the system clocks
+ */
+void setTimeSource(TimeSource source);
+
 /**
  * @brief Get the current timestamp in milliseconds
  * @return The current timestamp
  */
 uint64_t getCurrentTimeMillis();
 
+/**
+ * @brief Get a monotonic time in milliseconds, for deadlines and durations
+ * @return The current monotonic time
+ */
+uint64_t getMonotonicTimeMillis();
+
 /**
  * @brief Calculate the XOR distance between two NodeIDs
  * @param a The first NodeID
@@ -86,6 +107,18 @@ std::vector<NodePtr> sortNodesByDistance(const std::vector<NodePtr>& nodes, cons
  */
 bool isNodeInList(const NodePtr& node, const std::vector<NodePtr>& nodes);
 
+/**
+ * @brief Get the calling thread's random engine, seeded from std::random_device on first use
+ * @return The engine behind random IDs and getRandomInRange
+ */
+std::mt19937_64& randomEngine();
+
+/**
+ * @brief Reseed the calling thread's random engine, making its random IDs reproducible
+ * @param seed The seed
+ */
+void seedRandom(uint64_t seed);
+
 /**
  * @brief Generate a random number in the given range
  * @param min The minimum value
@@ -94,9 +127,8 @@ bool isNodeInList(const NodePtr& node, const std::vector<NodePtr>& nodes);
  */
 template<typename T>
 T getRandomInRange(T min, T max) {
-    static std::mt19937 rng(std::random_device{}());
     std::uniform_int_distribution<T> dist(min, max);
-    return dist(rng);
+    return dist(randomEngine());
 }
 
 /**
@@ -106,6 +138,14 @@ T getRandomInRange(T min, T max) {
  */
 NodeID hashKey(const std::vector<uint8_t>& key);
 
+/**
+ * @brief Hash raw key bytes using SHA-1
+ * @param data The key bytes
+ * @param length The key length
+ * @return The hash as a NodeID
+ */
+NodeID hashKey(const uint8_t* data, size_t length);
+
 /**
  * @brief Parse an IP address and port from a string
  * @param address The address string (format: "ip:port")
@@ -122,6 +162,21 @@ bool parseAddress(const std::string& address, std::string& ip, uint16_t& port);
  */
 bool isValidIP(const std::string& ip);
 
+/**
+ * @brief Convert a dotted IPv4 address to its binary form
+ * @param ip The IP address string
+ * @param binary The output address in network byte order
+ * @return True if the address is a valid IPv4 address, false otherwise
+ */
+bool ipToBinary(const std::string& ip, uint32_t& binary);
+
+/**
+ * @brief Convert a binary IPv4 address to its dotted form
+ * @param binary The address in network byte order
+ * @return The IP address string
+ */
+std::string binaryToIP(uint32_t binary);
+
 /**
  * @brief Check if a port is valid
  * @param port The port to check
@@ -0,0 +1,250 @@
+#pragma once
+
+#include "node.h"
+#include "dht_key.h"
+#include "buffer_pool.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace kademlia {
+
+// Bytes of records after which the active segment is sealed and a new one started; at most 4 GB
+constexpr uint32_t VALUE_LOG_SEGMENT_BYTES = 64 * 1024 * 1024;
+
+// Bytes of a record ahead of its value: checksum, type, flags, key, publisher, three times and the value length
+constexpr size_t VALUE_LOG_RECORD_HEADER_SIZE = 4 + 1 + 1 + KEY_BYTES + KEY_BYTES + 8 + 8 + 8 + 4;
+
+/**
+ * @brief Enum representing what a value log record does to its key
+ */
+enum class LogRecordType : uint8_t {
+    // Stores the record's value
+    PUT = 1,
+    // Removes the key; kept until the value it removed would have expired
+    ERASE = 2
+};
+
+/**
+ * @brief Struct holding the metadata a value log record carries besides its value
+ */
+struct LogRecordMeta {
+    NodeID publisher;
+    uint64_t storedMs = 0;
+    uint64_t ttlMs = 0;
+    uint64_t expiresMs = 0;
+    bool cached = false;
+};
+
+/**
+ * @brief Struct representing where a record lies in the value log
+ */
+struct ValueLocation {
+    uint32_t segment = 0;
+    uint32_t offset = 0;
+    // Length of the whole record; 0 for a value that is not in the log
+    uint32_t length = 0;
+
+    bool operator==(const ValueLocation& other) const {
+        return segment == other.segment && offset == other.offset && length == other.length;
+    }
+};
+
+/**
+ * @brief Struct holding tunable parameters of a value log
+ */
+struct ValueLogOptions {
+    // Bytes of records in one segment
+    uint32_t segmentBytes = VALUE_LOG_SEGMENT_BYTES;
+
+    // Longest time an appended record waits to be made durable; records appended within it share one fsync
+    std::chrono::milliseconds syncInterval{100};
+
+    // Share of a sealed segment's record bytes that must be dead before it is compacted
+    double compactionThreshold = 0.5;
+};
+
+/**
+ * @brief Struct holding a snapshot of value log counters
+ */
+struct ValueLogStats {
+    size_t segments = 0;
+    // Record bytes in all segments, and how many of them belong to overwritten, erased or expired records
+    uint64_t bytes = 0;
+    uint64_t deadBytes = 0;
+    uint64_t syncs = 0;
+    uint64_t compactedSegments = 0;
+    // Bytes read from disk by the last open
+    uint64_t recoveryBytes = 0;
+};
+
+// Called for each record found by ValueLog::open, in the order the records were appended
+using LogRecoveryVisitor = std::function<void(LogRecordType type, const KeyHash& key, const LogRecordMeta& meta,
+                                              const ValueLocation& location)>;
+
+/**
+ * @brief ValueLog class storing values on disk in an append-only log of segment files
+ *
+ * Records are appended to the active segment, each with a CRC-32C of its
+ * contents. When the segment reaches segmentBytes it is sealed: an index
+ * of its records (keys, metadata and locations, without values) and a
+ * checksummed trailer are written after them. Opening the log reads only
+ * these footers; a segment without a valid footer, left by a crash, is
+ * scanned record by record, cut at the first damaged record and sealed.
+ *
+ * Appends are written to the file at once and made durable in groups: a
+ * sync thread calls fdatasync at most once per syncInterval for all
+ * records appended since the last one. A full segment is handed to the
+ * same thread, which writes its footer and syncs it, so an append that
+ * rolls the log onto a new segment never waits for the disk.
+ *
+ * The log does not know which records are current. Its owner keeps the
+ * index, reports records it no longer needs with release(), and compacts
+ * segments whose dead share exceeds compactionThreshold by appending
+ * their live records again and dropping them.
+ *
+ * All methods are thread-safe. Records of a segment can be read until the
+ * segment is dropped. Reads and releases find their segment in a snapshot
+ * of the segment map, replaced whenever a segment is added or dropped, so
+ * they never take the lock appends hold.
+ */
+class ValueLog {
+public:
+    explicit ValueLog(const ValueLogOptions& options = ValueLogOptions());
+    ~ValueLog();
+
+    ValueLog(const ValueLog&) = delete;
+    ValueLog& operator=(const ValueLog&) = delete;
+
+    // Open or create the log in a directory, calling the visitor with every record found, and start the sync
+    // thread; returns false if the directory or a segment cannot be opened. The expect callback, if given,
+    // is called first with the number of records the segment footers hold, so the owner can size its index.
+    bool open(const std::string& directory, const LogRecoveryVisitor& visitor,
+              const std::function<void(size_t records)>& expect = nullptr);
+
+    // Seal the active segment, make everything durable and close the files
+    void close();
+
+    // Append a record and return its location; the record is durable after the next sync
+    bool append(LogRecordType type, const KeyHash& key, const LogRecordMeta& meta, ByteSpan value,
+                ValueLocation& location);
+
+    // Read the value of a record, checking its checksum
+    bool read(const ValueLocation& location, std::vector<uint8_t>& value) const;
+
+    // Count a record as dead, so its segment may be compacted
+    void release(const ValueLocation& location);
+
+    // Make every appended record durable now
+    bool sync();
+
+    // Pick the sealed segment with the largest dead share above the threshold; returns false if there is none
+    bool findCompactionCandidate(uint32_t& segment) const;
+
+    // Call the visitor with each record of a sealed segment, from its footer
+    bool forEachRecord(uint32_t segment, const LogRecoveryVisitor& visitor) const;
+
+    // Delete a segment whose live records were all appended again and made durable by sync()
+    void dropSegment(uint32_t segment);
+
+    // Get a snapshot of the counters
+    ValueLogStats getStats() const;
+
+private:
+    struct IndexEntry {
+        LogRecordType type;
+        KeyHash key;
+        LogRecordMeta meta;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct Segment {
+        uint32_t id = 0;
+        int fd = -1;
+        std::string path;
+        // Bytes of records, which end where the footer of a sealed segment starts
+        uint64_t size = 0;
+        std::atomic<uint64_t> deadBytes{0};
+        // Set once the footer is durable
+        std::atomic<bool> sealed{false};
+
+        ~Segment();
+    };
+
+    using SegmentPtr = std::shared_ptr<Segment>;
+    using SegmentMap = std::map<uint32_t, SegmentPtr>;
+
+    // A full segment waiting for the sync thread to write its footer
+    struct PendingSeal {
+        SegmentPtr segment;
+        std::vector<IndexEntry> entries;
+    };
+
+    // Load one segment file, sealing it if it has no valid footer; called by open()
+    bool recoverSegment(const SegmentPtr& segment, const LogRecoveryVisitor& visitor);
+
+    // Read the trailer at the end of a sealed segment; returns false if there is none
+    bool readTrailer(const Segment& segment, uint32_t& count, uint64_t& indexOffset, uint32_t& checksum) const;
+
+    // Read the footer of a sealed segment into entries; returns false if it is missing or damaged
+    bool readFooter(const Segment& segment, std::vector<IndexEntry>& entries, uint64_t& recordBytes) const;
+
+    // Write the footer of the given entries after the segment's records and sync it
+    bool writeFooter(Segment& segment, const std::vector<IndexEntry>& entries);
+
+    // Queue the active segment for sealing and start a new one; called with the lock held
+    bool rollSegment();
+
+    // Create an empty segment file with the next ID, leaving its directory entry to the next sync; called
+    // with the lock held
+    SegmentPtr createSegment();
+
+    // Replace the snapshot readers use with the current segment map; called with the lock held
+    void publishSegments();
+
+    SegmentPtr findSegment(uint32_t id) const;
+
+    // Make the directory's entries durable, after a segment file was created or deleted
+    bool syncDirectory() const;
+
+    void runSync();
+
+    ValueLogOptions options_;
+    std::string directory_;
+
+    mutable std::mutex mutex_;
+    // Held across each round of sealing and fdatasync, so sync() cannot return while one that covers
+    // earlier appends is still in progress; taken before mutex_
+    std::mutex syncMutex_;
+    SegmentMap segments_;
+    // Copy of segments_ for lookups without the lock, read and replaced atomically
+    std::shared_ptr<const SegmentMap> snapshot_;
+    SegmentPtr active_;
+    // Entries of the active segment, written as its footer when it is sealed
+    std::vector<IndexEntry> activeEntries_;
+    std::vector<PendingSeal> pendingSeals_;
+    uint32_t nextSegmentID_;
+    bool dirty_;
+    // Set when a segment file was created since the directory was last synced
+    bool directoryDirty_;
+    // Set when a segment was queued for sealing, waking the sync thread before its interval is up
+    bool sealRequested_;
+    bool running_;
+    uint64_t syncs_;
+    uint64_t compactedSegments_;
+    uint64_t recoveryBytes_;
+
+    std::condition_variable syncWake_;
+    std::thread syncThread_;
+};
+
+} // namespace kademlia
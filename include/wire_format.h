@@ -0,0 +1,269 @@
+#pragma once
+
+#include "node.h"
+#include "dht_key.h"
+#include "routing_table.h"
+#include "buffer_pool.h"
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace kademlia {
+
+/**
+ * @brief Enum representing the type of RPC message
+ */
+enum class RPCType : uint8_t {
+    PING,
+    STORE,
+    FIND_NODE,
+    FIND_VALUE,
+    HOLE_PUNCH_REQUEST,
+    HOLE_PUNCH_RESPONSE
+};
+
+/**
+ * @brief Struct representing an RPC message
+ */
+struct RPCMessage {
+    RPCType type = RPCType::PING;
+    NodeID sender;
+    NodeID receiver;
+    std::string senderIP;
+    uint16_t senderPort = 0;
+    uint32_t transactionID = 0;
+    bool isResponse = false;
+    std::vector<uint8_t> payload;
+};
+
+/**
+ * @brief Struct representing a received RPC message without copying it
+ *
+ * The payload points into the receive buffer, so a view is only valid
+ * while the datagram it was decoded from is. A handler that needs the bytes
+ * later copies the buffer reference, which keeps them alive.
+ */
+struct MessageView {
+    RPCType type = RPCType::PING;
+    NodeID sender;
+    NodeID receiver;
+    // IPv4 address in network byte order
+    uint32_t senderIP = 0;
+    uint16_t senderPort = 0;
+    uint32_t transactionID = 0;
+    bool isResponse = false;
+    ByteSpan payload;
+    // Buffer holding the payload, or nullptr if the bytes are not pooled
+    const PooledBuffer* buffer = nullptr;
+};
+
+namespace wire {
+
+// First byte of every packet
+constexpr uint8_t MAGIC = 0x4B;
+// Version of the framing below
+constexpr uint8_t VERSION = 1;
+// Header flag marking a reply to a request
+constexpr uint8_t FLAG_RESPONSE = 0x01;
+
+// magic(1) version(1) type(1) flags(1) transactionID(4) sender(20) receiver(20) senderPort(2) payloadLength(4)
+constexpr size_t HEADER_SIZE = 4 + 4 + KEY_BYTES + KEY_BYTES + 2 + 4;
+// Largest payload that fits a single UDP datagram over IPv4
+constexpr size_t MAX_DATAGRAM_SIZE = 65507;
+// Encoded size of a contact: id(20) ipv4(4) port(2)
+constexpr size_t CONTACT_SIZE = KEY_BYTES + 4 + 2;
+
+// Bytes of one STORE record ahead of its value: key hash, lifetime, flags and value length
+constexpr size_t STORE_RECORD_HEADER_SIZE = KEY_BYTES + 4 + 1 + 4;
+
+// STORE record flag: the value is a copy cached on a lookup path, not a replica on the key's closest nodes
+constexpr uint8_t STORE_FLAG_CACHED = 0x01;
+
+// Type bytes of the frames carrying a message too large for one datagram; they never collide with an RPCType
+constexpr uint8_t FRAME_FRAGMENT = 0x80;
+constexpr uint8_t FRAME_FRAGMENT_ACK = 0x81;
+// magic(1) version(1) kind(1) flags(1) messageID(4) totalLength(4) index(4) fragmentSize(2)
+constexpr size_t FRAGMENT_HEADER_SIZE = 4 + 4 + 4 + 4 + 2;
+// magic(1) version(1) kind(1) flags(1) messageID(4) contiguous(4), followed by the selective ack bitmap
+constexpr size_t FRAGMENT_ACK_HEADER_SIZE = 4 + 4 + 4;
+
+/**
+ * @brief Struct describing one fragment of a large message
+ *
+ * Every fragment but the last carries exactly fragmentSize bytes, so the
+ * index alone gives a fragment's offset in the message.
+ */
+struct FragmentHeader {
+    uint32_t messageID = 0;
+    uint32_t totalLength = 0;
+    uint32_t index = 0;
+    uint16_t fragmentSize = 0;
+};
+
+/**
+ * @brief Encode a message into a caller-provided buffer
+ * @param message The message to encode
+ * @param buffer The output buffer
+ * @param capacity The size of the output buffer
+ * @return The number of bytes written, or 0 if the message does not fit
+ */
+size_t encodeMessage(const RPCMessage& message, uint8_t* buffer, size_t capacity);
+
+/**
+ * @brief Decode a message from a received packet
+ *
+ * The sender IP is not part of the framing; callers fill it in from the
+ * datagram's source address.
+ *
+ * @param data The packet bytes
+ * @param length The packet length
+ * @param message The output message
+ * @return True if the packet is a well-formed message, false otherwise
+ */
+bool decodeMessage(const uint8_t* data, size_t length, RPCMessage& message);
+
+/**
+ * @brief Decode a message from a received packet without copying its payload
+ *
+ * The view's payload points into the packet. The sender IP and buffer are
+ * left for the caller to fill in.
+ *
+ * @param data The packet bytes
+ * @param length The packet length
+ * @param message The output view
+ * @return True if the packet is a well-formed message, false otherwise
+ */
+bool decodeMessage(const uint8_t* data, size_t length, MessageView& message);
+
+/**
+ * @brief Get the frame kind of a packet
+ * @param data The packet bytes
+ * @param length The packet length
+ * @return FRAME_FRAGMENT or FRAME_FRAGMENT_ACK for fragmentation frames, 0 for anything else
+ */
+uint8_t frameKind(const uint8_t* data, size_t length);
+
+/**
+ * @brief Encode one fragment into a caller-provided buffer
+ * @param header The fragment header
+ * @param chunk The fragment's bytes
+ * @param length The number of bytes in the fragment
+ * @param buffer The output buffer
+ * @param capacity The size of the output buffer
+ * @return The number of bytes written, or 0 if the fragment does not fit
+ */
+size_t encodeFragment(const FragmentHeader& header, const uint8_t* chunk, size_t length,
+                      uint8_t* buffer, size_t capacity);
+
+/**
+ * @brief Decode a fragment and check it lies inside the message it belongs to
+ * @param data The packet bytes
+ * @param length The packet length
+ * @param header The output header
+ * @param chunk The output fragment bytes, pointing into the packet
+ * @return True if the packet is a well-formed fragment, false otherwise
+ */
+bool decodeFragment(const uint8_t* data, size_t length, FragmentHeader& header, ByteSpan& chunk);
+
+/**
+ * @brief Encode a fragment acknowledgement into a caller-provided buffer
+ *
+ * Fragments below contiguous have all arrived. Bit i of the bitmap, least
+ * significant bit of each byte first, marks fragment contiguous + i.
+ *
+ * @param messageID The message being acknowledged
+ * @param contiguous The number of leading fragments received
+ * @param bitmap The selective ack bitmap
+ * @param bitmapLength The bitmap length in bytes
+ * @param buffer The output buffer
+ * @param capacity The size of the output buffer
+ * @return The number of bytes written, or 0 if the acknowledgement does not fit
+ */
+size_t encodeFragmentAck(uint32_t messageID, uint32_t contiguous, const uint8_t* bitmap, size_t bitmapLength,
+                         uint8_t* buffer, size_t capacity);
+
+/**
+ * @brief Decode a fragment acknowledgement
+ * @param data The packet bytes
+ * @param length The packet length
+ * @param messageID The output message ID
+ * @param contiguous The output number of leading fragments received
+ * @param bitmap The output selective ack bitmap, pointing into the packet
+ * @return True if the packet is a well-formed acknowledgement, false otherwise
+ */
+bool decodeFragmentAck(const uint8_t* data, size_t length, uint32_t& messageID, uint32_t& contiguous,
+                       ByteSpan& bitmap);
+
+/**
+ * @brief Encode a STORE payload of one record: a key hash, lifetime, flags and length-prefixed value
+ * @param key The key hash
+ * @param value The value bytes
+ * @param ttlSeconds Requested lifetime of the value, or 0 for the receiver's default
+ * @param flags STORE_FLAG_* bits
+ * @param payload The output payload
+ */
+void encodeStorePayload(const KeyHash& key, ByteSpan value, uint32_t ttlSeconds, uint8_t flags,
+                        std::vector<uint8_t>& payload);
+
+/**
+ * @brief Append one more record to a STORE payload, which may carry any number of them
+ * @param key The key hash
+ * @param value The value bytes
+ * @param ttlSeconds Requested lifetime of the value, or 0 for the receiver's default
+ * @param flags STORE_FLAG_* bits
+ * @param payload The payload to extend
+ */
+void appendStoreRecord(const KeyHash& key, ByteSpan value, uint32_t ttlSeconds, uint8_t flags,
+                       std::vector<uint8_t>& payload);
+
+/**
+ * @brief Decode the first record of a STORE payload and advance past it
+ * @param payload The remaining payload bytes, advanced past the record on success
+ * @param key The output key hash
+ * @param value The output value, pointing into the payload
+ * @param ttlSeconds The output lifetime, 0 meaning the receiver's default
+ * @param flags The output STORE_FLAG_* bits
+ * @return True if a well-formed record was decoded, false otherwise
+ */
+bool decodeStoreRecord(ByteSpan& payload, KeyHash& key, ByteSpan& value, uint32_t& ttlSeconds, uint8_t& flags);
+
+/**
+ * @brief Encode a list of contacts as a count followed by fixed-size records
+ * @param nodes The contacts to encode
+ * @param payload The output payload
+ */
+void encodeContacts(const std::vector<NodePtr>& nodes, std::vector<uint8_t>& payload);
+
+/**
+ * @brief Encode a list of routing contacts as a count followed by fixed-size records
+ * @param contacts The contacts to encode
+ * @param payload The output payload
+ */
+void encodeContacts(const std::vector<Contact>& contacts, std::vector<uint8_t>& payload);
+
+/**
+ * @brief Decode a list of contacts
+ * @param payload The payload bytes
+ * @param nodes The output contacts
+ * @return True if the payload is well-formed, false otherwise
+ */
+bool decodeContacts(ByteSpan payload, std::vector<NodePtr>& nodes);
+
+/**
+ * @brief Encode a raw 20-byte NodeID payload
+ * @param id The NodeID
+ * @param payload The output payload
+ */
+void encodeNodeID(const NodeID& id, std::vector<uint8_t>& payload);
+
+/**
+ * @brief Decode a raw 20-byte NodeID payload
+ * @param payload The payload bytes
+ * @param id The output NodeID
+ * @return True if the payload holds exactly one NodeID, false otherwise
+ */
+bool decodeNodeID(ByteSpan payload, NodeID& id);
+
+} // namespace wire
+} // namespace kademlia
@@ -34,6 +34,7 @@ int main(int argc, char* argv[]) {
     uint16_t port = 4000; // Default port
     std::string bootstrapIP = ""; // Default: no bootstrap
     uint16_t bootstrapPort = 0;
+    kademlia::KademliaConfig config;
     
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
@@ -48,12 +49,23 @@ int main(int argc, char* argv[]) {
                 bootstrapPort = static_cast<uint16_t>(std::stoi(bootstrapArg.substr(pos + 1)));
             }
             
+            i++;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            config.ioThreads = static_cast<size_t>(std::stoul(argv[i + 1]));
+            i++;
+        } else if (strcmp(argv[i], "--handlers") == 0 && i + 1 < argc) {
+            config.handlerThreads = static_cast<size_t>(std::stoul(argv[i + 1]));
+            i++;
+        } else if (strcmp(argv[i], "--io-uring") == 0) {
+            config.ioBackend = kademlia::IOBackend::IO_URING;
+        } else if (strcmp(argv[i], "--data-dir") == 0 && i + 1 < argc) {
+            config.storageDirectory = argv[i + 1];
             i++;
         }
     }
     
     // Create a Kademlia node
-    kademlia::Kademlia dht(port, bootstrapIP, bootstrapPort);
+    kademlia::Kademlia dht(port, bootstrapIP, bootstrapPort, config);
     
     // Start the node
     if (!dht.start()) {
@@ -195,9 +207,11 @@ int main(int argc, char* argv[]) {
             kademlia::NodeID nodeID(nodeIDStr);
             
             // Find the closest nodes
-            dht.findNode(nodeID, [](bool success, const std::vector<kademlia::NodePtr>& nodes) {
+            dht.findNode(nodeID, [](bool success, const std::vector<kademlia::NodePtr>& nodes,
+                                    const kademlia::LookupStats& stats) {
                 if (success) {
-                    std::cout << "Found " << nodes.size() << " nodes:" << std::endl;
+                    std::cout << "Found " << nodes.size() << " nodes in " << stats.hops << " hops, "
+                              << stats.rpcs << " RPCs, " << stats.durationMs << " ms:" << std::endl;
                     for (const auto& node : nodes) {
                         std::cout << "  " << node->toString() << std::endl;
                     }
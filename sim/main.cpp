@@ -0,0 +1,167 @@
+// Command-line driver for the discrete-event simulator. Runs one join,
+// store and churn scenario with the given parameters and prints lookup
+// success, hops, RPCs and value replication before and after churn.
+
+#include "sim/simulator.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace kademlia;
+using namespace kademlia::sim;
+
+namespace {
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]" << std::endl;
+    std::cout << "  --nodes N             initial nodes (default 1000)" << std::endl;
+    std::cout << "  --values N            values stored before churn (default 100)" << std::endl;
+    std::cout << "  --latency SPEC        constant:MS, uniform:MIN:MAX, exponential:MEAN or lognormal:MEDIAN:SIGMA"
+              << " (default uniform:20:80)" << std::endl;
+    std::cout << "  --loss P              datagram loss probability (default 0)" << std::endl;
+    std::cout << "  --joins-per-min R     node arrivals during churn (default 0)" << std::endl;
+    std::cout << "  --leaves-per-min R    node departures during churn (default 0)" << std::endl;
+    std::cout << "  --churn-minutes M     length of the churn phase (default 30)" << std::endl;
+    std::cout << "  --lookups-per-sec R   lookups during churn (default 1)" << std::endl;
+    std::cout << "  --alpha N             lookup parallelism (default 3)" << std::endl;
+    std::cout << "  --k N                 bucket size and replication factor (default 20)" << std::endl;
+    std::cout << "  --refresh-min M       bucket refresh interval (default 10)" << std::endl;
+    std::cout << "  --republish-min M     value republish interval (default 10)" << std::endl;
+    std::cout << "  --ttl-min M           value lifetime (default 1440)" << std::endl;
+    std::cout << "  --rpc-timeout-ms MS   RPC timeout for peers without RTT samples (default 1000)" << std::endl;
+    std::cout << "  --rpc-min-ms MS       shortest RPC timeout derived from measured RTT (default 200)" << std::endl;
+    std::cout << "  --rpc-retries N       resends of an unanswered RPC (default 1)" << std::endl;
+    std::cout << "  --seed N              random seed (default 1)" << std::endl;
+}
+
+template<typename T>
+T percentile(std::vector<T> values, size_t percent) {
+    if (values.empty()) {
+        return T();
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, values.size() * percent / 100)];
+}
+
+template<typename T>
+double mean(const std::vector<T>& values) {
+    double sum = 0;
+    for (T value : values) {
+        sum += static_cast<double>(value);
+    }
+    return values.empty() ? 0 : sum / static_cast<double>(values.size());
+}
+
+double ratio(size_t part, size_t whole) {
+    return whole == 0 ? 0 : 100.0 * static_cast<double>(part) / static_cast<double>(whole);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    SimulationConfig config;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string option = argv[i];
+
+            if (option == "--help" || option == "-h") {
+                printUsage(argv[0]);
+                return 0;
+            }
+
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << option << std::endl;
+                return 1;
+            }
+            std::string value = argv[++i];
+
+            if (option == "--nodes") {
+                config.initialNodes = std::stoul(value);
+            } else if (option == "--values") {
+                config.values = std::stoul(value);
+            } else if (option == "--latency") {
+                if (!LatencyModel::parse(value, config.latency)) {
+                    std::cerr << "Invalid latency model: " << value << std::endl;
+                    return 1;
+                }
+            } else if (option == "--loss") {
+                config.lossRate = std::stod(value);
+            } else if (option == "--joins-per-min") {
+                config.joinsPerMinute = std::stod(value);
+            } else if (option == "--leaves-per-min") {
+                config.leavesPerMinute = std::stod(value);
+            } else if (option == "--churn-minutes") {
+                config.churnDurationMs = static_cast<uint64_t>(std::stod(value) * 60 * 1000);
+            } else if (option == "--lookups-per-sec") {
+                config.lookupsPerSecond = std::stod(value);
+            } else if (option == "--alpha") {
+                config.node.alpha = std::stoul(value);
+            } else if (option == "--k") {
+                config.node.k = std::stoul(value);
+            } else if (option == "--refresh-min") {
+                config.node.refreshInterval = std::chrono::minutes(std::stoul(value));
+            } else if (option == "--republish-min") {
+                config.node.republishInterval = std::chrono::minutes(std::stoul(value));
+            } else if (option == "--ttl-min") {
+                config.node.valueTTL = std::chrono::minutes(std::stoul(value));
+            } else if (option == "--rpc-timeout-ms") {
+                config.node.rpcTimeout = std::chrono::milliseconds(std::stoul(value));
+            } else if (option == "--rpc-min-ms") {
+                config.node.rpcMinTimeout = std::chrono::milliseconds(std::stoul(value));
+            } else if (option == "--rpc-retries") {
+                config.node.rpcRetries = std::stoul(value);
+            } else if (option == "--seed") {
+                config.seed = std::stoull(value);
+            } else {
+                std::cerr << "Unknown option: " << option << std::endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Invalid option value" << std::endl;
+        return 1;
+    }
+
+    if (config.initialNodes == 0 || config.lossRate < 0 || config.lossRate > 1) {
+        std::cerr << "Need at least one node and a loss probability between 0 and 1" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Simulating " << config.initialNodes << " nodes, latency " << config.latency.toString()
+              << ", loss " << config.lossRate << ", seed " << config.seed << std::endl;
+
+    Simulator simulator(config);
+    SimulationReport report = simulator.run();
+
+    double simulatedSeconds = static_cast<double>(report.simulatedMs) / 1000.0;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "nodes         joined " << report.nodesJoined << "  left " << report.nodesLeft
+              << "  alive " << report.nodesAlive << std::endl;
+    std::cout << "datagrams     sent " << report.datagramsSent << "  lost " << report.datagramsLost
+              << "  undeliverable " << report.datagramsUndeliverable << std::endl;
+    std::cout << "node lookups  " << report.nodeLookups << "  found closest "
+              << ratio(report.nodeLookupsSucceeded, report.nodeLookups) << "%" << std::endl;
+    std::cout << "hops          mean " << mean(report.hops) << "  p50 " << percentile(report.hops, 50)
+              << "  p99 " << percentile(report.hops, 99) << std::endl;
+    std::cout << "rpcs          mean " << mean(report.rpcs) << "  p50 " << percentile(report.rpcs, 50)
+              << "  p99 " << percentile(report.rpcs, 99) << std::endl;
+    std::cout << "latency ms    mean " << mean(report.durationsMs) << "  p50 " << percentile(report.durationsMs, 50)
+              << "  p99 " << percentile(report.durationsMs, 99) << std::endl;
+    std::cout << "rpc resends   " << report.rpcRetransmits << std::endl;
+    std::cout << "value lookups " << report.valueLookups << "  found "
+              << ratio(report.valueLookupsSucceeded, report.valueLookups) << "%" << std::endl;
+    std::cout << "aborted       " << report.lookupsAborted << std::endl;
+    std::cout << "replication   before churn " << 100.0 * report.beforeChurn.coverage << "% of k, "
+              << 100.0 * report.beforeChurn.available << "% available" << std::endl;
+    std::cout << "              after churn  " << 100.0 * report.afterChurn.coverage << "% of k, "
+              << 100.0 * report.afterChurn.available << "% available" << std::endl;
+    std::cout << "time          simulated " << simulatedSeconds << " s  wall " << report.wallSeconds << " s  ("
+              << (report.wallSeconds > 0 ? simulatedSeconds / report.wallSeconds : 0) << "x)" << std::endl;
+
+    return 0;
+}
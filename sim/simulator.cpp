@@ -0,0 +1,516 @@
+#include "sim/simulator.h"
+#include "include/utils.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+
+namespace kademlia {
+namespace sim {
+
+namespace {
+
+// Every simulated node listens on this port at its own address
+constexpr uint16_t NODE_PORT = 4000;
+
+// Simulated nodes get consecutive addresses from 10.0.0.1
+constexpr uint32_t FIRST_ADDRESS = 0x0A000001;
+
+std::vector<std::string> split(const std::string& text, char separator) {
+    std::vector<std::string> parts;
+    std::stringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, separator)) {
+        parts.push_back(part);
+    }
+    return parts;
+}
+
+} // namespace
+
+// LatencyModel implementation
+bool LatencyModel::parse(const std::string& text, LatencyModel& model) {
+    std::vector<std::string> parts = split(text, ':');
+    if (parts.empty()) {
+        return false;
+    }
+
+    try {
+        if (parts[0] == "constant" && parts.size() == 2) {
+            model.kind = Kind::CONSTANT;
+            model.a = std::stod(parts[1]);
+            model.b = 0;
+        } else if (parts[0] == "uniform" && parts.size() == 3) {
+            model.kind = Kind::UNIFORM;
+            model.a = std::stod(parts[1]);
+            model.b = std::stod(parts[2]);
+        } else if (parts[0] == "exponential" && parts.size() == 2) {
+            model.kind = Kind::EXPONENTIAL;
+            model.a = std::stod(parts[1]);
+            model.b = 0;
+        } else if (parts[0] == "lognormal" && parts.size() == 3) {
+            model.kind = Kind::LOG_NORMAL;
+            model.a = std::stod(parts[1]);
+            model.b = std::stod(parts[2]);
+        } else {
+            return false;
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    return model.a >= 0 && model.b >= 0 && (model.kind != Kind::UNIFORM || model.a <= model.b);
+}
+
+uint64_t LatencyModel::sample(std::mt19937_64& rng) const {
+    double delay = a;
+
+    switch (kind) {
+        case Kind::CONSTANT:
+            break;
+        case Kind::UNIFORM:
+            delay = std::uniform_real_distribution<double>(a, b)(rng);
+            break;
+        case Kind::EXPONENTIAL:
+            delay = a > 0 ? std::exponential_distribution<double>(1.0 / a)(rng) : 0;
+            break;
+        case Kind::LOG_NORMAL:
+            delay = a > 0 ? std::lognormal_distribution<double>(std::log(a), b)(rng) : 0;
+            break;
+    }
+
+    return static_cast<uint64_t>(std::llround(delay));
+}
+
+std::string LatencyModel::toString() const {
+    std::ostringstream out;
+    switch (kind) {
+        case Kind::CONSTANT:
+            out << "constant:" << a;
+            break;
+        case Kind::UNIFORM:
+            out << "uniform:" << a << ":" << b;
+            break;
+        case Kind::EXPONENTIAL:
+            out << "exponential:" << a;
+            break;
+        case Kind::LOG_NORMAL:
+            out << "lognormal:" << a << ":" << b;
+            break;
+    }
+    return out.str();
+}
+
+/**
+ * @brief Transport of one simulated node, handing every send to the simulator
+ */
+class Simulator::SimTransport : public Transport {
+public:
+    SimTransport(Simulator& simulator, size_t index) : simulator_(simulator), index_(index), started_(false) {}
+
+    bool start(uint16_t, ReceiveHandler onReceive, TickHandler onTick) override {
+        onReceive_ = std::move(onReceive);
+        onTick_ = std::move(onTick);
+        started_ = true;
+        return true;
+    }
+
+    void stop() override {
+        started_ = false;
+    }
+
+    uint16_t getPort() const override {
+        return NODE_PORT;
+    }
+
+    using Transport::send;
+
+    bool send(uint32_t ip, uint16_t port, const uint8_t* data, size_t length) override {
+        return started_ && simulator_.send(index_, ip, port, data, length);
+    }
+
+    void deliver(const Datagram& datagram) {
+        if (started_ && onReceive_) {
+            onReceive_(datagram);
+        }
+    }
+
+    void tick() {
+        if (started_ && onTick_) {
+            onTick_();
+        }
+    }
+
+private:
+    Simulator& simulator_;
+    size_t index_;
+    bool started_;
+    ReceiveHandler onReceive_;
+    TickHandler onTick_;
+};
+
+// Simulator implementation
+Simulator::Simulator(const SimulationConfig& config)
+    : config_(config), rng_(config.seed), nowMs_(0), nextSequence_(0) {
+    // Nodes are driven by events, not by their own maintenance threads
+    config_.node.maintenanceInterval = std::chrono::milliseconds(0);
+}
+
+Simulator::~Simulator() {
+    for (SimNode& node : nodes_) {
+        if (node.node) {
+            node.node->stop();
+        }
+    }
+    nodes_.clear();
+    utils::setTimeSource(nullptr);
+}
+
+SimulationReport Simulator::run() {
+    auto wallStart = std::chrono::steady_clock::now();
+
+    // Every clock read and random ID inside the nodes now follows the simulation
+    utils::setTimeSource([this]() {
+        return nowMs_;
+    });
+    utils::seedRandom(rng_());
+
+    // Join phase: one node every joinSpacingMs
+    for (size_t i = 0; i < config_.initialNodes; ++i) {
+        schedule(nowMs_ + i * config_.joinSpacingMs, [this]() {
+            joinNode();
+        });
+    }
+    runUntil(nowMs_ + config_.initialNodes * config_.joinSpacingMs + config_.settleMs);
+
+    // Store phase
+    storeValues();
+    runUntil(nowMs_ + config_.settleMs);
+    report_.beforeChurn = measureReplication();
+
+    // Churn phase
+    uint64_t churnEnd = nowMs_ + config_.churnDurationMs;
+    schedulePoisson(config_.joinsPerMinute / 60000.0, churnEnd, [this]() {
+        joinNode();
+    });
+    schedulePoisson(config_.leavesPerMinute / 60000.0, churnEnd, [this]() {
+        leaveRandomNode();
+    });
+    schedulePoisson(config_.lookupsPerSecond / 1000.0, churnEnd, [this]() {
+        startLookup();
+    });
+    runUntil(churnEnd);
+
+    // Let the last lookups finish
+    runUntil(nowMs_ + config_.settleMs);
+    report_.afterChurn = measureReplication();
+
+    report_.nodesAlive = liveNodes_.size();
+    for (size_t index : liveNodes_) {
+        report_.rpcRetransmits += nodes_[index].node->getRPCClient()->getRetransmitCount();
+    }
+    report_.simulatedMs = nowMs_;
+    report_.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    return report_;
+}
+
+void Simulator::schedule(uint64_t timeMs, std::function<void()> action) {
+    events_.push_back(Event{std::max(timeMs, nowMs_), nextSequence_++, std::move(action)});
+    std::push_heap(events_.begin(), events_.end(), [](const Event& a, const Event& b) {
+        return a.time != b.time ? a.time > b.time : a.sequence > b.sequence;
+    });
+}
+
+void Simulator::runUntil(uint64_t timeMs) {
+    auto later = [](const Event& a, const Event& b) {
+        return a.time != b.time ? a.time > b.time : a.sequence > b.sequence;
+    };
+
+    while (!events_.empty() && events_.front().time <= timeMs) {
+        std::pop_heap(events_.begin(), events_.end(), later);
+        Event event = std::move(events_.back());
+        events_.pop_back();
+
+        nowMs_ = event.time;
+        event.action();
+    }
+
+    nowMs_ = std::max(nowMs_, timeMs);
+}
+
+void Simulator::joinNode() {
+    size_t index = nodes_.size();
+    size_t bootstrap = randomLiveNode();
+
+    nodes_.emplace_back();
+    SimNode& simNode = nodes_.back();
+    simNode.ip = htonl(FIRST_ADDRESS + static_cast<uint32_t>(index));
+    simNode.transport = std::make_shared<SimTransport>(*this, index);
+    nodesByIP_[simNode.ip] = index;
+
+    KademliaConfig config = config_.node;
+    config.nodeID = NodeID::random();
+
+    std::string bootstrapIP = bootstrap != SIZE_MAX ? utils::binaryToIP(nodes_[bootstrap].ip) : "";
+    simNode.node = std::make_unique<Kademlia>(NODE_PORT, bootstrapIP, bootstrap != SIZE_MAX ? NODE_PORT : 0,
+                                              config, simNode.transport);
+
+    simNode.alive = true;
+    simNode.livePosition = liveNodes_.size();
+    liveNodes_.push_back(index);
+    report_.nodesJoined++;
+
+    // Start after registering, since starting sends the bootstrap ping
+    nodes_[index].node->start();
+
+    // Spread maintenance rounds so the nodes do not all refresh at once
+    uint64_t phase = config_.maintenanceCheckMs > 0 ? rng_() % config_.maintenanceCheckMs : 0;
+    schedule(nowMs_ + phase, [this, index]() {
+        maintainNode(index);
+    });
+}
+
+void Simulator::leaveRandomNode() {
+    size_t index = randomLiveNode();
+    if (index == SIZE_MAX) {
+        return;
+    }
+
+    // Remove the node from the live list by moving the last entry into its place
+    SimNode& simNode = nodes_[index];
+    size_t last = liveNodes_.back();
+    liveNodes_[simNode.livePosition] = last;
+    nodes_[last].livePosition = simNode.livePosition;
+    liveNodes_.pop_back();
+    simNode.alive = false;
+    report_.nodesLeft++;
+
+    // The node leaves silently; its outstanding lookups fail as it stops
+    report_.rpcRetransmits += simNode.node->getRPCClient()->getRetransmitCount();
+    simNode.node->stop();
+    simNode.node.reset();
+    simNode.transport.reset();
+}
+
+void Simulator::startLookup() {
+    size_t source = randomLiveNode();
+    if (source == SIZE_MAX) {
+        return;
+    }
+
+    // Alternate between node lookups for random IDs and value lookups for stored keys
+    bool valueLookup = !keys_.empty() && (rng_() & 1);
+
+    if (valueLookup) {
+        const DHTKey& key = keys_[rng_() % keys_.size()];
+        report_.valueLookups++;
+
+        nodes_[source].node->findValue(key, [this, source](bool success, const std::vector<uint8_t>&) {
+            if (!nodes_[source].alive) {
+                report_.valueLookups--;
+                report_.lookupsAborted++;
+                return;
+            }
+            report_.valueLookupsSucceeded += success;
+        });
+        return;
+    }
+
+    NodeID target = NodeID::random();
+    report_.nodeLookups++;
+
+    nodes_[source].node->findNode(target,
+        [this, source, target](bool success, const std::vector<NodePtr>& result, const LookupStats& stats) {
+            if (!nodes_[source].alive) {
+                report_.nodeLookups--;
+                report_.lookupsAborted++;
+                return;
+            }
+
+            size_t closest = closestLiveNode(target, source);
+            if (success && !result.empty() && closest != SIZE_MAX &&
+                result.front()->getID() == nodes_[closest].node->getLocalNode()->getID()) {
+                report_.nodeLookupsSucceeded++;
+            }
+
+            report_.hops.push_back(stats.hops);
+            report_.rpcs.push_back(stats.rpcs);
+            report_.durationsMs.push_back(stats.durationMs);
+        });
+}
+
+void Simulator::storeValues() {
+    for (size_t i = 0; i < config_.values; ++i) {
+        size_t source = randomLiveNode();
+        if (source == SIZE_MAX) {
+            return;
+        }
+
+        DHTKey key("key-" + std::to_string(i));
+        std::string text = "value-" + std::to_string(i);
+        keys_.push_back(key);
+
+        nodes_[source].node->store(key, std::vector<uint8_t>(text.begin(), text.end()));
+    }
+}
+
+void Simulator::maintainNode(size_t index) {
+    if (!nodes_[index].alive) {
+        return;
+    }
+
+    nodes_[index].node->maintain();
+
+    if (config_.maintenanceCheckMs > 0) {
+        schedule(nowMs_ + config_.maintenanceCheckMs, [this, index]() {
+            maintainNode(index);
+        });
+    }
+}
+
+void Simulator::scheduleTick(size_t index, uint64_t timeMs) {
+    SimNode& simNode = nodes_[index];
+    if (simNode.tickAtMs != 0 && simNode.tickAtMs <= timeMs) {
+        return;
+    }
+
+    // A later check already scheduled becomes stale and is skipped when it runs
+    simNode.tickAtMs = timeMs;
+    schedule(timeMs, [this, index, timeMs]() {
+        tickNode(index, timeMs);
+    });
+}
+
+void Simulator::tickNode(size_t index, uint64_t timeMs) {
+    SimNode& simNode = nodes_[index];
+    if (simNode.tickAtMs != timeMs || !simNode.alive) {
+        return;
+    }
+    simNode.tickAtMs = 0;
+
+    simNode.transport->tick();
+
+    // Deadlines follow each peer's round-trip time, so check again at the earliest one left
+    uint64_t deadline = simNode.node->getRPCClient()->getNextDeadline();
+    if (deadline != 0) {
+        scheduleTick(index, std::max(deadline, nowMs_ + 1));
+    }
+}
+
+bool Simulator::send(size_t fromIndex, uint32_t ip, uint16_t port, const uint8_t* data, size_t length) {
+    report_.datagramsSent++;
+
+    // Any send may be a request, which is tracked before it is sent, so its deadline is known here.
+    // Other sends still get a check later for fragments awaiting acknowledgement.
+    uint64_t deadline = nodes_[fromIndex].node->getRPCClient()->getNextDeadline();
+    scheduleTick(fromIndex, deadline != 0 ? std::max(deadline, nowMs_ + 1)
+                                          : nowMs_ + static_cast<uint64_t>(config_.node.rpcTimeout.count()));
+
+    if (config_.lossRate > 0 && std::uniform_real_distribution<double>(0.0, 1.0)(rng_) < config_.lossRate) {
+        report_.datagramsLost++;
+        return true;
+    }
+
+    uint32_t fromIP = nodes_[fromIndex].ip;
+    std::vector<uint8_t> bytes(data, data + length);
+
+    schedule(nowMs_ + config_.latency.sample(rng_), [this, fromIP, ip, port, bytes]() {
+        auto it = nodesByIP_.find(ip);
+        if (it == nodesByIP_.end() || port != NODE_PORT || !nodes_[it->second].alive) {
+            report_.datagramsUndeliverable++;
+            return;
+        }
+
+        Datagram datagram;
+        datagram.data = bytes.data();
+        datagram.length = bytes.size();
+        datagram.fromIP = fromIP;
+        datagram.fromPort = NODE_PORT;
+        nodes_[it->second].transport->deliver(datagram);
+    });
+
+    return true;
+}
+
+void Simulator::schedulePoisson(double ratePerMs, uint64_t endMs, std::function<void()> action) {
+    if (ratePerMs <= 0) {
+        return;
+    }
+
+    uint64_t gap = static_cast<uint64_t>(std::llround(std::exponential_distribution<double>(ratePerMs)(rng_)));
+    uint64_t next = nowMs_ + gap;
+    if (next >= endMs) {
+        return;
+    }
+
+    schedule(next, [this, ratePerMs, endMs, action]() {
+        action();
+        schedulePoisson(ratePerMs, endMs, action);
+    });
+}
+
+size_t Simulator::randomLiveNode() {
+    if (liveNodes_.empty()) {
+        return SIZE_MAX;
+    }
+    return liveNodes_[rng_() % liveNodes_.size()];
+}
+
+size_t Simulator::closestLiveNode(const NodeID& id, size_t excluded) const {
+    size_t best = SIZE_MAX;
+    NodeID bestDistance;
+
+    for (size_t index : liveNodes_) {
+        if (index == excluded) {
+            continue;
+        }
+
+        NodeID distance = nodes_[index].node->getLocalNode()->getID().distance(id);
+        if (best == SIZE_MAX || distance < bestDistance) {
+            best = index;
+            bestDistance = distance;
+        }
+    }
+
+    return best;
+}
+
+ReplicationStats Simulator::measureReplication() const {
+    ReplicationStats stats;
+    if (keys_.empty() || liveNodes_.empty()) {
+        return stats;
+    }
+
+    size_t k = std::min(config_.node.k, liveNodes_.size());
+    std::vector<std::pair<NodeID, size_t>> byDistance;
+    byDistance.reserve(liveNodes_.size());
+
+    for (const DHTKey& key : keys_) {
+        const NodeID& target = key.getHash();
+
+        byDistance.clear();
+        bool available = false;
+        for (size_t index : liveNodes_) {
+            byDistance.emplace_back(nodes_[index].node->getLocalNode()->getID().distance(target), index);
+            available = available || nodes_[index].node->hasValue(key);
+        }
+
+        // Count the replicas among the k live nodes a lookup would converge on
+        std::partial_sort(byDistance.begin(), byDistance.begin() + k, byDistance.end());
+        size_t held = 0;
+        for (size_t i = 0; i < k; ++i) {
+            held += nodes_[byDistance[i].second].node->hasValue(key);
+        }
+
+        stats.coverage += static_cast<double>(held) / static_cast<double>(k);
+        stats.available += available ? 1.0 : 0.0;
+    }
+
+    stats.coverage /= static_cast<double>(keys_.size());
+    stats.available /= static_cast<double>(keys_.size());
+    return stats;
+}
+
+} // namespace sim
+} // namespace kademlia
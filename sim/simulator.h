@@ -0,0 +1,221 @@
+#pragma once
+
+#include "include/kademlia.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace kademlia {
+namespace sim {
+
+/**
+ * @brief Struct describing the one-way delay of a simulated datagram
+ */
+struct LatencyModel {
+    enum class Kind {
+        // Always a milliseconds
+        CONSTANT,
+        // Uniform in [a, b] milliseconds
+        UNIFORM,
+        // Exponential with mean a milliseconds
+        EXPONENTIAL,
+        // Log-normal with median a milliseconds and shape sigma b
+        LOG_NORMAL
+    };
+
+    Kind kind = Kind::UNIFORM;
+    double a = 20;
+    double b = 80;
+
+    // Parse "constant:MS", "uniform:MIN:MAX", "exponential:MEAN" or "lognormal:MEDIAN:SIGMA"
+    static bool parse(const std::string& text, LatencyModel& model);
+
+    // Draw one delay in milliseconds
+    uint64_t sample(std::mt19937_64& rng) const;
+
+    // Describe the model in the form parse() accepts
+    std::string toString() const;
+};
+
+/**
+ * @brief Struct holding the parameters of one simulation run
+ */
+struct SimulationConfig {
+    // Seed for every random choice, including node IDs and lookup targets
+    uint64_t seed = 1;
+
+    // Nodes joining before the churn phase, one every joinSpacingMs
+    size_t initialNodes = 1000;
+    uint64_t joinSpacingMs = 100;
+
+    // Values stored by random nodes once the initial nodes have joined
+    size_t values = 100;
+
+    // Network behaviour
+    LatencyModel latency;
+    double lossRate = 0.0;
+
+    // Churn phase: Poisson joins, leaves and lookups
+    uint64_t churnDurationMs = 30 * 60 * 1000;
+    double joinsPerMinute = 0.0;
+    double leavesPerMinute = 0.0;
+    double lookupsPerSecond = 1.0;
+
+    // How often each node's maintain() is called; it refreshes and republishes when those are due
+    uint64_t maintenanceCheckMs = 60 * 1000;
+
+    // Quiet time after the joins, the stores and the churn phase for outstanding work to finish
+    uint64_t settleMs = 30 * 1000;
+
+    // Settings of every node: alpha, k, RPC timeout, refresh and republish intervals
+    KademliaConfig node;
+};
+
+/**
+ * @brief Struct holding the replication of the stored values at one point in time
+ */
+struct ReplicationStats {
+    // Mean fraction of each value's k closest live nodes that hold it
+    double coverage = 0.0;
+    // Fraction of values held by at least one live node
+    double available = 0.0;
+};
+
+/**
+ * @brief Struct holding the results of a simulation run
+ */
+struct SimulationReport {
+    size_t nodesJoined = 0;
+    size_t nodesLeft = 0;
+    size_t nodesAlive = 0;
+
+    uint64_t datagramsSent = 0;
+    uint64_t datagramsLost = 0;
+    uint64_t datagramsUndeliverable = 0;
+
+    // Node lookups for random IDs; a lookup succeeds if it returns the closest live node
+    size_t nodeLookups = 0;
+    size_t nodeLookupsSucceeded = 0;
+    std::vector<size_t> hops;
+    std::vector<size_t> rpcs;
+    std::vector<uint64_t> durationsMs;
+
+    // Value lookups for stored keys
+    size_t valueLookups = 0;
+    size_t valueLookupsSucceeded = 0;
+
+    // Lookups whose source left before they finished
+    size_t lookupsAborted = 0;
+
+    // Requests sent again after their deadline passed without a reply
+    uint64_t rpcRetransmits = 0;
+
+    ReplicationStats beforeChurn;
+    ReplicationStats afterChurn;
+
+    uint64_t simulatedMs = 0;
+    double wallSeconds = 0.0;
+};
+
+/**
+ * @brief Simulator class running Kademlia nodes on a discrete-event network
+ *
+ * Every node is a real Kademlia instance whose transport hands datagrams
+ * to the simulator. Datagrams, RPC deadlines, maintenance rounds, churn and
+ * lookups are events ordered by virtual time, and utils::getCurrentTimeMillis
+ * follows the virtual clock while the simulation runs. Time jumps straight
+ * to the next event, so a run takes as long as the work it contains, not
+ * the time it simulates. Everything runs on the calling thread, and a run
+ * with the same config and seed repeats exactly.
+ */
+class Simulator {
+public:
+    explicit Simulator(const SimulationConfig& config);
+    ~Simulator();
+
+    Simulator(const Simulator&) = delete;
+    Simulator& operator=(const Simulator&) = delete;
+
+    // Run the join, store and churn phases and report the results
+    SimulationReport run();
+
+private:
+    class SimTransport;
+
+    struct Event {
+        uint64_t time;
+        uint64_t sequence;
+        std::function<void()> action;
+    };
+
+    struct SimNode {
+        std::unique_ptr<Kademlia> node;
+        std::shared_ptr<SimTransport> transport;
+        uint32_t ip = 0;
+        bool alive = false;
+        // Position in liveNodes_ while alive
+        size_t livePosition = 0;
+        // Time of the earliest scheduled RPC deadline check, 0 if none
+        uint64_t tickAtMs = 0;
+    };
+
+    // Schedule an action at a virtual time
+    void schedule(uint64_t timeMs, std::function<void()> action);
+
+    // Run events until the virtual clock reaches the given time
+    void runUntil(uint64_t timeMs);
+
+    // Create a node, start it and bootstrap it through a random live node
+    void joinNode();
+
+    // Stop a random live node and discard its state
+    void leaveRandomNode();
+
+    // Start a node lookup for a random ID or a value lookup for a stored key from a random live node
+    void startLookup();
+
+    // Store every value from a random live node
+    void storeValues();
+
+    // Call maintain() on a node and schedule the next call
+    void maintainNode(size_t index);
+
+    // Schedule a node's RPC deadline check unless one is already due no later
+    void scheduleTick(size_t index, uint64_t timeMs);
+
+    // Run a node's RPC deadline check scheduled for the given time and schedule the next one
+    void tickNode(size_t index, uint64_t timeMs);
+
+    // Accept a datagram from a node's transport
+    bool send(size_t fromIndex, uint32_t ip, uint16_t port, const uint8_t* data, size_t length);
+
+    // Schedule the next event of a Poisson process with the given rate per millisecond until the end time
+    void schedulePoisson(double ratePerMs, uint64_t endMs, std::function<void()> action);
+
+    // Get a random live node, or SIZE_MAX if none is alive
+    size_t randomLiveNode();
+
+    // Find the live node closest to an ID, other than the excluded one
+    size_t closestLiveNode(const NodeID& id, size_t excluded) const;
+
+    // Measure how well the stored values are replicated right now
+    ReplicationStats measureReplication() const;
+
+    SimulationConfig config_;
+    std::mt19937_64 rng_;
+    uint64_t nowMs_;
+    uint64_t nextSequence_;
+    std::vector<Event> events_;
+    std::vector<SimNode> nodes_;
+    std::vector<size_t> liveNodes_;
+    std::unordered_map<uint32_t, size_t> nodesByIP_;
+    std::vector<DHTKey> keys_;
+    SimulationReport report_;
+};
+
+} // namespace sim
+} // namespace kademlia
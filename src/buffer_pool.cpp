@@ -0,0 +1,152 @@
+#include "../include/buffer_pool.h"
+#include <atomic>
+#include <mutex>
+#include <utility>
+
+namespace kademlia {
+
+struct PooledBuffer::Block {
+    std::atomic<size_t> references{1};
+    BufferPool::Shared* shared = nullptr;
+    std::unique_ptr<uint8_t[]> bytes;
+};
+
+// State shared by the pool and its outstanding buffers, freed by whichever goes last
+struct BufferPool::Shared {
+    std::mutex mutex;
+    size_t bufferSize = 0;
+    size_t maxCached = 0;
+    std::vector<PooledBuffer::Block*> free;
+    size_t outstanding = 0;
+    bool closed = false;
+};
+
+// PooledBuffer implementation
+PooledBuffer::PooledBuffer() : block_(nullptr) {}
+
+PooledBuffer::PooledBuffer(Block* block) : block_(block) {}
+
+PooledBuffer::PooledBuffer(const PooledBuffer& other) : block_(other.block_) {
+    if (block_ != nullptr) {
+        block_->references.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other) noexcept : block_(other.block_) {
+    other.block_ = nullptr;
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer other) noexcept {
+    std::swap(block_, other.block_);
+    return *this;
+}
+
+PooledBuffer::~PooledBuffer() {
+    reset();
+}
+
+uint8_t* PooledBuffer::data() const {
+    return block_ != nullptr ? block_->bytes.get() : nullptr;
+}
+
+size_t PooledBuffer::capacity() const {
+    return block_ != nullptr ? block_->shared->bufferSize : 0;
+}
+
+size_t PooledBuffer::useCount() const {
+    return block_ != nullptr ? block_->references.load(std::memory_order_acquire) : 0;
+}
+
+void PooledBuffer::reset() {
+    if (block_ == nullptr) {
+        return;
+    }
+
+    // The thread dropping the last reference must see every write made through the others
+    if (block_->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        BufferPool::recycle(block_);
+    }
+    block_ = nullptr;
+}
+
+// BufferPool implementation
+BufferPool::BufferPool(size_t bufferSize, size_t maxCached) : shared_(new Shared()) {
+    shared_->bufferSize = bufferSize;
+    shared_->maxCached = maxCached;
+}
+
+BufferPool::~BufferPool() {
+    bool last;
+
+    {
+        std::lock_guard<std::mutex> lock(shared_->mutex);
+        for (PooledBuffer::Block* block : shared_->free) {
+            delete block;
+        }
+        shared_->free.clear();
+        shared_->closed = true;
+        last = shared_->outstanding == 0;
+    }
+
+    if (last) {
+        delete shared_;
+    }
+}
+
+PooledBuffer BufferPool::acquire() {
+    PooledBuffer::Block* block = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(shared_->mutex);
+        shared_->outstanding++;
+        if (!shared_->free.empty()) {
+            block = shared_->free.back();
+            shared_->free.pop_back();
+        }
+    }
+
+    if (block == nullptr) {
+        block = new PooledBuffer::Block();
+        block->shared = shared_;
+        block->bytes.reset(new uint8_t[shared_->bufferSize]);
+    } else {
+        block->references.store(1, std::memory_order_relaxed);
+    }
+
+    return PooledBuffer(block);
+}
+
+size_t BufferPool::getBufferSize() const {
+    return shared_->bufferSize;
+}
+
+size_t BufferPool::getCachedCount() const {
+    std::lock_guard<std::mutex> lock(shared_->mutex);
+    return shared_->free.size();
+}
+
+void BufferPool::recycle(PooledBuffer::Block* block) {
+    Shared* shared = block->shared;
+    bool deleteShared = false;
+
+    {
+        std::lock_guard<std::mutex> lock(shared->mutex);
+        shared->outstanding--;
+
+        if (!shared->closed && shared->free.size() < shared->maxCached) {
+            shared->free.push_back(block);
+            block = nullptr;
+        }
+
+        // The pool is gone and this was its last buffer
+        deleteShared = shared->closed && shared->outstanding == 0;
+    }
+
+    delete block;
+
+    if (deleteShared) {
+        delete shared;
+    }
+}
+
+} // namespace kademlia
@@ -0,0 +1,527 @@
+#include "../include/bulk_transfer.h"
+#include "../include/utils.h"
+#include <algorithm>
+#include <cstring>
+
+namespace kademlia {
+
+namespace {
+
+// New fragments received between acknowledgements
+constexpr size_t ACK_EVERY = 8;
+
+// Fragments acknowledged after a missing one before it is taken as lost
+constexpr uint64_t REORDER_THRESHOLD = 3;
+
+// Time an overtaken fragment must have been in flight before it counts as lost, so that
+// fragments reordered between threads sending for the same message are not resent
+constexpr uint64_t REORDER_WINDOW_MS = 2;
+
+// Longest selective ack bitmap, covering the 1024 fragments after the contiguous ones
+constexpr size_t MAX_ACK_BITMAP_BYTES = 128;
+
+size_t fragmentCountFor(size_t length, size_t fragmentSize) {
+    return (length + fragmentSize - 1) / fragmentSize;
+}
+
+} // namespace
+
+BulkTransfer::BulkTransfer(size_t fragmentSize, size_t window, SendFunction send, ReceiveHandler deliver)
+    : fragmentSize_(std::min<size_t>(std::max<size_t>(fragmentSize, 1), UINT16_MAX)),
+      window_(std::max<size_t>(window, 1)), send_(std::move(send)), deliver_(std::move(deliver)),
+      nextMessageID_(static_cast<uint32_t>(utils::randomEngine()())), nextSequence_(0),
+      reassemblyBytes_(0), active_(0), messagesSent_(0), messagesReceived_(0), fragmentsSent_(0),
+      fragmentsRetransmitted_(0), acksSent_(0), messagesFailed_(0) {}
+
+uint64_t BulkTransfer::makeAddress(uint32_t ip, uint16_t port) {
+    return (static_cast<uint64_t>(ip) << 16) | port;
+}
+
+void BulkTransfer::releaseReassembly(const IncomingKey& key, size_t bytes) {
+    reassemblyBytes_ -= bytes;
+    auto it = sourceBytes_.find(static_cast<uint32_t>(key.first >> 16));
+    if (it != sourceBytes_.end()) {
+        it->second -= bytes;
+        if (it->second == 0) {
+            sourceBytes_.erase(it);
+        }
+    }
+}
+
+void BulkTransfer::updateActive() {
+    active_ = outgoing_.size() + incoming_.size() + completed_.size();
+}
+
+bool BulkTransfer::send(uint32_t ip, uint16_t port, std::vector<uint8_t> message) {
+    if (message.empty() || message.size() > MAX_BULK_MESSAGE_SIZE) {
+        return false;
+    }
+
+    auto transfer = std::make_shared<Outgoing>();
+    transfer->ip = ip;
+    transfer->port = port;
+    transfer->fragmentCount = fragmentCountFor(message.size(), fragmentSize_);
+    transfer->data = std::move(message);
+    transfer->sentSequence.assign(transfer->fragmentCount, 0);
+    transfer->sentMs.assign(transfer->fragmentCount, 0);
+    transfer->acked.assign(transfer->fragmentCount, false);
+    transfer->ackedCount = 0;
+    transfer->newestAcked = 0;
+    transfer->firstUnacked = 0;
+    transfer->outstanding = 0;
+    transfer->nextNew = 0;
+    transfer->lastProgressMs = utils::getMonotonicTimeMillis();
+    transfer->retransmitRounds = 0;
+    transfer->probeSequence = 0;
+
+    std::vector<PendingFragment> pending;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        uint32_t messageID = nextMessageID_++;
+        outgoing_[messageID] = transfer;
+        updateActive();
+
+        fillWindow(messageID, transfer, transfer->lastProgressMs, pending);
+    }
+
+    messagesSent_++;
+    sendFragments(pending);
+    return true;
+}
+
+bool BulkTransfer::handleDatagram(const Datagram& datagram) {
+    switch (wire::frameKind(datagram.data, datagram.length)) {
+        case wire::FRAME_FRAGMENT:
+            handleFragment(datagram);
+            return true;
+
+        case wire::FRAME_FRAGMENT_ACK:
+            handleAck(datagram);
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+bool BulkTransfer::isExpected(const Datagram& datagram) const {
+    switch (wire::frameKind(datagram.data, datagram.length)) {
+        case wire::FRAME_FRAGMENT: {
+            wire::FragmentHeader header;
+            ByteSpan chunk;
+            if (!wire::decodeFragment(datagram.data, datagram.length, header, chunk)) {
+                return false;
+            }
+            IncomingKey key(makeAddress(datagram.fromIP, datagram.fromPort), header.messageID);
+            std::lock_guard<std::mutex> lock(mutex_);
+            return incoming_.find(key) != incoming_.end() || completed_.find(key) != completed_.end();
+        }
+
+        case wire::FRAME_FRAGMENT_ACK: {
+            uint32_t messageID = 0;
+            uint32_t contiguous = 0;
+            ByteSpan bitmap;
+            if (!wire::decodeFragmentAck(datagram.data, datagram.length, messageID, contiguous, bitmap)) {
+                return false;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = outgoing_.find(messageID);
+            return it != outgoing_.end() && it->second->ip == datagram.fromIP &&
+                   it->second->port == datagram.fromPort;
+        }
+
+        default:
+            return false;
+    }
+}
+
+void BulkTransfer::handleFragment(const Datagram& datagram) {
+    wire::FragmentHeader header;
+    ByteSpan chunk;
+    if (!wire::decodeFragment(datagram.data, datagram.length, header, chunk) ||
+        header.totalLength > MAX_BULK_MESSAGE_SIZE) {
+        return;
+    }
+
+    IncomingKey key(makeAddress(datagram.fromIP, datagram.fromPort), header.messageID);
+    size_t fragmentCount = fragmentCountFor(header.totalLength, header.fragmentSize);
+
+    PendingAck ack;
+    bool sendAckNow = false;
+    std::vector<uint8_t> message;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t now = utils::getMonotonicTimeMillis();
+
+        // A fragment of a finished message means the final acknowledgement was lost
+        if (completed_.find(key) != completed_.end()) {
+            ack.ip = datagram.fromIP;
+            ack.port = datagram.fromPort;
+            ack.messageID = header.messageID;
+            ack.contiguous = static_cast<uint32_t>(fragmentCount);
+            sendAckNow = true;
+        } else {
+            auto it = incoming_.find(key);
+
+            if (it == incoming_.end()) {
+                // Bound the memory held by messages that may never finish, in total and per sender
+                size_t& sourceBytes = sourceBytes_[datagram.fromIP];
+                if (reassemblyBytes_ + header.totalLength > MAX_REASSEMBLY_BYTES ||
+                    sourceBytes + header.totalLength > MAX_REASSEMBLY_BYTES_PER_SOURCE) {
+                    if (sourceBytes == 0) {
+                        sourceBytes_.erase(datagram.fromIP);
+                    }
+                    return;
+                }
+
+                Incoming fresh;
+                fresh.data.resize(header.totalLength);
+                fresh.received.assign(fragmentCount, false);
+                fresh.receivedCount = 0;
+                fresh.contiguous = 0;
+                fresh.highest = 0;
+                fresh.fragmentSize = header.fragmentSize;
+                fresh.sinceAck = 0;
+                fresh.lastActivityMs = now;
+
+                it = incoming_.emplace(key, std::move(fresh)).first;
+                reassemblyBytes_ += header.totalLength;
+                sourceBytes += header.totalLength;
+                updateActive();
+            } else if (it->second.data.size() != header.totalLength ||
+                       it->second.fragmentSize != header.fragmentSize) {
+                return;
+            }
+
+            Incoming& incoming = it->second;
+            incoming.lastActivityMs = now;
+
+            if (incoming.received[header.index]) {
+                // A duplicate means the sender has not heard our acknowledgements
+                ack = makeAck(datagram.fromIP, datagram.fromPort, header.messageID, incoming);
+                incoming.sinceAck = 0;
+                sendAckNow = true;
+            } else {
+                std::memcpy(incoming.data.data() + static_cast<size_t>(header.index) * header.fragmentSize,
+                            chunk.data, chunk.size);
+                incoming.received[header.index] = true;
+                incoming.receivedCount++;
+                incoming.sinceAck++;
+
+                // A fragment below the highest one received fills a hole the sender is waiting on
+                bool filledHole = header.index < incoming.highest;
+                incoming.highest = std::max<size_t>(incoming.highest, header.index + 1);
+
+                while (incoming.contiguous < fragmentCount && incoming.received[incoming.contiguous]) {
+                    incoming.contiguous++;
+                }
+
+                if (incoming.receivedCount == fragmentCount) {
+                    message = std::move(incoming.data);
+                    releaseReassembly(key, header.totalLength);
+                    incoming_.erase(it);
+                    completed_[key] = now;
+                    updateActive();
+
+                    ack.ip = datagram.fromIP;
+                    ack.port = datagram.fromPort;
+                    ack.messageID = header.messageID;
+                    ack.contiguous = static_cast<uint32_t>(fragmentCount);
+                    sendAckNow = true;
+                } else if (filledHole || incoming.sinceAck >= ACK_EVERY) {
+                    ack = makeAck(datagram.fromIP, datagram.fromPort, header.messageID, incoming);
+                    incoming.sinceAck = 0;
+                    sendAckNow = true;
+                }
+            }
+        }
+    }
+
+    if (sendAckNow) {
+        sendAck(ack);
+    }
+
+    if (!message.empty()) {
+        messagesReceived_++;
+
+        // The reassembled message arrives like any other datagram from the sender
+        Datagram whole;
+        whole.data = message.data();
+        whole.length = message.size();
+        whole.fromIP = datagram.fromIP;
+        whole.fromPort = datagram.fromPort;
+        if (deliver_) {
+            deliver_(whole);
+        }
+    }
+}
+
+void BulkTransfer::handleAck(const Datagram& datagram) {
+    uint32_t messageID = 0;
+    uint32_t contiguous = 0;
+    ByteSpan bitmap;
+    if (!wire::decodeFragmentAck(datagram.data, datagram.length, messageID, contiguous, bitmap)) {
+        return;
+    }
+
+    std::vector<PendingFragment> pending;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = outgoing_.find(messageID);
+        if (it == outgoing_.end() || it->second->ip != datagram.fromIP || it->second->port != datagram.fromPort) {
+            return;
+        }
+
+        std::shared_ptr<Outgoing> transfer = it->second;
+        Outgoing& out = *transfer;
+        size_t before = out.ackedCount;
+
+        auto markAcked = [&out](size_t index) {
+            if (out.acked[index] || out.sentSequence[index] == 0) {
+                return;
+            }
+            out.acked[index] = true;
+            out.ackedCount++;
+            out.outstanding--;
+            out.newestAcked = std::max(out.newestAcked, out.sentSequence[index]);
+        };
+
+        size_t covered = std::min<size_t>(contiguous, out.fragmentCount);
+        for (size_t i = out.firstUnacked; i < covered; ++i) {
+            markAcked(i);
+        }
+
+        for (size_t bit = 0; bit < bitmap.size * 8; ++bit) {
+            size_t index = static_cast<size_t>(contiguous) + bit;
+            if (index >= out.fragmentCount) {
+                break;
+            }
+            if (bitmap.data[bit / 8] & (1u << (bit % 8))) {
+                markAcked(index);
+            }
+        }
+
+        while (out.firstUnacked < out.fragmentCount && out.acked[out.firstUnacked]) {
+            out.firstUnacked++;
+        }
+
+        if (out.ackedCount == out.fragmentCount) {
+            outgoing_.erase(it);
+            updateActive();
+            return;
+        }
+
+        uint64_t now = utils::getMonotonicTimeMillis();
+        if (out.ackedCount > before) {
+            out.lastProgressMs = now;
+            out.retransmitRounds = 0;
+        }
+
+        resendLost(messageID, transfer, now, pending);
+        fillWindow(messageID, transfer, now, pending);
+    }
+
+    sendFragments(pending);
+}
+
+void BulkTransfer::tick() {
+    if (active_ == 0) {
+        return;
+    }
+
+    std::vector<PendingFragment> pending;
+    std::vector<PendingAck> acks;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t now = utils::getMonotonicTimeMillis();
+
+        for (auto it = outgoing_.begin(); it != outgoing_.end();) {
+            Outgoing& out = *it->second;
+
+            if (now - out.lastProgressMs < BULK_RETRANSMIT_MS) {
+                // Holes overtaken too recently when their acknowledgement came in may be due by now
+                resendLost(it->first, it->second, now, pending);
+                ++it;
+                continue;
+            }
+
+            if (++out.retransmitRounds > BULK_MAX_RETRANSMITS) {
+                messagesFailed_++;
+                it = outgoing_.erase(it);
+                continue;
+            }
+
+            // Nothing was acknowledged for a while; resend the first missing fragment, whose
+            // acknowledgement shows what else was lost, or the final acknowledgement if that was
+            if (out.firstUnacked < out.nextNew) {
+                out.sentSequence[out.firstUnacked] = ++nextSequence_;
+                out.sentMs[out.firstUnacked] = now;
+                out.probeSequence = nextSequence_;
+                pending.push_back(PendingFragment{it->second, it->first, static_cast<uint32_t>(out.firstUnacked)});
+                fragmentsRetransmitted_++;
+            }
+
+            out.lastProgressMs = now;
+            ++it;
+        }
+
+        for (auto it = incoming_.begin(); it != incoming_.end();) {
+            Incoming& incoming = it->second;
+
+            if (now - incoming.lastActivityMs >= BULK_REASSEMBLY_TIMEOUT_MS) {
+                releaseReassembly(it->first, incoming.data.size());
+                it = incoming_.erase(it);
+                continue;
+            }
+
+            // Acknowledge the tail of a burst that did not reach ACK_EVERY
+            if (incoming.sinceAck > 0) {
+                uint32_t ip = static_cast<uint32_t>(it->first.first >> 16);
+                uint16_t port = static_cast<uint16_t>(it->first.first);
+                acks.push_back(makeAck(ip, port, it->first.second, incoming));
+                incoming.sinceAck = 0;
+            }
+            ++it;
+        }
+
+        for (auto it = completed_.begin(); it != completed_.end();) {
+            if (now - it->second >= BULK_REASSEMBLY_TIMEOUT_MS) {
+                it = completed_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        updateActive();
+    }
+
+    sendFragments(pending);
+    for (const auto& ack : acks) {
+        sendAck(ack);
+    }
+}
+
+void BulkTransfer::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    outgoing_.clear();
+    incoming_.clear();
+    completed_.clear();
+    reassemblyBytes_ = 0;
+    sourceBytes_.clear();
+    updateActive();
+}
+
+size_t BulkTransfer::activeCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return outgoing_.size() + incoming_.size();
+}
+
+size_t BulkTransfer::getFragmentSize() const {
+    return fragmentSize_;
+}
+
+BulkTransferStats BulkTransfer::getStats() const {
+    BulkTransferStats stats;
+    stats.messagesSent = messagesSent_;
+    stats.messagesReceived = messagesReceived_;
+    stats.fragmentsSent = fragmentsSent_;
+    stats.fragmentsRetransmitted = fragmentsRetransmitted_;
+    stats.acksSent = acksSent_;
+    stats.messagesFailed = messagesFailed_;
+    return stats;
+}
+
+void BulkTransfer::fillWindow(uint32_t messageID, const std::shared_ptr<Outgoing>& transfer, uint64_t now,
+                              std::vector<PendingFragment>& pending) {
+    Outgoing& out = *transfer;
+
+    while (out.outstanding < window_ && out.nextNew < out.fragmentCount) {
+        out.sentSequence[out.nextNew] = ++nextSequence_;
+        out.sentMs[out.nextNew] = now;
+        out.outstanding++;
+        pending.push_back(PendingFragment{transfer, messageID, static_cast<uint32_t>(out.nextNew)});
+        out.nextNew++;
+    }
+}
+
+void BulkTransfer::resendLost(uint32_t messageID, const std::shared_ptr<Outgoing>& transfer, uint64_t now,
+                              std::vector<PendingFragment>& pending) {
+    Outgoing& out = *transfer;
+
+    // Fragments sent well before the newest acknowledged one, or before an acknowledged probe, are missing
+    uint64_t lostBefore = out.newestAcked >= REORDER_THRESHOLD ? out.newestAcked - REORDER_THRESHOLD + 1 : 0;
+    if (out.probeSequence != 0 && out.newestAcked >= out.probeSequence) {
+        lostBefore = std::max(lostBefore, out.probeSequence);
+        out.probeSequence = 0;
+    }
+
+    for (size_t i = out.firstUnacked; i < out.nextNew; ++i) {
+        if (!out.acked[i] && out.sentSequence[i] < lostBefore && now - out.sentMs[i] >= REORDER_WINDOW_MS) {
+            out.sentSequence[i] = ++nextSequence_;
+            out.sentMs[i] = now;
+            pending.push_back(PendingFragment{transfer, messageID, static_cast<uint32_t>(i)});
+            fragmentsRetransmitted_++;
+        }
+    }
+}
+
+BulkTransfer::PendingAck BulkTransfer::makeAck(uint32_t ip, uint16_t port, uint32_t messageID,
+                                               const Incoming& incoming) {
+    PendingAck ack;
+    ack.ip = ip;
+    ack.port = port;
+    ack.messageID = messageID;
+    ack.contiguous = static_cast<uint32_t>(incoming.contiguous);
+
+    // Describe the fragments between the contiguous ones and the highest received
+    size_t span = std::min(incoming.highest - incoming.contiguous, MAX_ACK_BITMAP_BYTES * 8);
+    ack.bitmap.assign((span + 7) / 8, 0);
+    for (size_t bit = 0; bit < span; ++bit) {
+        if (incoming.received[incoming.contiguous + bit]) {
+            ack.bitmap[bit / 8] |= static_cast<uint8_t>(1u << (bit % 8));
+        }
+    }
+
+    return ack;
+}
+
+void BulkTransfer::sendFragments(const std::vector<PendingFragment>& pending) {
+    // The transfers' bytes never change after send(), so they are read without the lock
+    thread_local std::vector<uint8_t> buffer;
+    buffer.resize(wire::FRAGMENT_HEADER_SIZE + fragmentSize_);
+
+    for (const auto& fragment : pending) {
+        const Outgoing& out = *fragment.transfer;
+        size_t offset = static_cast<size_t>(fragment.index) * fragmentSize_;
+        size_t length = std::min(fragmentSize_, out.data.size() - offset);
+
+        wire::FragmentHeader header;
+        header.messageID = fragment.messageID;
+        header.totalLength = static_cast<uint32_t>(out.data.size());
+        header.index = fragment.index;
+        header.fragmentSize = static_cast<uint16_t>(fragmentSize_);
+
+        size_t encoded = wire::encodeFragment(header, out.data.data() + offset, length, buffer.data(), buffer.size());
+        if (encoded > 0 && send_(out.ip, out.port, buffer.data(), encoded)) {
+            fragmentsSent_++;
+        }
+    }
+}
+
+void BulkTransfer::sendAck(const PendingAck& ack) {
+    thread_local std::vector<uint8_t> buffer(wire::FRAGMENT_ACK_HEADER_SIZE + MAX_ACK_BITMAP_BYTES);
+
+    size_t encoded = wire::encodeFragmentAck(ack.messageID, ack.contiguous, ack.bitmap.data(), ack.bitmap.size(),
+                                             buffer.data(), buffer.size());
+    if (encoded > 0 && send_(ack.ip, ack.port, buffer.data(), encoded)) {
+        acksSent_++;
+    }
+}
+
+} // namespace kademlia
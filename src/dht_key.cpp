@@ -1,55 +1,56 @@
 #include "../include/dht_key.h"
 #include "../include/utils.h"
-#include <sstream>
-#include <iomanip>
 
 namespace kademlia {
 
-DHTKey::DHTKey() {}
+DHTKey::DHTKey() : hash_(utils::hashKey(data_)) {}
 
-DHTKey::DHTKey(const std::vector<uint8_t>& data) : data_(data) {}
+DHTKey::DHTKey(const std::vector<uint8_t>& data) : data_(data), hash_(utils::hashKey(data_)) {}
 
-DHTKey::DHTKey(const std::string& str) {
-    // Convert string to bytes
-    for (char c : str) {
-        data_.push_back(static_cast<uint8_t>(c));
-    }
-}
+DHTKey::DHTKey(const std::string& str) : data_(str.begin(), str.end()), hash_(utils::hashKey(data_)) {}
 
 const std::vector<uint8_t>& DHTKey::getData() const {
     return data_;
 }
 
+const KeyHash& DHTKey::getHash() const {
+    return hash_;
+}
+
 std::string DHTKey::toString() const {
-    std::stringstream ss;
-    
+    return toString(data_.data(), data_.size());
+}
+
+std::string DHTKey::toString(const uint8_t* data, size_t length) {
     // If the data contains only printable ASCII characters, return as string
     bool allPrintable = true;
-    for (auto byte : data_) {
-        if (byte < 32 || byte > 126) {
+    for (size_t i = 0; i < length; ++i) {
+        if (data[i] < 32 || data[i] > 126) {
             allPrintable = false;
             break;
         }
     }
     
-    if (allPrintable && !data_.empty()) {
-        for (auto byte : data_) {
-            ss << static_cast<char>(byte);
-        }
-    } else {
-        // Otherwise, return as hex
-        ss << "0x";
-        ss << std::hex << std::setfill('0');
-        for (auto byte : data_) {
-            ss << std::setw(2) << static_cast<int>(byte);
-        }
+    if (allPrintable && length > 0) {
+        return std::string(reinterpret_cast<const char*>(data), length);
+    }
+    
+    // Otherwise, return as hex
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    std::string result;
+    result.reserve(2 + length * 2);
+    result += "0x";
+    for (size_t i = 0; i < length; ++i) {
+        result += HEX_DIGITS[data[i] >> 4];
+        result += HEX_DIGITS[data[i] & 0x0F];
     }
     
-    return ss.str();
+    return result;
 }
 
 bool DHTKey::operator==(const DHTKey& other) const {
-    return data_ == other.data_;
+    // Unequal hashes settle most comparisons without touching the bytes
+    return hash_ == other.hash_ && data_ == other.data_;
 }
 
 bool DHTKey::operator!=(const DHTKey& other) const {
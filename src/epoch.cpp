@@ -0,0 +1,108 @@
+#include "../include/epoch.h"
+#include <functional>
+#include <thread>
+
+namespace kademlia {
+
+// Guard implementation
+EpochManager::Guard::Guard(std::atomic<uint64_t>* slot) : slot_(slot) {}
+
+EpochManager::Guard::Guard(Guard&& other) noexcept : slot_(other.slot_) {
+    other.slot_ = nullptr;
+}
+
+EpochManager::Guard::~Guard() {
+    if (slot_) {
+        slot_->store(IDLE, std::memory_order_release);
+    }
+}
+
+// EpochManager implementation
+EpochManager::EpochManager() : epoch_(0) {}
+
+EpochManager::~EpochManager() {
+    // No reader can be active once the owner is being destroyed
+    for (const auto& retired : retired_) {
+        retired.deleter(retired.object);
+    }
+}
+
+EpochManager::Guard EpochManager::enter() {
+    // Start probing at a slot derived from the thread so concurrent readers rarely collide
+    size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % MAX_READERS;
+    
+    for (;;) {
+        uint64_t epoch = epoch_.load(std::memory_order_seq_cst);
+        
+        for (size_t probe = 0; probe < MAX_READERS; ++probe) {
+            std::atomic<uint64_t>& slot = slots_[(index + probe) % MAX_READERS].epoch;
+            
+            uint64_t expected = IDLE;
+            if (slot.load(std::memory_order_relaxed) != IDLE ||
+                !slot.compare_exchange_strong(expected, epoch, std::memory_order_seq_cst)) {
+                continue;
+            }
+            
+            // Re-announce until the announced epoch is current, so writers see it before the
+            // reader loads any shared pointer
+            for (;;) {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                uint64_t current = epoch_.load(std::memory_order_seq_cst);
+                if (current == epoch) {
+                    return Guard(&slot);
+                }
+                epoch = current;
+                slot.store(epoch, std::memory_order_seq_cst);
+            }
+        }
+        
+        // Every slot is busy; readers are short, so wait for one to leave
+        std::this_thread::yield();
+    }
+}
+
+void EpochManager::retire(void* object, void (*deleter)(void*)) {
+    std::lock_guard<std::mutex> lock(retireMutex_);
+    
+    retired_.push_back(Retired{object, deleter, epoch_.load(std::memory_order_seq_cst)});
+    
+    tryAdvance();
+    collect();
+}
+
+size_t EpochManager::pendingCount() const {
+    std::lock_guard<std::mutex> lock(retireMutex_);
+    return retired_.size();
+}
+
+void EpochManager::tryAdvance() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t epoch = epoch_.load(std::memory_order_seq_cst);
+    
+    // A reader still in an older epoch may hold references from before the last advance
+    for (const auto& slot : slots_) {
+        uint64_t observed = slot.epoch.load(std::memory_order_seq_cst);
+        if (observed != IDLE && observed != epoch) {
+            return;
+        }
+    }
+    
+    epoch_.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst);
+}
+
+void EpochManager::collect() {
+    uint64_t epoch = epoch_.load(std::memory_order_seq_cst);
+    
+    // Objects retired two or more epochs ago are unreachable by every active reader
+    size_t kept = 0;
+    for (size_t i = 0; i < retired_.size(); ++i) {
+        if (retired_[i].epoch + 2 <= epoch) {
+            retired_[i].deleter(retired_[i].object);
+        } else {
+            retired_[kept++] = retired_[i];
+        }
+    }
+    retired_.resize(kept);
+}
+
+} // namespace kademlia
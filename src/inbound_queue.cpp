@@ -0,0 +1,183 @@
+#include "../include/inbound_queue.h"
+#include <algorithm>
+
+namespace kademlia {
+
+InboundQueue::InboundQueue(size_t capacity, ShedPolicy policy, MessageHandler handler)
+    : capacity_(std::max<size_t>(capacity, 1)), policy_(policy), handler_(std::move(handler)),
+      count_(0), bytes_(0), nextSequence_(0), running_(false), queued_(0) {
+    for (auto& counter : shed_) {
+        counter = 0;
+    }
+}
+
+InboundQueue::~InboundQueue() {
+    stop();
+}
+
+bool InboundQueue::start(size_t threads) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_ || threads == 0) {
+        return false;
+    }
+
+    running_ = true;
+    for (size_t i = 0; i < threads; ++i) {
+        threads_.emplace_back([this]() {
+            run();
+        });
+    }
+
+    return true;
+}
+
+void InboundQueue::stop() {
+    std::vector<std::thread> threads;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        threads.swap(threads_);
+    }
+    ready_.notify_all();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Release the queued buffers outside the handler threads
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& queue : queues_) {
+        queue.clear();
+    }
+    count_ = 0;
+    bytes_ = 0;
+}
+
+bool InboundQueue::push(const Datagram& datagram, const MessageView& message, InboundPriority priority) {
+    size_t level = static_cast<size_t>(priority);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return false;
+        }
+
+        // Small messages are copied; keeping their receive buffer would pin all of it for a few bytes
+        bool retain = datagram.buffer && *datagram.buffer && datagram.length > INBOUND_COPY_THRESHOLD;
+        size_t footprint = retain ? datagram.buffer->capacity() : datagram.length;
+
+        // Make room for the new message, or drop it if everything queued is more urgent
+        while (count_ >= capacity_ || (count_ > 0 && bytes_ + footprint > MAX_INBOUND_QUEUE_BYTES)) {
+            if (!shedFor(priority)) {
+                shed_[level].fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+
+        // Hold on to the pooled buffer of a large message instead of copying the bytes out of it
+        Entry entry;
+        entry.message = message;
+        entry.message.buffer = nullptr;
+        if (retain) {
+            entry.buffer = *datagram.buffer;
+        } else if (message.payload.size > 0) {
+            // Point the payload at the copy; moving the entry leaves the vector's storage in place
+            entry.bytes.assign(message.payload.data, message.payload.data + message.payload.size);
+            entry.message.payload.data = entry.bytes.data();
+        }
+        entry.footprint = footprint;
+        entry.sequence = nextSequence_++;
+
+        queues_[level].push_back(std::move(entry));
+        count_++;
+        bytes_ += footprint;
+    }
+
+    queued_.fetch_add(1, std::memory_order_relaxed);
+    ready_.notify_one();
+    return true;
+}
+
+size_t InboundQueue::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return count_;
+}
+
+InboundStats InboundQueue::getStats() const {
+    InboundStats stats;
+    stats.queued = queued_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < INBOUND_PRIORITY_COUNT; ++i) {
+        stats.shed[i] = shed_[i].load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+bool InboundQueue::shedFor(InboundPriority priority) {
+    if (policy_ == ShedPolicy::DROP_OLDEST) {
+        // The oldest message is at the front of one of the queues
+        size_t oldest = INBOUND_PRIORITY_COUNT;
+        for (size_t i = 0; i < INBOUND_PRIORITY_COUNT; ++i) {
+            if (!queues_[i].empty() &&
+                (oldest == INBOUND_PRIORITY_COUNT || queues_[i].front().sequence < queues_[oldest].front().sequence)) {
+                oldest = i;
+            }
+        }
+
+        if (oldest == INBOUND_PRIORITY_COUNT) {
+            return false;
+        }
+        dropFront(oldest);
+        return true;
+    }
+
+    // Drop from the least urgent queue, as long as it is no more urgent than the new message
+    for (size_t i = INBOUND_PRIORITY_COUNT; i-- > static_cast<size_t>(priority);) {
+        if (!queues_[i].empty()) {
+            dropFront(i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void InboundQueue::dropFront(size_t priority) {
+    bytes_ -= queues_[priority].front().footprint;
+    count_--;
+    queues_[priority].pop_front();
+    shed_[priority].fetch_add(1, std::memory_order_relaxed);
+}
+
+void InboundQueue::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true) {
+        ready_.wait(lock, [this]() {
+            return !running_ || count_ > 0;
+        });
+        if (!running_) {
+            return;
+        }
+
+        // Take the oldest message of the most urgent priority
+        auto queue = std::find_if(queues_.begin(), queues_.end(), [](const std::deque<Entry>& q) {
+            return !q.empty();
+        });
+        Entry entry = std::move(queue->front());
+        queue->pop_front();
+        count_--;
+        bytes_ -= entry.footprint;
+
+        lock.unlock();
+
+        entry.message.buffer = entry.buffer ? &entry.buffer : nullptr;
+        handler_(entry.message);
+
+        // Drop the buffer reference before waiting again
+        entry = Entry();
+        lock.lock();
+    }
+}
+
+} // namespace kademlia
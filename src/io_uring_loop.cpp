@@ -0,0 +1,486 @@
+#include "../include/io_uring_loop.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <arpa/inet.h>
+#include <linux/time_types.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace kademlia {
+
+namespace {
+
+// Submission queue size; larger send batches are submitted in several steps
+constexpr unsigned RING_ENTRIES = 256;
+
+// Provided buffer group used for receives
+constexpr uint16_t BUFFER_GROUP = 0;
+
+// Longest time teardown waits for the kernel to release buffers
+constexpr auto DRAIN_TIMEOUT = std::chrono::seconds(1);
+
+bool probeSupport() {
+    int sockfd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (sockfd < 0) {
+        return false;
+    }
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t addressLength = sizeof(address);
+
+    bool supported = false;
+
+    if (bind(sockfd, (struct sockaddr*)&address, sizeof(address)) == 0 &&
+        getsockname(sockfd, (struct sockaddr*)&address, &addressLength) == 0) {
+        // Receive one datagram sent to ourselves through a multishot receive
+        IOUringLoop loop;
+        if (loop.init(sockfd, -1, 2, 64, nullptr)) {
+            const char probe[] = "probe";
+            sendto(sockfd, probe, sizeof(probe), 0, (struct sockaddr*)&address, sizeof(address));
+
+            size_t received = 0;
+            for (int attempt = 0; attempt < 10 && received == 0; ++attempt) {
+                received = loop.poll(100, [](const Datagram&) {});
+            }
+            supported = received == 1;
+        }
+    }
+
+    close(sockfd);
+    return supported;
+}
+
+} // namespace
+
+IOUringLoop::IOUringLoop()
+    : ringFd_(-1), sockfd_(-1), wakeFd_(-1), counters_(nullptr),
+      sqRing_(MAP_FAILED), sqRingSize_(0), sqHead_(nullptr), sqTail_(nullptr), sqMask_(0), sqEntries_(0),
+      sqArray_(nullptr), sqes_(nullptr), sqesSize_(0), pendingSubmit_(0),
+      cqRing_(MAP_FAILED), cqRingSize_(0), cqHead_(nullptr), cqTail_(nullptr), cqMask_(0), cqes_(nullptr),
+      bufferRing_(nullptr), bufferRingSize_(0), bufferCount_(0), bufferSize_(0), bufferTail_(0),
+      buffersRegistered_(false), receiveArmed_(false), wakeArmed_(false), sendsInFlight_(0) {
+    memset(&receiveHeader_, 0, sizeof(receiveHeader_));
+}
+
+IOUringLoop::~IOUringLoop() {
+    drain();
+    release();
+}
+
+bool IOUringLoop::isSupported() {
+    static const bool supported = probeSupport();
+    return supported;
+}
+
+bool IOUringLoop::init(int sockfd, int wakeFd, size_t bufferCount, size_t bufferSize, TransportCounters* counters) {
+    if (ringFd_ >= 0) {
+        return false;
+    }
+
+    sockfd_ = sockfd;
+    wakeFd_ = wakeFd;
+    counters_ = counters;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    ringFd_ = static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+    if (ringFd_ < 0) {
+        return false;
+    }
+
+    // Timed waits need EXT_ARG; one mapping for both queues keeps setup simple
+    if (!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        release();
+        return false;
+    }
+
+    // Map the queues
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    sqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+        release();
+        return false;
+    }
+    cqRing_ = sqRing_;
+
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        release();
+        return false;
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    uint8_t* sq = static_cast<uint8_t*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqEntries_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+    uint8_t* cq = static_cast<uint8_t*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // The provided buffer ring must have a power-of-two size
+    bufferCount_ = 1;
+    while (bufferCount_ < bufferCount && bufferCount_ < 32768) {
+        bufferCount_ <<= 1;
+    }
+
+    // Each buffer holds the recvmsg header, the source address and the payload
+    bufferSize_ = sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_in) + bufferSize;
+    bufferPool_.reset(new BufferPool(bufferSize_, bufferCount_));
+    buffers_.resize(bufferCount_);
+
+    bufferRingSize_ = bufferCount_ * sizeof(struct io_uring_buf);
+    void* bufferRing = mmap(nullptr, bufferRingSize_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bufferRing == MAP_FAILED) {
+        release();
+        return false;
+    }
+    bufferRing_ = static_cast<struct io_uring_buf_ring*>(bufferRing);
+
+    // The kernel reads the tail from the first entry, so start from a zeroed ring
+    memset(bufferRing_, 0, bufferRingSize_);
+
+    struct io_uring_buf_reg registration;
+    memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = reinterpret_cast<uint64_t>(bufferRing_);
+    registration.ring_entries = bufferCount_;
+    registration.bgid = BUFFER_GROUP;
+
+    if (syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+        release();
+        return false;
+    }
+    buffersRegistered_ = true;
+
+    for (unsigned i = 0; i < bufferCount_; ++i) {
+        recycleBuffer(static_cast<uint16_t>(i));
+    }
+    publishBuffers();
+
+    // Only IPv4 source addresses are expected
+    receiveHeader_.msg_namelen = sizeof(struct sockaddr_in);
+    receiveHeader_.msg_controllen = 0;
+
+    return true;
+}
+
+size_t IOUringLoop::poll(int timeoutMs, const ReceiveHandler& onReceive) {
+    arm();
+
+    bool ready = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE) != *cqHead_;
+
+    if (!ready) {
+        // Submit queued sends and re-armed operations together with the wait
+        struct __kernel_timespec timeout;
+        timeout.tv_sec = timeoutMs / 1000;
+        timeout.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000000;
+
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = reinterpret_cast<uint64_t>(&timeout);
+
+        enter(pendingSubmit_, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    } else if (pendingSubmit_ > 0) {
+        enter(pendingSubmit_, 0, 0, nullptr, 0);
+    }
+
+    return reap(onReceive);
+}
+
+void IOUringLoop::submitSends(SendBuffers&& buffers) {
+    size_t count = buffers.size();
+    if (count == 0) {
+        return;
+    }
+
+    uint32_t slot;
+    if (!freeSendSlots_.empty()) {
+        slot = freeSendSlots_.back();
+        freeSendSlots_.pop_back();
+    } else {
+        slot = static_cast<uint32_t>(sends_.size());
+        sends_.emplace_back();
+    }
+
+    // Moving the vectors keeps their storage, so the prepared headers stay valid
+    sends_[slot].buffers = std::move(buffers);
+    sends_[slot].remaining = count;
+    sendsInFlight_++;
+
+    for (size_t i = 0; i < count; ++i) {
+        struct io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = sockfd_;
+        sqe->addr = reinterpret_cast<uint64_t>(&sends_[slot].buffers.headers[i].msg_hdr);
+        sqe->len = 1;
+        sqe->user_data = makeUserData(Operation::SEND, slot);
+    }
+}
+
+SendBuffers IOUringLoop::takeSpareBuffers() {
+    if (spareBuffers_.empty()) {
+        return SendBuffers();
+    }
+
+    SendBuffers buffers = std::move(spareBuffers_.back());
+    spareBuffers_.pop_back();
+    return buffers;
+}
+
+struct io_uring_sqe* IOUringLoop::nextSqe() {
+    unsigned tail = *sqTail_;
+
+    // Make room by handing the queued entries to the kernel
+    if (tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) {
+        enter(pendingSubmit_, 0, 0, nullptr, 0);
+    }
+
+    unsigned index = tail & sqMask_;
+    struct io_uring_sqe* sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqArray_[index] = index;
+
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+    pendingSubmit_++;
+    return sqe;
+}
+
+int IOUringLoop::enter(unsigned toSubmit, unsigned minComplete, unsigned flags, const void* arg, size_t argSize) {
+    int result = static_cast<int>(syscall(__NR_io_uring_enter, ringFd_, toSubmit, minComplete, flags, arg, argSize));
+
+    if (counters_) {
+        counters_->syscalls.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // A timed-out or interrupted wait still submitted nothing; anything else was consumed
+    if (result > 0) {
+        pendingSubmit_ -= std::min<unsigned>(pendingSubmit_, static_cast<unsigned>(result));
+    }
+
+    return result;
+}
+
+void IOUringLoop::arm() {
+    if (!receiveArmed_) {
+        struct io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->fd = sockfd_;
+        sqe->addr = reinterpret_cast<uint64_t>(&receiveHeader_);
+        sqe->len = 1;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->buf_group = BUFFER_GROUP;
+        sqe->user_data = makeUserData(Operation::RECEIVE, 0);
+        receiveArmed_ = true;
+    }
+
+    if (!wakeArmed_ && wakeFd_ >= 0) {
+        struct io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = wakeFd_;
+        sqe->poll32_events = POLLIN;
+        sqe->user_data = makeUserData(Operation::WAKE, 0);
+        wakeArmed_ = true;
+    }
+}
+
+void IOUringLoop::recycleBuffer(uint16_t bufferID) {
+    // Index the ring as a plain array: in C++ the header's flexible bufs member sits 8 bytes too far
+    // because its empty placeholder struct is not zero-sized. Leave resv alone; in the first entry
+    // it overlays the ring tail.
+    struct io_uring_buf* entry = reinterpret_cast<struct io_uring_buf*>(bufferRing_) + (bufferTail_ & (bufferCount_ - 1));
+
+    // A handler kept the old buffer, so the kernel gets a fresh one under the same ID
+    PooledBuffer& buffer = buffers_[bufferID];
+    if (!buffer || buffer.useCount() > 1) {
+        buffer = bufferPool_->acquire();
+    }
+
+    entry->addr = reinterpret_cast<uint64_t>(buffer.data());
+    entry->len = static_cast<uint32_t>(bufferSize_);
+    entry->bid = bufferID;
+    bufferTail_++;
+}
+
+void IOUringLoop::publishBuffers() {
+    __atomic_store_n(&bufferRing_->tail, bufferTail_, __ATOMIC_RELEASE);
+}
+
+size_t IOUringLoop::reap(const ReceiveHandler& onReceive) {
+    size_t received = 0;
+    uint64_t sent = 0;
+
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; ++head) {
+        const struct io_uring_cqe* cqe = &cqes_[head & cqMask_];
+        Operation operation = static_cast<Operation>(cqe->user_data >> 56);
+        uint32_t index = static_cast<uint32_t>(cqe->user_data);
+
+        switch (operation) {
+            case Operation::RECEIVE: {
+                // The multishot receive ends on errors such as running out of buffers; it is re-armed on the next poll
+                if (!(cqe->flags & IORING_CQE_F_MORE)) {
+                    receiveArmed_ = false;
+                }
+
+                if (cqe->res < 0 || !(cqe->flags & IORING_CQE_F_BUFFER)) {
+                    break;
+                }
+
+                uint16_t bufferID = static_cast<uint16_t>(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+                const uint8_t* buffer = buffers_[bufferID].data();
+
+                struct io_uring_recvmsg_out out;
+                memcpy(&out, buffer, sizeof(out));
+
+                const uint8_t* name = buffer + sizeof(out);
+                const uint8_t* payload = name + receiveHeader_.msg_namelen + receiveHeader_.msg_controllen;
+
+                if (out.namelen >= sizeof(struct sockaddr_in) && !(out.flags & MSG_TRUNC)) {
+                    struct sockaddr_in from;
+                    memcpy(&from, name, sizeof(from));
+
+                    datagram_.fromIP = from.sin_addr.s_addr;
+                    datagram_.fromPort = ntohs(from.sin_port);
+                    datagram_.data = payload;
+                    datagram_.length = out.payloadlen;
+                    datagram_.buffer = &buffers_[bufferID];
+
+                    received++;
+                    if (onReceive) {
+                        onReceive(datagram_);
+                    }
+                }
+
+                recycleBuffer(bufferID);
+                break;
+            }
+
+            case Operation::WAKE: {
+                wakeArmed_ = false;
+                break;
+            }
+
+            case Operation::SEND: {
+                if (cqe->res > 0) {
+                    sent++;
+                }
+
+                // Recycle the batch once its last send has completed
+                InFlightSends& sends = sends_[index];
+                if (--sends.remaining == 0) {
+                    sends.buffers.clear();
+                    spareBuffers_.push_back(std::move(sends.buffers));
+                    freeSendSlots_.push_back(index);
+                    sendsInFlight_--;
+                }
+                break;
+            }
+
+            case Operation::CANCEL: {
+                break;
+            }
+        }
+    }
+
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    publishBuffers();
+
+    if (counters_) {
+        counters_->datagramsReceived.fetch_add(received, std::memory_order_relaxed);
+        counters_->datagramsSent.fetch_add(sent, std::memory_order_relaxed);
+    }
+
+    return received;
+}
+
+void IOUringLoop::drain() {
+    if (ringFd_ < 0 || sqes_ == nullptr || !buffersRegistered_) {
+        return;
+    }
+
+    // Cancel the long-lived operations so the kernel stops filling buffers
+    for (Operation operation : {Operation::RECEIVE, Operation::WAKE}) {
+        if ((operation == Operation::RECEIVE && receiveArmed_) || (operation == Operation::WAKE && wakeArmed_)) {
+            struct io_uring_sqe* sqe = nextSqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = makeUserData(operation, 0);
+            sqe->user_data = makeUserData(Operation::CANCEL, 0);
+        }
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + DRAIN_TIMEOUT;
+
+    while ((receiveArmed_ || wakeArmed_ || sendsInFlight_ > 0 || pendingSubmit_ > 0) &&
+           std::chrono::steady_clock::now() < deadline) {
+        struct __kernel_timespec timeout;
+        timeout.tv_sec = 0;
+        timeout.tv_nsec = 100 * 1000000;
+
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = reinterpret_cast<uint64_t>(&timeout);
+
+        enter(pendingSubmit_, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+        reap(ReceiveHandler());
+    }
+}
+
+void IOUringLoop::release() {
+    if (buffersRegistered_) {
+        struct io_uring_buf_reg registration;
+        memset(&registration, 0, sizeof(registration));
+        registration.bgid = BUFFER_GROUP;
+        syscall(__NR_io_uring_register, ringFd_, IORING_UNREGISTER_PBUF_RING, &registration, 1);
+        buffersRegistered_ = false;
+    }
+
+    if (bufferRing_ != nullptr) {
+        munmap(bufferRing_, bufferRingSize_);
+        bufferRing_ = nullptr;
+    }
+
+    if (sqes_ != nullptr) {
+        munmap(sqes_, sqesSize_);
+        sqes_ = nullptr;
+    }
+
+    if (sqRing_ != MAP_FAILED) {
+        munmap(sqRing_, sqRingSize_);
+        sqRing_ = MAP_FAILED;
+        cqRing_ = MAP_FAILED;
+    }
+
+    if (ringFd_ >= 0) {
+        close(ringFd_);
+        ringFd_ = -1;
+    }
+}
+
+uint64_t IOUringLoop::makeUserData(Operation operation, uint32_t index) {
+    return (static_cast<uint64_t>(operation) << 56) | index;
+}
+
+} // namespace kademlia
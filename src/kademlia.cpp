@@ -4,22 +4,21 @@
 #include <thread>
 #include <chrono>
 #include <cstring>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <unistd.h>
-#include <fcntl.h>
-#include <poll.h>
 #include <algorithm>
 #include <random>
+#include <future>
+#include <map>
 
 namespace kademlia {
 
-Kademlia::Kademlia(uint16_t port, const std::string& bootstrapIP, uint16_t bootstrapPort)
-    : running_(false) {
+Kademlia::Kademlia(uint16_t port, const std::string& bootstrapIP, uint16_t bootstrapPort,
+                   const KademliaConfig& config, std::shared_ptr<Transport> transport)
+    : config_(config), bootstrapIP_(bootstrapIP), bootstrapPort_(bootstrapPort),
+      bootstrapped_(false), transport_(std::move(transport)), running_(false), nextRefreshMs_(0), nextRepublishMs_(0),
+      nextRepublishSendMs_(0), republishPacingMs_(0), republishRoundMs_(0) {
     
-    // Create a random node ID for the local node
-    NodeID localID = NodeID::random();
+    // Use the configured node ID, or create a random one
+    NodeID localID = config_.nodeID != NodeID() ? config_.nodeID : NodeID::random();
     
     // Get the local IP address (simplified)
     std::string localIP = "127.0.0.1"; // In a real implementation, we would get the actual local IP
@@ -28,10 +27,41 @@ Kademlia::Kademlia(uint16_t port, const std::string& bootstrapIP, uint16_t boots
     localNode_ = std::make_shared<Node>(localID, localIP, port);
     
     // Create the routing table
-    routingTable_ = std::make_shared<RoutingTable>(localID);
+    routingTable_ = std::make_shared<RoutingTable>(localID, config_.relaxedSplitBits);
     
     // Create the hole puncher
     holePuncher_ = std::make_shared<HolePuncher>();
+    
+    // Without a given transport, own UDP sockets set up from the config
+    if (!transport_) {
+        transport_ = std::make_shared<UDPTransport>(config_.ioThreads, config_.ioBackend, config_.ioBatchSize);
+    }
+    
+    // Create the client that matches responses to outstanding requests
+    rpcClient_ = std::make_shared<RPCClient>(config_.rpcTimeout, config_.rpcMinTimeout, config_.rpcMaxTimeout,
+                                             config_.rpcRetries);
+    
+    // Messages too large for one datagram are fragmented; reassembled ones come back through handleDatagram
+    size_t fragmentSize = config_.maxDatagramSize > wire::FRAGMENT_HEADER_SIZE
+                          ? config_.maxDatagramSize - wire::FRAGMENT_HEADER_SIZE : 1;
+    bulkTransfer_ = std::make_shared<BulkTransfer>(fragmentSize, config_.fragmentWindow,
+        [this](uint32_t ip, uint16_t port, const uint8_t* data, size_t length) {
+            return transport_->send(ip, port, data, length);
+        },
+        [this](const Datagram& datagram) {
+            handleMessage(datagram, false);
+        });
+    
+    // Bound what any one sender, and all senders together, can make the node do
+    if (config_.inboundRateLimit > 0) {
+        rateLimiter_ = std::make_unique<RateLimiter>(config_.inboundRateLimit, config_.inboundBurst);
+    }
+    if (config_.handlerThreads > 0) {
+        inboundQueue_ = std::make_unique<InboundQueue>(config_.inboundQueueCapacity, config_.shedPolicy,
+            [this](const MessageView& message) {
+                handleRPC(message);
+            });
+    }
 }
 
 Kademlia::~Kademlia() {
@@ -43,31 +73,79 @@ bool Kademlia::start() {
         return false;
     }
     
+    // Load the values kept by an earlier run before anyone can ask for them
+    if (!config_.storageDirectory.empty() && !storage_.isPersistent()) {
+        ValueLogOptions options;
+        options.syncInterval = config_.storageSyncInterval;
+        if (!storage_.open(config_.storageDirectory, options, utils::getCurrentTimeMillis())) {
+            return false;
+        }
+    }
+    
     running_ = true;
     
-    // Start the message processing thread
-    messageThread_ = std::thread(&Kademlia::processMessages, this);
+    // Handler threads must be ready before the event loops queue anything
+    if (inboundQueue_) {
+        inboundQueue_->start(config_.handlerThreads);
+    }
+    
+    // Bind the node's port before any traffic is sent. The delivery threads also fail
+    // requests whose deadline has passed.
+    if (!transport_->start(localNode_->getPort(),
+            [this](const Datagram& datagram) {
+                handleDatagram(datagram);
+            },
+            [this]() {
+                rpcClient_->expire();
+                bulkTransfer_->tick();
+            })) {
+        if (inboundQueue_) {
+            inboundQueue_->stop();
+        }
+        running_ = false;
+        return false;
+    }
     
     // Start the maintenance thread
-    maintenanceThread_ = std::thread([this]() {
-        while (running_) {
-            // Refresh buckets
-            refreshBuckets();
-            
-            // Republish keys
-            republishKeys();
+    if (config_.maintenanceInterval.count() > 0) {
+        maintenanceThread_ = std::thread([this]() {
+            std::unique_lock<std::mutex> lock(maintenanceMutex_);
             
-            // Expire old keys
-            expireKeys();
-            
-            // Sleep for a while
-            std::this_thread::sleep_for(std::chrono::minutes(10));
-        }
-    });
+            while (running_) {
+                lock.unlock();
+                maintain();
+                
+                // Sleep until the next round, key expiry or paced republish, or until the node stops
+                std::chrono::milliseconds wait = config_.maintenanceInterval;
+                uint64_t nextExpiry = storage_.getNextExpiry();
+                uint64_t now = utils::getCurrentTimeMillis();
+                if (nextExpiry != UINT64_MAX) {
+                    auto untilExpiry = std::chrono::milliseconds(nextExpiry > now ? nextExpiry - now : 0);
+                    wait = std::min(wait, std::max(untilExpiry, MIN_MAINTENANCE_WAIT));
+                }
+                {
+                    std::lock_guard<std::mutex> republishLock(republishMutex_);
+                    uint64_t monotonicNow = utils::getMonotonicTimeMillis();
+                    uint64_t nextRepublish = nextRepublishMs_;
+                    if (!republishQueue_.empty()) {
+                        nextRepublish = std::min(nextRepublish, nextRepublishSendMs_);
+                    }
+                    auto untilRepublish = std::chrono::milliseconds(
+                        nextRepublish > monotonicNow ? nextRepublish - monotonicNow : 0);
+                    wait = std::min(wait, std::max(untilRepublish, MIN_MAINTENANCE_WAIT));
+                }
+                
+                lock.lock();
+                maintenanceWake_.wait_for(lock, wait, [this]() {
+                    return !running_;
+                });
+            }
+        });
+    }
     
     // Bootstrap the node if bootstrap IP and port are provided
-    if (!localNode_->getIP().empty() && localNode_->getPort() != 0) {
-        bootstrap(localNode_->getIP(), localNode_->getPort());
+    if (!bootstrapIP_.empty() && bootstrapPort_ != 0) {
+        bootstrap(bootstrapIP_, bootstrapPort_);
     }
     
     return true;
@@ -78,24 +156,54 @@ void Kademlia::stop() {
         return;
     }
     
-    running_ = false;
-    
-    // Wait for threads to finish
-    if (messageThread_.joinable()) {
-        messageThread_.join();
+    {
+        std::lock_guard<std::mutex> lock(maintenanceMutex_);
+        running_ = false;
     }
+    maintenanceWake_.notify_all();
     
+    // Wait for the maintenance thread, then stop delivery once nothing else sends
     if (maintenanceThread_.joinable()) {
         maintenanceThread_.join();
     }
+    
+    // Wait for a hole punch in progress to send its reply; queued ones are dropped. No handler starts
+    // the thread again once it sees running_ cleared under the lock.
+    std::thread holePunchThread;
+    {
+        std::lock_guard<std::mutex> lock(holePunchMutex_);
+        holePunchQueue_.clear();
+        holePunchThread = std::move(holePunchThread_);
+    }
+    holePunchWake_.notify_all();
+    if (holePunchThread.joinable()) {
+        holePunchThread.join();
+    }
+    
+    // Join the handler threads while the sockets they reply on are still open; messages
+    // received from here on are refused by the stopped queue
+    if (inboundQueue_) {
+        inboundQueue_->stop();
+    }
+    
+    transport_->stop();
+    
+    // Fail any requests that can no longer be answered
+    rpcClient_->cancelAll();
+    bulkTransfer_->clear();
+    
+    // Nothing stores any more; make the last values durable without waiting for the group commit
+    storage_.sync();
 }
 
 void Kademlia::store(const DHTKey& key, const std::vector<uint8_t>& value, DHTCallback callback) {
-    // Hash the key to get a NodeID
-    NodeID targetID = utils::hashKey(key.getData());
-    
+    store(key.getHash(), value, std::move(callback));
+}
+
+void Kademlia::store(const KeyHash& key, const std::vector<uint8_t>& value, DHTCallback callback) {
     // Find the k closest nodes to the key
-    nodeLookup(targetID, [this, key, value, callback](bool success, const std::vector<NodePtr>& nodes) {
+    findNode(key, [this, key, value, callback](bool success, const std::vector<NodePtr>& nodes,
+                                                 const LookupStats&) {
         if (!success || nodes.empty()) {
             if (callback) {
                 callback(false, std::vector<uint8_t>());
@@ -104,31 +212,20 @@ void Kademlia::store(const DHTKey& key, const std::vector<uint8_t>& value, DHTCa
         }
         
         // Store the key-value pair locally
-        {
-            std::lock_guard<std::mutex> lock(storageMutex_);
-            storage_[key.toString()] = value;
-            storageTimestamps_[key.toString()] = utils::getCurrentTimeMillis();
-        }
+        storeLocal(key, value, static_cast<uint64_t>(config_.valueTTL.count()), localNode_->getID(), false);
         
         // Store the key-value pair on the k closest nodes
         bool allSuccess = true;
         
         for (const auto& node : nodes) {
             // Create a STORE RPC message
-            RPCMessage message;
-            message.type = RPCType::STORE;
-            message.sender = localNode_->getID();
-            message.receiver = node->getID();
-            message.senderIP = localNode_->getIP();
-            message.senderPort = localNode_->getPort();
+            RPCMessage message = createMessage(RPCType::STORE, node->getID());
             
-            // Add the key and value to the payload
-            const auto& keyData = key.getData();
-            message.payload.insert(message.payload.end(), keyData.begin(), keyData.end());
-            message.payload.insert(message.payload.end(), value.begin(), value.end());
+            // Add the key hash and value to the payload
+            wire::encodeStorePayload(key, value, 0, 0, message.payload);
             
             // Send the message
-            if (!sendRPC(message)) {
+            if (!sendRPC(message, node->getIP(), node->getPort())) {
                 allSuccess = false;
             }
         }
@@ -138,39 +235,93 @@ void Kademlia::store(const DHTKey& key, const std::vector<uint8_t>& value, DHTCa
         }
     });
 }
+
 void Kademlia::findValue(const DHTKey& key, DHTCallback callback) {
+    findValue(key.getHash(), std::move(callback));
+}
+
+void Kademlia::findValue(const KeyHash& key, DHTCallback callback) {
     // Check if we have the value locally
-    {
-        std::string keyStr = key.toString();
-        std::lock_guard<std::mutex> lock(storageMutex_);
-        auto it = storage_.find(keyStr);
-        if (it != storage_.end()) {
-            if (callback) {
-                callback(true, it->second);
-            }
-            return;
+    std::vector<uint8_t> value;
+    if (storage_.get(key, value, utils::getCurrentTimeMillis())) {
+        if (callback) {
+            callback(true, value);
         }
+        return;
+    }
+    
+    // If not, perform a value lookup, unless one for the same key is already running
+    if (!valueLookups_.join(key, std::move(callback))) {
+        return;
     }
     
-    // If not, perform a value lookup
-    valueLookup(key, callback);
+    valueLookup(key, [this, key](bool success, const std::vector<uint8_t>& value) {
+        valueLookups_.complete(key, success, value);
+    });
 }
 
 void Kademlia::findNode(const NodeID& id, NodeLookupCallback callback) {
-    nodeLookup(id, callback);
+    // Callers asking for a target while a lookup for it runs get that lookup's result
+    if (!nodeLookups_.join(id, std::move(callback))) {
+        return;
+    }
+    
+    nodeLookup(id, [this, id](bool success, const std::vector<NodePtr>& nodes, const LookupStats& stats) {
+        nodeLookups_.complete(id, success, nodes, stats);
+    });
 }
 
 bool Kademlia::ping(const NodePtr& node) {
-    // Create a PING RPC message
-    RPCMessage message;
-    message.type = RPCType::PING;
-    message.sender = localNode_->getID();
-    message.receiver = node->getID();
-    message.senderIP = localNode_->getIP();
-    message.senderPort = localNode_->getPort();
+    // Without a running receive loop the reply could never be matched
+    if (!running_) {
+        return false;
+    }
+    
+    // Wait for the reply or the request deadline
+    auto result = std::make_shared<std::promise<bool>>();
+    std::future<bool> reply = result->get_future();
     
-    // Send the message
-    return sendRPC(message);
+    sendRequest(node, createMessage(RPCType::PING, node->getID()),
+        [result](bool success, const MessageView&) {
+            result->set_value(success);
+        });
+    
+    return reply.get();
+}
+
+void Kademlia::maintain() {
+    uint64_t now = utils::getMonotonicTimeMillis();
+
+    // Retry an unanswered bootstrap; a lost ping would otherwise cut the node off from the network for good
+    if (!bootstrapIP_.empty() && bootstrapPort_ != 0 && !bootstrapped_) {
+        bootstrap(bootstrapIP_, bootstrapPort_);
+    }
+
+    // Expire old keys first, so none of them is republished
+    expireKeys();
+    
+    // Refresh buckets
+    if (now >= nextRefreshMs_) {
+        nextRefreshMs_ = now + static_cast<uint64_t>(config_.refreshInterval.count());
+        refreshBuckets();
+    }
+    
+    // Collect the keys coming due for republishing once per slice of the interval
+    if (now >= nextRepublishMs_) {
+        nextRepublishMs_ = now + static_cast<uint64_t>(config_.republishInterval.count()) / REPUBLISH_SLICES;
+        republishKeys();
+    }
+    
+    // Send the republish groups that are due
+    sendPacedRepublish(now);
+}
+
+bool Kademlia::hasValue(const DHTKey& key) const {
+    return hasValue(key.getHash());
+}
+
+bool Kademlia::hasValue(const KeyHash& key) const {
+    return storage_.contains(key, utils::getCurrentTimeMillis());
 }
 
 NodePtr Kademlia::getLocalNode() const {
@@ -185,139 +336,106 @@ std::shared_ptr<HolePuncher> Kademlia::getHolePuncher() const {
     return holePuncher_;
 }
 
-void Kademlia::handleRPC(const RPCMessage& message) {
+std::shared_ptr<BulkTransfer> Kademlia::getBulkTransfer() const {
+    return bulkTransfer_;
+}
+
+std::shared_ptr<RPCClient> Kademlia::getRPCClient() const {
+    return rpcClient_;
+}
+
+InboundStats Kademlia::getInboundStats() const {
+    InboundStats stats = inboundQueue_ ? inboundQueue_->getStats() : InboundStats();
+    stats.rateLimited = rateLimiter_ ? rateLimiter_->getRejectedCount() : 0;
+    return stats;
+}
+
+void Kademlia::handleRPC(const MessageView& message) {
     // Update the sender in the routing table
-    NodePtr sender = std::make_shared<Node>(message.sender, message.senderIP, message.senderPort);
-    routingTable_->addNode(sender);
+    Contact sender;
+    sender.id = message.sender;
+    sender.ip = message.senderIP;
+    sender.port = message.senderPort;
+    sender.lastSeen = utils::getCurrentTimeMillis();
+    routingTable_->addContact(sender);
+    
+    // Responses complete the matching outstanding request and are never answered
+    if (message.isResponse) {
+        rpcClient_->handleResponse(message);
+        return;
+    }
+    
+    // Responses are built in a per-thread message so their payload buffer is reused
+    thread_local RPCMessage response;
     
     // Handle the message based on its type
     switch (message.type) {
         case RPCType::PING: {
             // Respond with a PING message
-            RPCMessage response;
-            response.type = RPCType::PING;
-            response.sender = localNode_->getID();
-            response.receiver = message.sender;
-            response.senderIP = localNode_->getIP();
-            response.senderPort = localNode_->getPort();
+            prepareResponse(response, RPCType::PING, message);
             
-            sendRPC(response);
+            sendRPC(response, message.senderIP, message.senderPort);
             break;
         }
         
         case RPCType::STORE: {
-            // Extract the key and value from the payload
-            // In a real implementation, we would need to know the key and value sizes
-            // For simplicity, we'll assume the key is the first half and the value is the second half
-            size_t halfSize = message.payload.size() / 2;
-            std::vector<uint8_t> keyData(message.payload.begin(), message.payload.begin() + halfSize);
-            std::vector<uint8_t> value(message.payload.begin() + halfSize, message.payload.end());
-            
-            // Create a DHTKey from the key data
-            DHTKey key(keyData);
-            
-            // Store the key-value pair
-            std::lock_guard<std::mutex> lock(storageMutex_);
-            storage_[key.toString()] = value;
-            storageTimestamps_[key.toString()] = utils::getCurrentTimeMillis();
+            // The payload holds one record per key, several when a replica republishes in batches
+            ByteSpan records = message.payload;
+            KeyHash key;
+            ByteSpan value;
+            uint32_t ttlSeconds = 0;
+            uint8_t flags = 0;
+            while (records.size > 0 && wire::decodeStoreRecord(records, key, value, ttlSeconds, flags)) {
+                // Store the key-value pair for the requested lifetime, or the default one
+                uint64_t ttlMs = ttlSeconds > 0 ? static_cast<uint64_t>(ttlSeconds) * 1000
+                                                : static_cast<uint64_t>(config_.valueTTL.count());
+                storeLocal(key, value, ttlMs, message.sender, (flags & wire::STORE_FLAG_CACHED) != 0);
+            }
             break;
         }
         
         case RPCType::FIND_NODE: {
             // Extract the target ID from the payload
-            NodeID targetID(std::string(message.payload.begin(), message.payload.end()));
-            
-            // Find the k closest nodes to the target ID
-            std::vector<NodePtr> closestNodes = routingTable_->findClosestNodes(targetID);
-            
-            // Create a response message
-            RPCMessage response;
-            response.type = RPCType::FIND_NODE;
-            response.sender = localNode_->getID();
-            response.receiver = message.sender;
-            response.senderIP = localNode_->getIP();
-            response.senderPort = localNode_->getPort();
-            
-            // Add the closest nodes to the payload
-            for (const auto& node : closestNodes) {
-                // Add the node ID, IP, and port to the payload
-                std::string nodeStr = node->getID().toString() + ":" + node->getIP() + ":" + std::to_string(node->getPort());
-                response.payload.insert(response.payload.end(), nodeStr.begin(), nodeStr.end());
-                response.payload.push_back('\n'); // Use a newline as a separator
+            NodeID targetID;
+            if (!wire::decodeNodeID(message.payload, targetID)) {
+                break;
             }
             
-            sendRPC(response);
+            sendClosestContacts(RPCType::FIND_NODE, message, targetID);
             break;
         }
         
         case RPCType::FIND_VALUE: {
-            // Extract the key from the payload
-            std::vector<uint8_t> keyData(message.payload.begin(), message.payload.end());
-            DHTKey key(keyData);
-            
-            // Check if we have the value
-            std::lock_guard<std::mutex> lock(storageMutex_);
-            auto it = storage_.find(key.toString());
+            // The payload is the key hash
+            KeyHash key;
+            if (!wire::decodeNodeID(message.payload, key)) {
+                break;
+            }
             
-            if (it != storage_.end()) {
-                // We have the value, create a response with the value
-                RPCMessage response;
-                response.type = RPCType::FIND_VALUE;
-                response.sender = localNode_->getID();
-                response.receiver = message.sender;
-                response.senderIP = localNode_->getIP();
-                response.senderPort = localNode_->getPort();
-                
-                // Add the value to the payload
-                response.payload = it->second;
-                
-                sendRPC(response);
-            } else {
-                // We don't have the value, respond with the k closest nodes
-                NodeID targetID = utils::hashKey(key.getData());
-                std::vector<NodePtr> closestNodes = routingTable_->findClosestNodes(targetID);
-                
-                // Create a response message
-                RPCMessage response;
-                response.type = RPCType::FIND_NODE; // Use FIND_NODE type to indicate we're returning nodes
-                response.sender = localNode_->getID();
-                response.receiver = message.sender;
-                response.senderIP = localNode_->getIP();
-                response.senderPort = localNode_->getPort();
-                
-                // Add the closest nodes to the payload
-                for (const auto& node : closestNodes) {
-                    // Add the node ID, IP, and port to the payload
-                    std::string nodeStr = node->getID().toString() + ":" + node->getIP() + ":" + std::to_string(node->getPort());
-                    response.payload.insert(response.payload.end(), nodeStr.begin(), nodeStr.end());
-                    response.payload.push_back('\n'); // Use a newline as a separator
-                }
-                
-                sendRPC(response);
+            // If we have the value, respond with it; the value is copied straight into the reused payload
+            prepareResponse(response, RPCType::FIND_VALUE, message);
+            if (storage_.get(key, response.payload, utils::getCurrentTimeMillis())) {
+                sendRPC(response, message.senderIP, message.senderPort);
+                break;
             }
+            
+            // We don't have the value, respond with the k closest nodes
+            sendClosestContacts(RPCType::FIND_NODE, message, key);
             break;
         }
         
         case RPCType::HOLE_PUNCH_REQUEST: {
-            // Extract the requester's information
-            std::string requesterIP = message.senderIP;
-            uint16_t requesterPort = message.senderPort;
-            
             // Create a node for the requester
-            NodePtr requester = std::make_shared<Node>(message.sender, requesterIP, requesterPort);
+            NodePtr requester = std::make_shared<Node>(message.sender, utils::binaryToIP(message.senderIP),
+                                                       message.senderPort);
             
-            // Handle the hole punch request
-            holePuncher_->handleHolePunchRequest(requester);
+            // Respond with a HOLE_PUNCH_RESPONSE once the punch is done
+            prepareResponse(response, RPCType::HOLE_PUNCH_RESPONSE, message);
+            std::vector<uint8_t> encoded(wire::HEADER_SIZE + response.payload.size());
+            encoded.resize(wire::encodeMessage(response, encoded.data(), encoded.size()));
             
-            // Respond with a HOLE_PUNCH_RESPONSE
-            RPCMessage response;
-            response.type = RPCType::HOLE_PUNCH_RESPONSE;
-            response.sender = localNode_->getID();
-            response.receiver = message.sender;
-            response.senderIP = localNode_->getIP();
-            response.senderPort = localNode_->getPort();
-            
-            sendRPC(response);
+            // Hole punching blocks for seconds, so run it off the event loop
+            queueHolePunch(requester, std::move(encoded));
             break;
         }
         
@@ -328,28 +446,63 @@ void Kademlia::handleRPC(const RPCMessage& message) {
     }
 }
 
-void Kademlia::bootstrap(const std::string& bootstrapIP, uint16_t bootstrapPort) {
-    // Create a node for the bootstrap node
-    NodeID bootstrapID = NodeID::random(); // In a real implementation, we would get the actual ID
-    NodePtr bootstrapNode = std::make_shared<Node>(bootstrapID, bootstrapIP, bootstrapPort);
+void Kademlia::queueHolePunch(const NodePtr& requester, std::vector<uint8_t> reply) {
+    std::lock_guard<std::mutex> lock(holePunchMutex_);
+    if (!running_ || holePunchQueue_.size() >= MAX_QUEUED_HOLE_PUNCHES) {
+        return;
+    }
     
-    // Add the bootstrap node to the routing table
-    routingTable_->addNode(bootstrapNode);
+    holePunchQueue_.emplace_back(requester, std::move(reply));
+    if (holePunchThread_.joinable()) {
+        holePunchWake_.notify_one();
+        return;
+    }
     
-    // Perform a node lookup for our own ID to populate the routing table
-    nodeLookup(localNode_->getID(), nullptr);
+    holePunchThread_ = std::thread([this]() {
+        std::unique_lock<std::mutex> lock(holePunchMutex_);
+        
+        while (running_) {
+            if (holePunchQueue_.empty()) {
+                holePunchWake_.wait(lock, [this]() {
+                    return !running_ || !holePunchQueue_.empty();
+                });
+                continue;
+            }
+            
+            auto request = std::move(holePunchQueue_.front());
+            holePunchQueue_.pop_front();
+            lock.unlock();
+            
+            holePuncher_->handleHolePunchRequest(request.first);
+            transport_->send(request.first->getIP(), request.first->getPort(), request.second.data(),
+                             request.second.size());
+            
+            lock.lock();
+        }
+    });
+}
+
+void Kademlia::bootstrap(const std::string& bootstrapIP, uint16_t bootstrapPort) {
+    // The bootstrap node's ID is not known yet, so address it by endpoint only
+    NodePtr bootstrapNode = std::make_shared<Node>(NodeID(), bootstrapIP, bootstrapPort);
+    
+    // Ping it; the reply adds it to the routing table under its real ID
+    sendRequest(bootstrapNode, createMessage(RPCType::PING, NodeID()),
+        [this](bool success, const MessageView&) {
+            if (!success) {
+                return;
+            }
+            bootstrapped_ = true;
+            
+            // Perform a node lookup for our own ID to populate the routing table
+            findNode(localNode_->getID(), nullptr);
+        });
 }
 
 void Kademlia::refreshBuckets() {
     // Refresh each bucket by performing a node lookup for a random ID in the bucket's range
-    for (size_t i = 0; i < KEY_BITS; ++i) {
-        // Generate a random ID that differs from the local ID at bit i
-        std::array<uint8_t, KEY_BYTES> id = localNode_->getID().getRaw();
-        size_t bytePos = i / 8;
-        size_t bitPos = 7 - (i % 8);
-        id[bytePos] ^= (1 << bitPos);
-        
-        NodeID targetID(id);
+    for (const auto& range : routingTable_->getBucketRanges()) {
+        NodeID targetID = NodeID::randomWithPrefix(range.prefix, range.depth);
         
         // Perform a node lookup for the target ID
         nodeLookup(targetID, nullptr);
@@ -357,268 +510,373 @@ void Kademlia::refreshBuckets() {
 }
 
 void Kademlia::republishKeys() {
-    std::lock_guard<std::mutex> lock(storageMutex_);
+    uint64_t now = utils::getCurrentTimeMillis();
+    uint64_t interval = static_cast<uint64_t>(config_.republishInterval.count());
+    uint64_t slice = interval / REPUBLISH_SLICES;
+    
+    // Collect the keys whose interval ends before the next collection. A key another replica stored here
+    // lately was just republished to the other closest nodes too, so it is not due yet. Copies cached on a
+    // lookup path are left to expire.
+    std::vector<KeyHash> due;
+    storage_.forEach([&due, now, interval, slice](const KeyHash& key, const StoredValue& record) {
+        if (!record.cached && now + slice >= record.storedMs + interval) {
+            due.push_back(key);
+        }
+    });
     
-    // Republish each key-value pair
-    for (const auto& entry : storage_) {
-        const auto& keyStr = entry.first;
-        const auto& value = entry.second;
-        
-        // Create a DHTKey from the key string
-        DHTKey key(keyStr);
-        
-        // Store the key-value pair again
-        store(key, value, nullptr);
+    // Keys with the same closest nodes in the routing table are close together in the ID space, so one
+    // lookup finds the nodes for all of them and each node gets them in one batch
+    std::map<std::vector<NodeID>, std::vector<KeyHash>> groups;
+    for (const KeyHash& key : due) {
+        std::vector<NodeID> closest;
+        for (const auto& node : routingTable_->findClosestNodes(key, config_.k)) {
+            closest.push_back(node->getID());
+        }
+        std::sort(closest.begin(), closest.end());
+        groups[std::move(closest)].push_back(key);
+    }
+    
+    // Spread the groups evenly over the slice. Groups left from the previous collection are dropped; their
+    // keys were collected again.
+    std::lock_guard<std::mutex> lock(republishMutex_);
+    republishRoundMs_ = now;
+    republishQueue_.clear();
+    for (auto& group : groups) {
+        republishQueue_.push_back(std::move(group.second));
     }
+    republishPacingMs_ = groups.empty() ? 0 : slice / groups.size();
+    nextRepublishSendMs_ = utils::getMonotonicTimeMillis();
 }
 
-void Kademlia::expireKeys() {
-    std::lock_guard<std::mutex> lock(storageMutex_);
-    
-    // Get the current time
-    uint64_t now = utils::getCurrentTimeMillis();
-    
-    // Expire keys that are older than 24 hours
-    const uint64_t EXPIRE_THRESHOLD = 24 * 60 * 60 * 1000; // 24 hours in milliseconds
+void Kademlia::sendPacedRepublish(uint64_t now) {
+    std::vector<std::vector<KeyHash>> ready;
+    uint64_t roundMs = 0;
     
-    std::vector<std::string> keysToRemove;
-    
-    for (const auto& entry : storageTimestamps_) {
-        const auto& key = entry.first;
-        const auto& timestamp = entry.second;
-        
-        if (now - timestamp > EXPIRE_THRESHOLD) {
-            keysToRemove.push_back(key);
+    {
+        std::lock_guard<std::mutex> lock(republishMutex_);
+        while (!republishQueue_.empty() && now >= nextRepublishSendMs_) {
+            ready.push_back(std::move(republishQueue_.front()));
+            republishQueue_.pop_front();
+            nextRepublishSendMs_ += republishPacingMs_;
         }
+        roundMs = republishRoundMs_;
     }
     
-    // Remove expired keys
-    for (const auto& key : keysToRemove) {
-        storage_.erase(key);
-        storageTimestamps_.erase(key);
+    // Lookups run outside the lock; their callbacks may run on this thread
+    for (auto& keys : ready) {
+        republishGroup(std::move(keys), roundMs);
     }
 }
 
-bool Kademlia::sendRPC(const RPCMessage& message) {
-    // In a real implementation, this would send the message over the network
-    // For simplicity, we'll use a placeholder implementation
+void Kademlia::republishGroup(std::vector<KeyHash> keys, uint64_t roundMs) {
+    KeyHash target = keys.front();
     
-    // Create a socket
-    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sockfd < 0) {
+    findNode(target, [this, keys = std::move(keys), roundMs](bool success, const std::vector<NodePtr>& nodes,
+                                                             const LookupStats&) {
+        if (!success || nodes.empty()) {
+            return;
+        }
+        
+        // Pack the records into batches of at most one datagram each; a value too big for one goes alone
+        // and is sent in fragments
+        size_t batchLimit = config_.maxDatagramSize > wire::HEADER_SIZE ? config_.maxDatagramSize - wire::HEADER_SIZE : 0;
+        uint64_t now = utils::getCurrentTimeMillis();
+        std::vector<std::vector<uint8_t>> batches(1);
+        std::vector<KeyHash> sent;
+        StoredValue record;
+        
+        for (const KeyHash& key : keys) {
+            // Expired since the round, or stored here by another replica that republished it already
+            if (!storage_.getRecord(key, record, now) || record.storedMs > roundMs) {
+                continue;
+            }
+            
+            // The copies keep the deadline the publisher set; a value about to expire is left to expire
+            uint32_t ttlSeconds = static_cast<uint32_t>(std::min<uint64_t>((record.expiresMs - now) / 1000,
+                                                                           UINT32_MAX));
+            if (ttlSeconds == 0) {
+                continue;
+            }
+            
+            size_t recordSize = wire::STORE_RECORD_HEADER_SIZE + record.value.size();
+            if (!batches.back().empty() && batches.back().size() + recordSize > batchLimit) {
+                batches.emplace_back();
+            }
+            wire::appendStoreRecord(key, record.value, ttlSeconds, 0, batches.back());
+            sent.push_back(key);
+        }
+        
+        if (batches.back().empty()) {
+            batches.pop_back();
+        }
+        
+        // Send every batch to every node
+        for (const auto& node : nodes) {
+            for (const auto& batch : batches) {
+                RPCMessage message = createMessage(RPCType::STORE, node->getID());
+                message.payload = batch;
+                sendRPC(message, node->getIP(), node->getPort());
+            }
+        }
+        
+        // The keys' next interval starts now, as it does on the nodes that received them
+        for (const KeyHash& key : sent) {
+            storage_.touch(key, now);
+        }
+    });
+}
+
+void Kademlia::expireKeys() {
+    // Each key expires at the deadline set when it was last stored; due keys are removed in small
+    // batches, so lookups and stores on the same shard wait for one batch at most
+    storage_.expire(utils::getCurrentTimeMillis());
+}
+
+void Kademlia::storeLocal(const KeyHash& key, ByteSpan value, uint64_t ttlMs, const NodeID& publisher,
+                          bool cached) {
+    storage_.put(key, value, ttlMs, publisher, utils::getCurrentTimeMillis(), cached);
+}
+
+bool Kademlia::sendRPC(const RPCMessage& message, const std::string& ip, uint16_t port) {
+    uint32_t binary = 0;
+    if (!utils::ipToBinary(ip, binary)) {
         return false;
     }
     
-    // Set socket to non-blocking
-    int flags = fcntl(sockfd, F_GETFL, 0);
-    fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
-    
-    // Set up the destination address
-    struct sockaddr_in destAddr;
-    memset(&destAddr, 0, sizeof(destAddr));
-    destAddr.sin_family = AF_INET;
+    return sendRPC(message, binary, port);
+}
+
+bool Kademlia::sendRPC(const RPCMessage& message, uint32_t ip, uint16_t port) {
+    // A message too large for one datagram gets its own buffer and is sent in acknowledged fragments
+    size_t total = wire::HEADER_SIZE + message.payload.size();
+    if (total > config_.maxDatagramSize) {
+        std::vector<uint8_t> encoded(total);
+        if (wire::encodeMessage(message, encoded.data(), encoded.size()) == 0) {
+            return false;
+        }
+        return bulkTransfer_->send(ip, port, std::move(encoded));
+    }
     
-    // Get the IP and port of the receiver
-    NodePtr receiver = routingTable_->getNode(message.receiver);
-    if (!receiver) {
-        close(sockfd);
+    // Encode the message straight into a reusable per-thread buffer
+    thread_local std::vector<uint8_t> buffer(wire::MAX_DATAGRAM_SIZE);
+    size_t length = wire::encodeMessage(message, buffer.data(), buffer.size());
+    if (length == 0) {
         return false;
     }
     
-    destAddr.sin_addr.s_addr = inet_addr(receiver->getIP().c_str());
-    destAddr.sin_port = htons(receiver->getPort());
-    
-    // Serialize the message
-    // In a real implementation, we would use a proper serialization format
-    std::string serializedMsg;
-    serializedMsg += std::to_string(static_cast<int>(message.type)) + ":";
-    serializedMsg += message.sender.toString() + ":";
-    serializedMsg += message.receiver.toString() + ":";
-    serializedMsg += message.senderIP + ":";
-    serializedMsg += std::to_string(message.senderPort) + ":";
-    
-    // Add the payload
-    for (const auto& byte : message.payload) {
-        serializedMsg += static_cast<char>(byte);
+    // Send the message from the node's bound socket
+    return transport_->send(ip, port, buffer.data(), length);
+}
+
+uint32_t Kademlia::sendRequest(const NodePtr& node, RPCMessage message, RPCResponseCallback callback) {
+    // Tag the request so the response can be matched to it
+    uint32_t transactionID = rpcClient_->nextTransactionID();
+    message.transactionID = transactionID;
+    
+    // A retry resends the same message, so a late reply to any attempt still matches
+    uint32_t ip = 0;
+    bool validIP = utils::ipToBinary(node->getIP(), ip);
+    uint16_t port = node->getPort();
+    auto send = [this, message = std::move(message), ip, port]() {
+        return sendRPC(message, ip, port);
+    };
+    rpcClient_->addPending(transactionID, node->getID(), std::move(callback), std::chrono::milliseconds(0), send);
+    
+    // A request that cannot be sent fails right away instead of waiting for its deadline
+    if (!validIP || !send()) {
+        rpcClient_->cancel(transactionID);
     }
     
-    // Send the message
-    ssize_t bytesSent = sendto(sockfd, serializedMsg.c_str(), serializedMsg.length(), 0,
-                              (struct sockaddr*)&destAddr, sizeof(destAddr));
+    return transactionID;
+}
+
+RPCMessage Kademlia::createMessage(RPCType type, const NodeID& receiver) const {
+    RPCMessage message;
+    message.type = type;
+    message.sender = localNode_->getID();
+    message.receiver = receiver;
+    message.senderIP = localNode_->getIP();
+    message.senderPort = localNode_->getPort();
+    return message;
+}
+
+void Kademlia::prepareResponse(RPCMessage& response, RPCType type, const MessageView& request) const {
+    response.type = type;
+    response.sender = localNode_->getID();
+    response.receiver = request.sender;
+    response.senderIP = localNode_->getIP();
+    response.senderPort = localNode_->getPort();
+    response.transactionID = request.transactionID;
+    response.isResponse = true;
+    response.payload.clear();
+}
+
+void Kademlia::sendClosestContacts(RPCType type, const MessageView& request, const NodeID& target) {
+    // Reused per thread, so answering a lookup allocates nothing once warmed up
+    thread_local std::vector<Contact> closestContacts;
+    thread_local RPCMessage response;
+    
+    // Find the k closest contacts to the target
+    routingTable_->findClosestContacts(target, K_VALUE, closestContacts);
     
-    close(sockfd);
+    // Add the closest contacts to the payload
+    prepareResponse(response, type, request);
+    wire::encodeContacts(closestContacts, response.payload);
     
-    return bytesSent > 0;
+    sendRPC(response, request.senderIP, request.senderPort);
 }
 
-void Kademlia::processMessages() {
-    // In a real implementation, this would listen for incoming messages
-    // For simplicity, we'll use a placeholder implementation
+void Kademlia::handleDatagram(const Datagram& datagram) {
+    // Fragments and their acknowledgements belong to a large message in transit. Those of a transfer
+    // already under way were admitted with it; any other counts against its sender before it can start one.
+    uint8_t kind = wire::frameKind(datagram.data, datagram.length);
+    if (kind == wire::FRAME_FRAGMENT || kind == wire::FRAME_FRAGMENT_ACK) {
+        if (!bulkTransfer_->isExpected(datagram) && rateLimiter_ &&
+            !rateLimiter_->allow(datagram.fromIP, utils::getMonotonicTimeMillis())) {
+            return;
+        }
+        bulkTransfer_->handleDatagram(datagram);
+        return;
+    }
     
-    // Create a socket
-    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sockfd < 0) {
+    handleMessage(datagram, true);
+}
+
+void Kademlia::handleMessage(const Datagram& datagram, bool charge) {
+    // Decoded once: the view points into the receive buffer and travels with the message to its handler
+    MessageView message;
+    if (!wire::decodeMessage(datagram.data, datagram.length, message)) {
         return;
     }
     
-    // Set socket to non-blocking
-    int flags = fcntl(sockfd, F_GETFL, 0);
-    fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
+    // Replies to our own requests were asked for; everything else counts against its sender, once
+    bool expected = message.isResponse && rpcClient_->isPending(message.transactionID);
+    if (charge && !expected && rateLimiter_ &&
+        !rateLimiter_->allow(datagram.fromIP, utils::getMonotonicTimeMillis())) {
+        return;
+    }
     
-    // Bind to the local port
-    struct sockaddr_in localAddr;
-    memset(&localAddr, 0, sizeof(localAddr));
-    localAddr.sin_family = AF_INET;
-    localAddr.sin_addr.s_addr = INADDR_ANY;
-    localAddr.sin_port = htons(localNode_->getPort());
+    // The sender IP is taken from the datagram's source address
+    message.senderIP = datagram.fromIP;
+    message.buffer = datagram.buffer;
     
-    if (bind(sockfd, (struct sockaddr*)&localAddr, sizeof(localAddr)) < 0) {
-        close(sockfd);
+    if (!inboundQueue_) {
+        handleRPC(message);
         return;
     }
     
-    // Process messages while running
-    while (running_) {
-        // Wait for a message
-        struct pollfd pfd;
-        pfd.fd = sockfd;
-        pfd.events = POLLIN;
-        
-        if (poll(&pfd, 1, 100) > 0) { // 100ms timeout
-            char buffer[4096];
-            struct sockaddr_in fromAddr;
-            socklen_t fromLen = sizeof(fromAddr);
-            
-            ssize_t bytesRead = recvfrom(sockfd, buffer, sizeof(buffer), 0,
-                                        (struct sockaddr*)&fromAddr, &fromLen);
-            
-            if (bytesRead > 0) {
-                buffer[bytesRead] = '\0';
-                
-                // Deserialize the message
-                // In a real implementation, we would use a proper deserialization format
-                std::string msg(buffer);
-                std::vector<std::string> parts;
-                
-                size_t pos = 0;
-                size_t found;
-                while ((found = msg.find(':', pos)) != std::string::npos) {
-                    parts.push_back(msg.substr(pos, found - pos));
-                    pos = found + 1;
-                }
-                parts.push_back(msg.substr(pos));
-                
-                if (parts.size() >= 6) {
-                    RPCMessage message;
-                    message.type = static_cast<RPCType>(std::stoi(parts[0]));
-                    message.sender = NodeID(parts[1]);
-                    message.receiver = NodeID(parts[2]);
-                    message.senderIP = parts[3];
-                    message.senderPort = static_cast<uint16_t>(std::stoi(parts[4]));
-                    
-                    // Extract the payload
-                    std::string payloadStr = parts[5];
-                    message.payload.assign(payloadStr.begin(), payloadStr.end());
-                    
-                    // Handle the message
-                    handleRPC(message);
-                }
-            }
-        }
+    // Keep pings and awaited replies flowing when unsolicited stores pile up
+    InboundPriority priority = InboundPriority::NORMAL;
+    if (expected || (message.type == RPCType::PING && !message.isResponse)) {
+        priority = InboundPriority::HIGH;
+    } else if (message.type == RPCType::STORE && !message.isResponse) {
+        priority = InboundPriority::LOW;
     }
-    
-    close(sockfd);
+    inboundQueue_->push(datagram, message, priority);
 }
 
 void Kademlia::nodeLookup(const NodeID& target, NodeLookupCallback callback) {
-    // Get the alpha closest nodes to the target from the local routing table
-    const size_t ALPHA = 3; // Parallelism parameter
-    std::vector<NodePtr> closestNodes = routingTable_->findClosestNodes(target, ALPHA);
+    // Seed the shortlist with the k closest nodes from the local routing table
+    std::vector<NodePtr> seeds = routingTable_->findClosestNodes(target, config_.k);
     
-    if (closestNodes.empty()) {
+    if (seeds.empty()) {
         if (callback) {
-            callback(false, std::vector<NodePtr>());
+            callback(false, std::vector<NodePtr>(), LookupStats());
         }
         return;
     }
     
-    // Keep track of nodes we've already queried
-    std::vector<NodePtr> queriedNodes;
-    
-    // Keep track of the k closest nodes we've found
-    std::vector<NodePtr> kClosestNodes = closestNodes;
-    
-    // Query the alpha closest nodes
-    for (const auto& node : closestNodes) {
-        // Create a FIND_NODE RPC message
-        RPCMessage message;
-        message.type = RPCType::FIND_NODE;
-        message.sender = localNode_->getID();
-        message.receiver = node->getID();
-        message.senderIP = localNode_->getIP();
-        message.senderPort = localNode_->getPort();
+    // Each query is a FIND_NODE request whose reply carries the contacts it returned
+    auto query = [this, target](const NodePtr& node, NodeLookup::QueryResultCallback onReply) {
+        RPCMessage message = createMessage(RPCType::FIND_NODE, node->getID());
         
         // Add the target ID to the payload
-        std::string targetStr = target.toString();
-        message.payload.assign(targetStr.begin(), targetStr.end());
+        wire::encodeNodeID(target, message.payload);
         
-        // Send the message
-        if (sendRPC(message)) {
-            queriedNodes.push_back(node);
-        }
-    }
-    
-    // In a real implementation, we would wait for responses and continue the lookup
-    // For simplicity, we'll just return the closest nodes we found
-    
-    if (callback) {
-        callback(true, kClosestNodes);
-    }
+        return sendRequest(node, message, [onReply](bool success, const MessageView& response) {
+            NodeLookup::QueryReply reply;
+            reply.success = success && response.type == RPCType::FIND_NODE &&
+                            wire::decodeContacts(response.payload, reply.contacts);
+            onReply(reply);
+        });
+    };
+    
+    auto cancel = [this](uint32_t transactionID) {
+        rpcClient_->cancel(transactionID);
+    };
+    
+    auto lookup = std::make_shared<NodeLookup>(NodeLookup::Mode::FIND_NODE, target, localNode_->getID(),
+                                               config_.alpha, config_.k, query, cancel,
+        [callback](const LookupResult& result) {
+            if (callback) {
+                callback(result.success, result.nodes, result.stats);
+            }
+        },
+        [this](const NodeID& id) {
+            return rpcClient_->getSmoothedRTT(id);
+        });
+    lookup->start(seeds);
 }
 
-void Kademlia::valueLookup(const DHTKey& key, DHTCallback callback) {
-    // Hash the key to get a NodeID
-    NodeID targetID = utils::hashKey(key.getData());
+void Kademlia::valueLookup(const KeyHash& key, DHTCallback callback) {
+    // Seed the shortlist with the k closest nodes from the local routing table
+    std::vector<NodePtr> seeds = routingTable_->findClosestNodes(key, config_.k);
     
-    // Get the alpha closest nodes to the target from the local routing table
-    const size_t ALPHA = 3; // Parallelism parameter
-    std::vector<NodePtr> closestNodes = routingTable_->findClosestNodes(targetID, ALPHA);
-    
-    if (closestNodes.empty()) {
+    if (seeds.empty()) {
         if (callback) {
             callback(false, std::vector<uint8_t>());
         }
         return;
     }
     
-    // Keep track of nodes we've already queried
-    std::vector<NodePtr> queriedNodes;
-    
-    // Query the alpha closest nodes
-    for (const auto& node : closestNodes) {
-        // Create a FIND_VALUE RPC message
-        RPCMessage message;
-        message.type = RPCType::FIND_VALUE;
-        message.sender = localNode_->getID();
-        message.receiver = node->getID();
-        message.senderIP = localNode_->getIP();
-        message.senderPort = localNode_->getPort();
+    // Each query is a FIND_VALUE request answered with either the value or closer contacts
+    auto query = [this, key](const NodePtr& node, NodeLookup::QueryResultCallback onReply) {
+        RPCMessage message = createMessage(RPCType::FIND_VALUE, node->getID());
         
-        // Add the key to the payload
-        message.payload.assign(key.getData().begin(), key.getData().end());
+        // Add the key hash to the payload
+        wire::encodeNodeID(key, message.payload);
         
-        // Send the message
-        if (sendRPC(message)) {
-            queriedNodes.push_back(node);
-        }
-    }
-    
-    // In a real implementation, we would wait for responses and continue the lookup
-    // For simplicity, we'll just return failure
-    
-    if (callback) {
-        callback(false, std::vector<uint8_t>());
-    }
+        return sendRequest(node, message, [onReply](bool success, const MessageView& response) {
+            NodeLookup::QueryReply reply;
+            if (success && response.type == RPCType::FIND_VALUE) {
+                reply.success = true;
+                reply.hasValue = true;
+                reply.value.assign(response.payload.begin(), response.payload.end());
+            } else {
+                reply.success = success && response.type == RPCType::FIND_NODE &&
+                                wire::decodeContacts(response.payload, reply.contacts);
+            }
+            onReply(reply);
+        });
+    };
+    
+    auto cancel = [this](uint32_t transactionID) {
+        rpcClient_->cancel(transactionID);
+    };
+    
+    auto lookup = std::make_shared<NodeLookup>(NodeLookup::Mode::FIND_VALUE, key, localNode_->getID(),
+                                               config_.alpha, config_.k, query, cancel,
+        [this, key, callback](const LookupResult& result) {
+            if (result.foundValue && result.cacheNode) {
+                // Cache the value at the closest node on the path that lacked it. Each live
+                // node between it and the key halves the lifetime of the cached copy.
+                uint64_t ttlMs = static_cast<uint64_t>(config_.valueTTL.count()) >>
+                                 std::min<size_t>(result.cacheNodeRank, 63);
+                uint32_t ttlSeconds = static_cast<uint32_t>(std::max<uint64_t>(ttlMs / 1000, 1));
+                
+                RPCMessage message = createMessage(RPCType::STORE, result.cacheNode->getID());
+                wire::encodeStorePayload(key, result.value, ttlSeconds, wire::STORE_FLAG_CACHED, message.payload);
+                sendRPC(message, result.cacheNode->getIP(), result.cacheNode->getPort());
+            }
+            
+            if (callback) {
+                callback(result.foundValue, result.value);
+            }
+        },
+        [this](const NodeID& id) {
+            return rpcClient_->getSmoothedRTT(id);
+        });
+    lookup->start(seeds);
 }
 
 } // namespace kademlia
\ No newline at end of file
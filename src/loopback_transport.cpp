@@ -0,0 +1,198 @@
+#include "../include/loopback_transport.h"
+#include <arpa/inet.h>
+#include <utility>
+
+namespace kademlia {
+
+// LoopbackNetwork implementation
+LoopbackNetwork::LoopbackNetwork() : nextPort_(1024), delivered_(0), dropped_(0) {}
+
+uint64_t LoopbackNetwork::makeAddress(uint32_t ip, uint16_t port) {
+    return (static_cast<uint64_t>(ip) << 16) | port;
+}
+
+bool LoopbackNetwork::attach(LoopbackTransport* transport, uint32_t ip, uint16_t& port) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (port == 0) {
+        // Hand out ports in order so a rerun assigns the same ones
+        for (size_t tries = 0; tries < 65536 - 1024; ++tries) {
+            uint16_t candidate = nextPort_;
+            nextPort_ = nextPort_ == UINT16_MAX ? 1024 : static_cast<uint16_t>(nextPort_ + 1);
+
+            if (endpoints_.find(makeAddress(ip, candidate)) == endpoints_.end()) {
+                port = candidate;
+                break;
+            }
+        }
+
+        if (port == 0) {
+            return false;
+        }
+    }
+
+    return endpoints_.emplace(makeAddress(ip, port), transport).second;
+}
+
+void LoopbackNetwork::detach(uint32_t ip, uint16_t port) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    endpoints_.erase(makeAddress(ip, port));
+}
+
+void LoopbackNetwork::enqueue(uint32_t fromIP, uint16_t fromPort, uint32_t toIP, uint16_t toPort,
+                              const uint8_t* data, size_t length) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Packet packet{fromIP, fromPort, toIP, toPort, std::vector<uint8_t>()};
+    if (!spareData_.empty()) {
+        packet.data = std::move(spareData_.back());
+        spareData_.pop_back();
+    }
+    packet.data.assign(data, data + length);
+
+    queue_.push_back(std::move(packet));
+}
+
+size_t LoopbackNetwork::run(size_t maxDatagrams) {
+    size_t count = 0;
+    Packet packet;
+
+    while (count < maxDatagrams) {
+        LoopbackTransport* receiver = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            // Hand the previous packet's payload back for reuse
+            if (packet.data.capacity() > 0) {
+                spareData_.push_back(std::move(packet.data));
+                packet.data = std::vector<uint8_t>();
+            }
+
+            if (queue_.empty()) {
+                break;
+            }
+
+            packet = std::move(queue_.front());
+            queue_.pop_front();
+
+            auto it = endpoints_.find(makeAddress(packet.toIP, packet.toPort));
+            if (it == endpoints_.end()) {
+                dropped_++;
+                continue;
+            }
+
+            receiver = it->second;
+            delivered_++;
+        }
+
+        // Deliver without the lock so the handler can send
+        Datagram datagram;
+        datagram.data = packet.data.data();
+        datagram.length = packet.data.size();
+        datagram.fromIP = packet.fromIP;
+        datagram.fromPort = packet.fromPort;
+
+        if (receiver->onReceive_) {
+            receiver->onReceive_(datagram);
+        }
+        count++;
+    }
+
+    return count;
+}
+
+void LoopbackNetwork::tick() {
+    std::vector<LoopbackTransport*> endpoints;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        endpoints.reserve(endpoints_.size());
+        for (const auto& entry : endpoints_) {
+            endpoints.push_back(entry.second);
+        }
+    }
+
+    for (LoopbackTransport* endpoint : endpoints) {
+        if (endpoint->onTick_) {
+            endpoint->onTick_();
+        }
+    }
+}
+
+size_t LoopbackNetwork::getPendingCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+}
+
+uint64_t LoopbackNetwork::getDeliveredCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return delivered_;
+}
+
+uint64_t LoopbackNetwork::getDroppedCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+}
+
+size_t LoopbackNetwork::getEndpointCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return endpoints_.size();
+}
+
+// LoopbackTransport implementation
+LoopbackTransport::LoopbackTransport(LoopbackNetwork& network, const std::string& ip)
+    : network_(network), ip_(0), port_(0), started_(false) {
+    struct in_addr address;
+    if (inet_pton(AF_INET, ip.c_str(), &address) == 1) {
+        ip_ = address.s_addr;
+    }
+}
+
+LoopbackTransport::~LoopbackTransport() {
+    stop();
+}
+
+bool LoopbackTransport::start(uint16_t port, ReceiveHandler onReceive, TickHandler onTick) {
+    if (started_) {
+        return false;
+    }
+
+    // Set the handlers first; the network may deliver as soon as the endpoint is attached
+    onReceive_ = std::move(onReceive);
+    onTick_ = std::move(onTick);
+
+    if (!network_.attach(this, ip_, port)) {
+        onReceive_ = nullptr;
+        onTick_ = nullptr;
+        return false;
+    }
+
+    port_ = port;
+    started_ = true;
+    return true;
+}
+
+void LoopbackTransport::stop() {
+    if (!started_) {
+        return;
+    }
+
+    network_.detach(ip_, port_);
+    started_ = false;
+}
+
+uint16_t LoopbackTransport::getPort() const {
+    return port_;
+}
+
+bool LoopbackTransport::send(uint32_t ip, uint16_t port, const uint8_t* data, size_t length) {
+    if (!started_) {
+        return false;
+    }
+
+    network_.enqueue(ip_, port_, ip, port, data, length);
+    return true;
+}
+
+} // namespace kademlia
@@ -5,48 +5,61 @@
 #include <sstream>
 #include <iomanip>
 #include <chrono>
+#include <stdexcept>
 
 namespace kademlia {
 
 // NodeID implementation
-NodeID::NodeID() {
-    std::fill(id_.begin(), id_.end(), 0);
-}
-
-NodeID::NodeID(const std::array<uint8_t, KEY_BYTES>& id) : id_(id) {}
+NodeID::NodeID(const std::array<uint8_t, KEY_BYTES>& id) : NodeID(fromBytes(id.data())) {}
 
-NodeID::NodeID(const std::string& hex) {
+NodeID::NodeID(const std::string& hex) : NodeID() {
     if (hex.length() != KEY_BYTES * 2) {
         throw std::invalid_argument("Invalid hex string length for NodeID");
     }
     
+    std::array<uint8_t, KEY_BYTES> id;
     for (size_t i = 0; i < KEY_BYTES; ++i) {
         std::string byteStr = hex.substr(i * 2, 2);
-        id_[i] = static_cast<uint8_t>(std::stoi(byteStr, nullptr, 16));
+        id[i] = static_cast<uint8_t>(std::stoi(byteStr, nullptr, 16));
     }
+    
+    *this = fromBytes(id.data());
+}
+
+NodeID NodeID::fromBytes(const uint8_t* data) {
+    uint64_t words[WORDS] = {0, 0, 0};
+    
+    // Pack the bytes big-endian so word order matches byte order
+    for (size_t i = 0; i < KEY_BYTES; ++i) {
+        words[i / 8] |= static_cast<uint64_t>(data[i]) << (56 - 8 * (i % 8));
+    }
+    
+    return NodeID(words[0], words[1], words[2]);
 }
 
 NodeID NodeID::random() {
     std::array<uint8_t, KEY_BYTES> id;
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, 255);
+    std::mt19937_64& engine = utils::randomEngine();
     
-    for (size_t i = 0; i < KEY_BYTES; ++i) {
-        id[i] = static_cast<uint8_t>(dis(gen));
+    for (size_t i = 0; i < KEY_BYTES; i += 8) {
+        uint64_t word = engine();
+        std::memcpy(id.data() + i, &word, std::min<size_t>(8, KEY_BYTES - i));
     }
     
     return NodeID(id);
 }
 
-NodeID NodeID::distance(const NodeID& other) const {
-    std::array<uint8_t, KEY_BYTES> result;
+NodeID NodeID::randomWithPrefix(const NodeID& prefix, size_t prefixBits) {
+    NodeID id = random();
     
-    for (size_t i = 0; i < KEY_BYTES; ++i) {
-        result[i] = id_[i] ^ other.id_[i];
+    // Keep the leading prefixBits bits of the prefix, word by word
+    for (size_t i = 0; i < WORDS && prefixBits > 64 * i; ++i) {
+        size_t bits = prefixBits - 64 * i;
+        uint64_t mask = bits >= 64 ? ~uint64_t(0) : ~(~uint64_t(0) >> bits);
+        id.words_[i] = (prefix.words_[i] & mask) | (id.words_[i] & ~mask);
     }
     
-    return NodeID(result);
+    return id;
 }
 
 bool NodeID::getBit(size_t position) const {
@@ -54,10 +67,18 @@ bool NodeID::getBit(size_t position) const {
         throw std::out_of_range("Bit position out of range");
     }
     
-    size_t bytePos = position / 8;
-    size_t bitPos = 7 - (position % 8);
+    return (words_[position / 64] >> (63 - position % 64)) & 1;
+}
+
+NodeID NodeID::withBit(size_t position, bool value) const {
+    if (position >= KEY_BITS) {
+        throw std::out_of_range("Bit position out of range");
+    }
     
-    return (id_[bytePos] & (1 << bitPos)) != 0;
+    NodeID id = *this;
+    uint64_t mask = uint64_t(1) << (63 - position % 64);
+    id.words_[position / 64] = value ? (id.words_[position / 64] | mask) : (id.words_[position / 64] & ~mask);
+    return id;
 }
 
 uint8_t NodeID::getByte(size_t position) const {
@@ -65,40 +86,32 @@ uint8_t NodeID::getByte(size_t position) const {
         throw std::out_of_range("Byte position out of range");
     }
     
-    return id_[position];
+    return static_cast<uint8_t>(words_[position / 8] >> (56 - 8 * (position % 8)));
 }
 
-std::string NodeID::toString() const {
-    std::stringstream ss;
-    ss << std::hex << std::setfill('0');
-    
-    for (auto byte : id_) {
-        ss << std::setw(2) << static_cast<int>(byte);
+void NodeID::copyTo(uint8_t* out) const {
+    for (size_t i = 0; i < KEY_BYTES; ++i) {
+        out[i] = static_cast<uint8_t>(words_[i / 8] >> (56 - 8 * (i % 8)));
     }
-    
-    return ss.str();
-}
-
-bool NodeID::operator==(const NodeID& other) const {
-    return id_ == other.id_;
 }
 
-bool NodeID::operator!=(const NodeID& other) const {
-    return !(*this == other);
-}
-
-bool NodeID::operator<(const NodeID& other) const {
-    return id_ < other.id_;
+std::string NodeID::toString() const {
+    return utils::arrayToHex(getRaw());
 }
 
-const std::array<uint8_t, KEY_BYTES>& NodeID::getRaw() const {
-    return id_;
+std::array<uint8_t, KEY_BYTES> NodeID::getRaw() const {
+    std::array<uint8_t, KEY_BYTES> raw;
+    copyTo(raw.data());
+    return raw;
 }
 
 // Node implementation
 Node::Node(const NodeID& id, const std::string& ip, uint16_t port)
     : id_(id), ip_(ip), port_(port), lastSeen_(utils::getCurrentTimeMillis()) {}
 
+Node::Node(const NodeID& id, const std::string& ip, uint16_t port, uint64_t lastSeen)
+    : id_(id), ip_(ip), port_(port), lastSeen_(lastSeen) {}
+
 const NodeID& Node::getID() const {
     return id_;
 }
@@ -111,14 +124,17 @@ uint16_t Node::getPort() const {
     return port_;
 }
 
+uint64_t Node::getLastSeen() const {
+    return lastSeen_;
+}
+
 void Node::updateLastSeen() {
     lastSeen_ = utils::getCurrentTimeMillis();
 }
 
 bool Node::isActive() const {
     // Consider a node inactive if it hasn't been seen in the last 15 minutes
-    const uint64_t INACTIVE_THRESHOLD = 15 * 60 * 1000; // 15 minutes in milliseconds
-    return (utils::getCurrentTimeMillis() - lastSeen_) < INACTIVE_THRESHOLD;
+    return (utils::getCurrentTimeMillis() - lastSeen_) < INACTIVE_THRESHOLD_MS;
 }
 
 std::string Node::toString() const {
@@ -0,0 +1,305 @@
+#include "../include/node_lookup.h"
+#include "../include/utils.h"
+#include <algorithm>
+
+namespace kademlia {
+
+NodeLookup::NodeLookup(Mode mode, const NodeID& target, const NodeID& localID, size_t alpha, size_t k,
+                       QueryFunction query, CancelFunction cancel, CompletionCallback callback,
+                       RTTFunction rtt)
+    : mode_(mode), target_(target), localID_(localID),
+      alpha_(std::max<size_t>(alpha, 1)), k_(std::max<size_t>(k, 1)),
+      query_(std::move(query)), cancel_(std::move(cancel)), callback_(std::move(callback)),
+      rtt_(std::move(rtt)),
+      inFlight_(0), finalRound_(false), finished_(false), startTimeMs_(0) {}
+
+void NodeLookup::start(const std::vector<NodePtr>& seeds) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        startTimeMs_ = utils::getMonotonicTimeMillis();
+        mergeContacts(seeds, 1);
+    }
+
+    advance();
+}
+
+const NodeID& NodeLookup::getTarget() const {
+    return target_;
+}
+
+std::vector<NodeLookup::Candidate>::iterator NodeLookup::findCandidate(const NodeID& id) {
+    NodeID distance = id.distance(target_);
+
+    // An equal distance to the target means the same ID
+    auto it = std::lower_bound(shortlist_.begin(), shortlist_.end(), distance,
+        [](const Candidate& c, const NodeID& d) {
+            return c.distance < d;
+        });
+
+    if (it != shortlist_.end() && it->distance != distance) {
+        return shortlist_.end();
+    }
+
+    return it;
+}
+
+bool NodeLookup::mergeContacts(const std::vector<NodePtr>& contacts, size_t depth) {
+    NodeID closestBefore;
+    bool hadClosest = false;
+
+    // The closest distance seen so far, ignoring nodes that failed to answer
+    for (const auto& candidate : shortlist_) {
+        if (candidate.state != CandidateState::FAILED) {
+            closestBefore = candidate.distance;
+            hadClosest = true;
+            break;
+        }
+    }
+
+    bool improved = false;
+
+    for (const auto& contact : contacts) {
+        if (!contact || contact->getID() == localID_) {
+            continue;
+        }
+
+        NodeID distance = contact->getID().distance(target_);
+
+        auto it = std::lower_bound(shortlist_.begin(), shortlist_.end(), distance,
+            [](const Candidate& c, const NodeID& d) {
+                return c.distance < d;
+            });
+
+        if (it != shortlist_.end() && it->distance == distance) {
+            continue;
+        }
+
+        shortlist_.insert(it, Candidate{contact, distance, CandidateState::NOT_QUERIED, depth, 0});
+
+        if (!hadClosest || distance < closestBefore) {
+            improved = true;
+        }
+    }
+
+    return improved;
+}
+
+void NodeLookup::handleReply(const NodeID& id, const QueryReply& reply) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (finished_) {
+            return;
+        }
+
+        auto it = findCandidate(id);
+        if (it == shortlist_.end() || it->state != CandidateState::IN_FLIGHT) {
+            return;
+        }
+
+        --inFlight_;
+
+        if (!reply.success) {
+            it->state = CandidateState::FAILED;
+        } else {
+            stats_.responses++;
+            stats_.hops = std::max(stats_.hops, it->depth);
+
+            if (mode_ == Mode::FIND_VALUE && reply.hasValue) {
+                it->state = CandidateState::HAS_VALUE;
+            } else {
+                it->state = CandidateState::RESPONDED;
+
+                // A response without a closer node ends the alpha-limited phase
+                if (!mergeContacts(reply.contacts, it->depth + 1)) {
+                    finalRound_ = true;
+                }
+            }
+        }
+    }
+
+    if (mode_ == Mode::FIND_VALUE && reply.success && reply.hasValue) {
+        finishWithValue(reply.value);
+        return;
+    }
+
+    advance();
+}
+
+uint64_t NodeLookup::queryRank(const Candidate& candidate) const {
+    // Nodes never measured go after every measured one
+    uint64_t rtt = rtt_(candidate.node->getID());
+    return rtt > 0 ? rtt : UINT64_MAX;
+}
+
+void NodeLookup::advance() {
+    std::vector<NodePtr> toQuery;
+    LookupResult result;
+    bool done = false;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (finished_) {
+            return;
+        }
+
+        // Collect the k closest nodes that have not failed
+        size_t limit = finalRound_ ? k_ : alpha_;
+        size_t responded = 0;
+        std::vector<Candidate*> closest;
+        closest.reserve(k_);
+
+        for (auto& candidate : shortlist_) {
+            if (closest.size() >= k_) {
+                break;
+            }
+            if (candidate.state == CandidateState::FAILED) {
+                continue;
+            }
+            closest.push_back(&candidate);
+
+            if (candidate.state == CandidateState::RESPONDED) {
+                ++responded;
+            }
+        }
+
+        // Query the closest unqueried nodes while slots are free. Nodes at the same log distance are
+        // adjacent in the shortlist, and the fastest of them goes ahead of the others.
+        for (size_t i = 0; i < closest.size() && inFlight_ < limit; ++i) {
+            if (closest[i]->state != CandidateState::NOT_QUERIED) {
+                continue;
+            }
+
+            size_t pick = i;
+            if (rtt_) {
+                size_t band = closest[i]->distance.leadingZeroBits();
+                uint64_t bestRank = queryRank(*closest[i]);
+
+                for (size_t j = i + 1; j < closest.size() && closest[j]->distance.leadingZeroBits() == band; ++j) {
+                    if (closest[j]->state == CandidateState::NOT_QUERIED) {
+                        uint64_t rank = queryRank(*closest[j]);
+                        if (rank < bestRank) {
+                            bestRank = rank;
+                            pick = j;
+                        }
+                    }
+                }
+            }
+
+            closest[pick]->state = CandidateState::IN_FLIGHT;
+            ++inFlight_;
+            stats_.rpcs++;
+            toQuery.push_back(closest[pick]->node);
+
+            // A faster node further on went first; this one may still get the next slot
+            if (pick != i) {
+                --i;
+            }
+        }
+
+        // Finish once the k closest live nodes have all answered
+        if (inFlight_ == 0 && toQuery.empty()) {
+            finished_ = true;
+            done = true;
+
+            // A value lookup that gets here never found the value
+            result.success = mode_ == Mode::FIND_NODE && responded > 0;
+
+            for (const auto& candidate : shortlist_) {
+                if (result.nodes.size() >= k_) {
+                    break;
+                }
+                if (candidate.state == CandidateState::RESPONDED) {
+                    result.nodes.push_back(candidate.node);
+                }
+            }
+
+            recordDuration();
+            result.stats = stats_;
+        }
+    }
+
+    if (done) {
+        if (callback_) {
+            callback_(result);
+        }
+        return;
+    }
+
+    // Send outside the lock; a failed send may call back synchronously
+    auto self = shared_from_this();
+    for (const auto& node : toQuery) {
+        NodeID id = node->getID();
+        uint32_t handle = query_(node, [self, id](const QueryReply& reply) {
+            self->handleReply(id, reply);
+        });
+
+        // Remember the handle so the query can be cancelled on early termination
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = findCandidate(id);
+        if (it != shortlist_.end() && it->state == CandidateState::IN_FLIGHT) {
+            it->handle = handle;
+        }
+    }
+}
+
+void NodeLookup::finishWithValue(const std::vector<uint8_t>& value) {
+    LookupResult result;
+    std::vector<uint32_t> toCancel;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (finished_) {
+            return;
+        }
+        finished_ = true;
+
+        result.success = true;
+        result.foundValue = true;
+        result.value = value;
+
+        size_t rank = 0;
+        for (const auto& candidate : shortlist_) {
+            if (candidate.state == CandidateState::IN_FLIGHT && candidate.handle != 0) {
+                toCancel.push_back(candidate.handle);
+            }
+
+            // The closest node that answered without the value caches it
+            if (candidate.state == CandidateState::RESPONDED) {
+                if (!result.cacheNode) {
+                    result.cacheNode = candidate.node;
+                    result.cacheNodeRank = rank;
+                }
+                if (result.nodes.size() < k_) {
+                    result.nodes.push_back(candidate.node);
+                }
+            }
+
+            if (candidate.state != CandidateState::FAILED) {
+                ++rank;
+            }
+        }
+
+        recordDuration();
+        result.stats = stats_;
+    }
+
+    // Stop the remaining queries; their replies are ignored from here on
+    if (cancel_) {
+        for (uint32_t handle : toCancel) {
+            cancel_(handle);
+        }
+    }
+
+    if (callback_) {
+        callback_(result);
+    }
+}
+
+void NodeLookup::recordDuration() {
+    stats_.durationMs = utils::getMonotonicTimeMillis() - startTimeMs_;
+}
+
+} // namespace kademlia
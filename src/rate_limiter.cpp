@@ -0,0 +1,74 @@
+#include "../include/rate_limiter.h"
+#include <algorithm>
+#include <cmath>
+
+namespace kademlia {
+
+RateLimiter::RateLimiter(double ratePerSecond, double burst)
+    : ratePerMs_(std::max(ratePerSecond, 0.001) / 1000.0), burst_(std::max(burst, 1.0)),
+      refillMs_(static_cast<uint64_t>(std::ceil(burst_ / ratePerMs_))), rejected_(0) {}
+
+bool RateLimiter::allow(uint32_t ip, uint64_t now) {
+    // Mix the address so sources on one subnet spread over the shards
+    Shard& shard = shards_[((ip * 0x9E3779B97F4A7C15ULL) >> 32) % RATE_LIMITER_SHARDS];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.buckets.find(ip);
+    if (it == shard.buckets.end()) {
+        if (shard.buckets.size() >= MAX_RATE_LIMITED_SOURCES / RATE_LIMITER_SHARDS) {
+            evict(shard, now);
+        }
+
+        // A new source starts with a full bucket and spends one token right away
+        shard.buckets.emplace(ip, Bucket{burst_ - 1, now});
+        return true;
+    }
+
+    Bucket& bucket = it->second;
+    if (now > bucket.lastRefillMs) {
+        bucket.tokens = std::min(burst_, bucket.tokens + static_cast<double>(now - bucket.lastRefillMs) * ratePerMs_);
+        bucket.lastRefillMs = now;
+    }
+
+    if (bucket.tokens < 1) {
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    bucket.tokens -= 1;
+    return true;
+}
+
+uint64_t RateLimiter::getRejectedCount() const {
+    return rejected_.load(std::memory_order_relaxed);
+}
+
+size_t RateLimiter::size() const {
+    size_t total = 0;
+    for (const Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.buckets.size();
+    }
+    return total;
+}
+
+void RateLimiter::evict(Shard& shard, uint64_t now) {
+    // Sweep out sources idle long enough to have refilled, at most once per refill period
+    if (now >= shard.lastSweepMs + refillMs_) {
+        shard.lastSweepMs = now;
+        for (auto it = shard.buckets.begin(); it != shard.buckets.end();) {
+            if (now >= it->second.lastRefillMs + refillMs_) {
+                it = shard.buckets.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // Every source is active, as in a flood from many addresses; forget an arbitrary one
+    if (shard.buckets.size() >= MAX_RATE_LIMITED_SOURCES / RATE_LIMITER_SHARDS) {
+        shard.buckets.erase(shard.buckets.begin());
+    }
+}
+
+} // namespace kademlia
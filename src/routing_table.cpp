@@ -4,57 +4,56 @@
 
 namespace kademlia {
 
-// KBucket implementation
-KBucket::KBucket() : mutex_(std::make_shared<std::mutex>()) {}
-
-KBucket::KBucket(const KBucket& other) : nodes_(other.nodes_), mutex_(std::make_shared<std::mutex>()) {}
-
-KBucket::KBucket(KBucket&& other) noexcept : nodes_(std::move(other.nodes_)), mutex_(std::move(other.mutex_)) {}
+// Contact implementation
+Contact Contact::fromNode(const Node& node) {
+    Contact contact;
+    contact.id = node.getID();
+    utils::ipToBinary(node.getIP(), contact.ip);
+    contact.port = node.getPort();
+    contact.lastSeen = node.getLastSeen();
+    return contact;
+}
 
-KBucket& KBucket::operator=(const KBucket& other) {
-    if (this != &other) {
-        nodes_ = other.nodes_;
-        mutex_ = std::make_shared<std::mutex>();
-    }
-    return *this;
+NodePtr Contact::toNode() const {
+    return std::make_shared<Node>(id, utils::binaryToIP(ip), port, lastSeen);
 }
 
-KBucket& KBucket::operator=(KBucket&& other) noexcept {
-    if (this != &other) {
-        nodes_ = std::move(other.nodes_);
-        mutex_ = std::move(other.mutex_);
-    }
-    return *this;
+bool Contact::isActive(uint64_t now) const {
+    return (now - lastSeen) < INACTIVE_THRESHOLD_MS;
 }
 
+// KBucket implementation
+KBucket::KBucket() : size_(0) {}
+
 bool KBucket::addNode(const NodePtr& node) {
-    std::lock_guard<std::mutex> lock(*mutex_);
-    
+    return addContact(Contact::fromNode(*node));
+}
+
+bool KBucket::addContact(const Contact& contact) {
     // Check if the node is already in the bucket
-    auto it = std::find_if(nodes_.begin(), nodes_.end(),
-        [&node](const NodePtr& n) {
-            return n->getID() == node->getID();
-        });
+    size_t slot = findSlot(contact.id);
     
-    if (it != nodes_.end()) {
-        // Node already exists, move it to the end (most recently seen)
-        nodes_.erase(it);
-        nodes_.push_back(node);
+    if (slot < K_VALUE) {
+        // Node already exists, refresh it and mark it most recently seen
+        contacts_[slot] = contact;
+        touch(slot);
         return true;
     }
     
     // If the bucket is not full, add the node
-    if (nodes_.size() < K_VALUE) {
-        nodes_.push_back(node);
+    if (size_ < K_VALUE) {
+        contacts_[size_] = contact;
+        order_[size_] = size_;
+        size_++;
         return true;
     }
     
     // Bucket is full, check if the least recently seen node is still active
-    NodePtr leastRecentNode = nodes_.front();
-    if (!leastRecentNode->isActive()) {
-        // Replace the inactive node
-        nodes_.pop_front();
-        nodes_.push_back(node);
+    size_t leastRecent = order_[0];
+    if (!contacts_[leastRecent].isActive(utils::getCurrentTimeMillis())) {
+        // Replace the inactive node in its slot
+        contacts_[leastRecent] = contact;
+        touch(leastRecent);
         return true;
     }
     
@@ -62,130 +61,388 @@ bool KBucket::addNode(const NodePtr& node) {
     return false;
 }
 
+bool KBucket::hasRoom(uint64_t now) const {
+    return size_ < K_VALUE || !contacts_[order_[0]].isActive(now);
+}
+
 bool KBucket::removeNode(const NodeID& id) {
-    std::lock_guard<std::mutex> lock(*mutex_);
+    size_t slot = findSlot(id);
+    if (slot >= K_VALUE) {
+        return false;
+    }
     
-    auto it = std::find_if(nodes_.begin(), nodes_.end(),
-        [&id](const NodePtr& n) {
-            return n->getID() == id;
-        });
+    // Drop the slot from the LRU order
+    auto orderEnd = order_.begin() + size_;
+    std::copy(std::find(order_.begin(), orderEnd, slot) + 1, orderEnd,
+              std::find(order_.begin(), orderEnd, slot));
+    size_--;
     
-    if (it != nodes_.end()) {
-        nodes_.erase(it);
-        return true;
+    // Keep slots dense by moving the last contact into the freed slot
+    if (slot != size_) {
+        contacts_[slot] = contacts_[size_];
+        *std::find(order_.begin(), order_.begin() + size_, size_) = static_cast<uint8_t>(slot);
     }
     
-    return false;
+    return true;
 }
 
 NodePtr KBucket::getNode(const NodeID& id) const {
-    std::lock_guard<std::mutex> lock(*mutex_);
-    
-    auto it = std::find_if(nodes_.begin(), nodes_.end(),
-        [&id](const NodePtr& n) {
-            return n->getID() == id;
-        });
-    
-    if (it != nodes_.end()) {
-        return *it;
-    }
-    
-    return nullptr;
+    const Contact* contact = findContact(id);
+    return contact ? contact->toNode() : nullptr;
+}
+
+const Contact* KBucket::findContact(const NodeID& id) const {
+    size_t slot = findSlot(id);
+    return slot < K_VALUE ? &contacts_[slot] : nullptr;
 }
 
 std::vector<NodePtr> KBucket::getNodes() const {
-    std::lock_guard<std::mutex> lock(*mutex_);
-    return std::vector<NodePtr>(nodes_.begin(), nodes_.end());
+    std::vector<NodePtr> nodes;
+    nodes.reserve(size_);
+    
+    for (size_t i = 0; i < size_; ++i) {
+        nodes.push_back(contacts_[order_[i]].toNode());
+    }
+    
+    return nodes;
 }
 
 bool KBucket::isFull() const {
-    std::lock_guard<std::mutex> lock(*mutex_);
-    return nodes_.size() >= K_VALUE;
+    return size_ >= K_VALUE;
 }
 
 size_t KBucket::size() const {
-    std::lock_guard<std::mutex> lock(*mutex_);
-    return nodes_.size();
+    return size_;
+}
+
+void KBucket::splitInto(size_t bit, KBucket& zero, KBucket& one) const {
+    // Re-adding in LRU order keeps the relative order in each half
+    for (size_t i = 0; i < size_; ++i) {
+        const Contact& contact = contacts_[order_[i]];
+        (contact.id.getBit(bit) ? one : zero).addContact(contact);
+    }
+}
+
+size_t KBucket::findSlot(const NodeID& id) const {
+    for (size_t i = 0; i < size_; ++i) {
+        if (contacts_[i].id == id) {
+            return i;
+        }
+    }
+    
+    return K_VALUE;
+}
+
+void KBucket::touch(size_t slot) {
+    auto orderEnd = order_.begin() + size_;
+    auto it = std::find(order_.begin(), orderEnd, slot);
+    std::rotate(it, it + 1, orderEnd);
 }
 
 // RoutingTable implementation
-RoutingTable::RoutingTable(const NodeID& localID) : localID_(localID) {
-    // Initialize buckets (one for each bit in the key)
-    buckets_.resize(KEY_BITS);
+RoutingTable::RoutingTable(const NodeID& localID, size_t relaxedSplitBits)
+    : localID_(localID), relaxedSplitBits_(std::max<size_t>(relaxedSplitBits, 1)),
+      root_(new TreeNode()), bucketCount_(1) {}
+
+RoutingTable::~RoutingTable() {
+    destroy(root_.load(std::memory_order_acquire));
 }
 
 bool RoutingTable::addNode(const NodePtr& node) {
+    return addContact(Contact::fromNode(*node));
+}
+
+bool RoutingTable::addContact(const Contact& contact) {
     // Don't add the local node to the routing table
-    if (node->getID() == localID_) {
+    if (contact.id == localID_) {
         return false;
     }
     
-    size_t bucketIndex = getBucketIndex(node->getID());
-    return buckets_[bucketIndex].addNode(node);
+    {
+        // A contact already known at the same address and seen recently needs no new version
+        EpochManager::Guard guard = epochs_.enter();
+        const TreeNode* leaf = findLeaf(root_.load(std::memory_order_acquire), contact.id);
+        const Contact* existing = leaf->bucket.findContact(contact.id);
+        if (existing && existing->ip == contact.ip && existing->port == contact.port &&
+            contact.lastSeen < existing->lastSeen + LAST_SEEN_RESOLUTION_MS) {
+            return true;
+        }
+        
+        // A new contact cannot enter a full bucket of active contacts that cannot split
+        if (!existing && !leaf->bucket.hasRoom(utils::getCurrentTimeMillis()) && !canSplit(*leaf)) {
+            return false;
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    
+    std::vector<const TreeNode*> path;
+    const TreeNode* oldLeaf = findLeaf(root_.load(std::memory_order_relaxed), contact.id, &path);
+    
+    // Modify a private copy of the leaf
+    TreeNode* newLeaf = new TreeNode(*oldLeaf);
+    TreeNode* leaf = newLeaf;
+    bool added = false;
+    bool splitLeaf = false;
+    
+    while (!(added = leaf->bucket.addContact(contact))) {
+        // The bucket is full of active contacts; split it if allowed and retry in the new half
+        if (!canSplit(*leaf)) {
+            break;
+        }
+        
+        leaf = split(*leaf)[contact.id.getBit(leaf->depth)];
+        splitLeaf = true;
+    }
+    
+    // Publish if anything changed, including splits that did not make room for the contact
+    if (added || splitLeaf) {
+        publish(path, oldLeaf, newLeaf);
+    } else {
+        delete newLeaf;
+    }
+    
+    return added;
 }
 
 bool RoutingTable::removeNode(const NodeID& id) {
-    size_t bucketIndex = getBucketIndex(id);
-    return buckets_[bucketIndex].removeNode(id);
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    
+    std::vector<const TreeNode*> path;
+    const TreeNode* oldLeaf = findLeaf(root_.load(std::memory_order_relaxed), id, &path);
+    if (!oldLeaf->bucket.findContact(id)) {
+        return false;
+    }
+    
+    TreeNode* newLeaf = new TreeNode(*oldLeaf);
+    newLeaf->bucket.removeNode(id);
+    publish(path, oldLeaf, newLeaf);
+    
+    return true;
 }
 
 std::vector<NodePtr> RoutingTable::findClosestNodes(const NodeID& id, size_t count) const {
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Contact> contacts;
+    findClosestContacts(id, count, contacts);
     
     std::vector<NodePtr> closestNodes;
+    closestNodes.reserve(contacts.size());
+    for (const auto& contact : contacts) {
+        closestNodes.push_back(contact.toNode());
+    }
     
-    // Collect all nodes from all buckets
-    for (const auto& bucket : buckets_) {
-        auto nodes = bucket.getNodes();
-        closestNodes.insert(closestNodes.end(), nodes.begin(), nodes.end());
+    return closestNodes;
+}
+
+void RoutingTable::findClosestContacts(const NodeID& id, size_t count, std::vector<Contact>& contacts) const {
+    contacts.clear();
+    if (count == 0) {
+        return;
     }
     
-    // Sort nodes by distance to the target ID
-    closestNodes = utils::sortNodesByDistance(closestNodes, id);
+    // Bounded max-heap of the best candidates so far, keyed by their precomputed distance.
+    // Candidates point at contact records; only the winners are copied out.
+    using Candidate = std::pair<NodeID, const Contact*>;
+    auto farther = [](const Candidate& a, const Candidate& b) {
+        return a.first < b.first;
+    };
     
-    // Limit the number of nodes
-    if (closestNodes.size() > count) {
-        closestNodes.resize(count);
+    // Scratch space reused by every lookup on this thread
+    thread_local std::vector<Candidate> heap;
+    thread_local std::vector<const TreeNode*> stack;
+    heap.clear();
+    stack.clear();
+    heap.reserve(count);
+    
+    auto visitBucket = [&](const KBucket& bucket) {
+        bucket.visitContacts([&](const Contact& contact) {
+            NodeID distance = contact.id.distance(id);
+            
+            if (heap.size() < count) {
+                heap.emplace_back(distance, &contact);
+                std::push_heap(heap.begin(), heap.end(), farther);
+            } else if (distance < heap.front().first) {
+                std::pop_heap(heap.begin(), heap.end(), farther);
+                heap.back() = Candidate(distance, &contact);
+                std::push_heap(heap.begin(), heap.end(), farther);
+            }
+        });
+    };
+    
+    EpochManager::Guard guard = epochs_.enter();
+    
+    // Descend the tree, visiting the child that agrees with the target on the next bit first.
+    // Every ID in that child is closer to the target than any ID in its sibling, so once the
+    // heap is full the sibling cannot hold a closer node.
+    stack.push_back(root_.load(std::memory_order_acquire));
+    
+    while (!stack.empty() && heap.size() < count) {
+        const TreeNode* node = stack.back();
+        stack.pop_back();
+        
+        while (!node->isLeaf()) {
+            bool bit = id.getBit(node->depth);
+            stack.push_back(node->children[!bit]);
+            node = node->children[bit];
+        }
+        
+        visitBucket(node->bucket);
     }
     
-    return closestNodes;
+    // Order the winners from closest to farthest
+    std::sort_heap(heap.begin(), heap.end(), farther);
+    
+    contacts.reserve(heap.size());
+    for (const auto& candidate : heap) {
+        contacts.push_back(*candidate.second);
+    }
 }
 
 NodePtr RoutingTable::getNode(const NodeID& id) const {
-    size_t bucketIndex = getBucketIndex(id);
-    return buckets_[bucketIndex].getNode(id);
+    EpochManager::Guard guard = epochs_.enter();
+    return findLeaf(root_.load(std::memory_order_acquire), id)->bucket.getNode(id);
 }
 
 std::vector<NodePtr> RoutingTable::getAllNodes() const {
-    std::lock_guard<std::mutex> lock(mutex_);
+    EpochManager::Guard guard = epochs_.enter();
     
     std::vector<NodePtr> allNodes;
     
-    for (const auto& bucket : buckets_) {
-        auto nodes = bucket.getNodes();
-        allNodes.insert(allNodes.end(), nodes.begin(), nodes.end());
+    std::vector<const TreeNode*> stack;
+    stack.push_back(root_.load(std::memory_order_acquire));
+    
+    while (!stack.empty()) {
+        const TreeNode* node = stack.back();
+        stack.pop_back();
+        
+        if (node->isLeaf()) {
+            auto nodes = node->bucket.getNodes();
+            allNodes.insert(allNodes.end(), nodes.begin(), nodes.end());
+        } else {
+            stack.push_back(node->children[1]);
+            stack.push_back(node->children[0]);
+        }
     }
     
     return allNodes;
 }
 
-size_t RoutingTable::getBucketIndex(const NodeID& id) const {
-    // Calculate the XOR distance between the local ID and the given ID
-    NodeID distance = localID_.distance(id);
+std::vector<BucketRange> RoutingTable::getBucketRanges() const {
+    EpochManager::Guard guard = epochs_.enter();
     
-    // Find the index of the first bit that is 1 (from left to right)
-    for (size_t i = 0; i < KEY_BITS; ++i) {
-        if (distance.getBit(i)) {
-            return i;
+    std::vector<BucketRange> ranges;
+    ranges.reserve(bucketCount_.load(std::memory_order_relaxed));
+    
+    std::vector<const TreeNode*> stack;
+    stack.push_back(root_.load(std::memory_order_acquire));
+    
+    while (!stack.empty()) {
+        const TreeNode* node = stack.back();
+        stack.pop_back();
+        
+        if (node->isLeaf()) {
+            ranges.push_back(BucketRange{node->prefix, node->depth, node->bucket.size()});
+        } else {
+            stack.push_back(node->children[1]);
+            stack.push_back(node->children[0]);
         }
     }
     
-    // If all bits are 0, use the last bucket
-    return KEY_BITS - 1;
+    return ranges;
+}
+
+size_t RoutingTable::getBucketCount() const {
+    return bucketCount_.load(std::memory_order_relaxed);
+}
+
+size_t RoutingTable::getBucketIndex(const NodeID& id) const {
+    // The index of the first bit that differs from the local ID
+    size_t index = localID_.commonPrefixLength(id);
+    
+    // If all bits are equal, use the last bucket
+    return index < KEY_BITS ? index : KEY_BITS - 1;
 }
 
 const NodeID& RoutingTable::getLocalID() const {
     return localID_;
 }
 
-} // namespace kademlia
\ No newline at end of file
+const RoutingTable::TreeNode* RoutingTable::findLeaf(const TreeNode* root, const NodeID& id,
+                                                     std::vector<const TreeNode*>* path) {
+    const TreeNode* node = root;
+    
+    while (!node->isLeaf()) {
+        if (path) {
+            path->push_back(node);
+        }
+        node = node->children[id.getBit(node->depth)];
+    }
+    
+    return node;
+}
+
+bool RoutingTable::canSplit(const TreeNode& leaf) const {
+    // A leaf one bit short of the full key cannot be split further
+    if (leaf.depth + 1 >= KEY_BITS) {
+        return false;
+    }
+    
+    // Always split the bucket covering the local ID
+    if (localID_.commonPrefixLength(leaf.prefix) >= leaf.depth) {
+        return true;
+    }
+    
+    // Relaxed split: other buckets split until their depth is a multiple of relaxedSplitBits
+    return leaf.depth % relaxedSplitBits_ != 0;
+}
+
+std::array<RoutingTable::TreeNode*, 2> RoutingTable::split(TreeNode& leaf) {
+    std::array<TreeNode*, 2> children;
+    
+    for (int bit = 0; bit < 2; ++bit) {
+        children[bit] = new TreeNode();
+        children[bit]->prefix = leaf.prefix.withBit(leaf.depth, bit != 0);
+        children[bit]->depth = leaf.depth + 1;
+    }
+    
+    leaf.bucket.splitInto(leaf.depth, children[0]->bucket, children[1]->bucket);
+    leaf.bucket = KBucket();
+    leaf.children[0] = children[0];
+    leaf.children[1] = children[1];
+    bucketCount_.fetch_add(1, std::memory_order_relaxed);
+    
+    return children;
+}
+
+void RoutingTable::publish(const std::vector<const TreeNode*>& path, const TreeNode* oldLeaf, TreeNode* newLeaf) {
+    // Copy the path bottom-up, pointing each copy at the replacement of its old child
+    const TreeNode* oldChild = oldLeaf;
+    const TreeNode* newChild = newLeaf;
+    
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+        TreeNode* copy = new TreeNode(**it);
+        copy->children[copy->children[1] == oldChild ? 1 : 0] = newChild;
+        oldChild = *it;
+        newChild = copy;
+    }
+    
+    root_.store(newChild, std::memory_order_release);
+    
+    // Readers may still be walking the old path; free it once they have left
+    for (const TreeNode* node : path) {
+        epochs_.retire(const_cast<TreeNode*>(node));
+    }
+    epochs_.retire(const_cast<TreeNode*>(oldLeaf));
+}
+
+void RoutingTable::destroy(const TreeNode* node) {
+    if (!node) {
+        return;
+    }
+    
+    destroy(node->children[0]);
+    destroy(node->children[1]);
+    delete node;
+}
+
+} // namespace kademlia
@@ -0,0 +1,208 @@
+#include "../include/rpc_client.h"
+#include "../include/utils.h"
+#include <algorithm>
+#include <vector>
+
+namespace kademlia {
+
+RPCClient::RPCClient(std::chrono::milliseconds defaultTimeout, std::chrono::milliseconds minTimeout,
+                     std::chrono::milliseconds maxTimeout, size_t maxRetries)
+    : defaultTimeout_(defaultTimeout),
+      maxTimeoutMs_(static_cast<uint64_t>(std::max(maxTimeout, defaultTimeout).count())),
+      maxRetries_(maxRetries),
+      nextID_(utils::getRandomInRange<uint32_t>(1, UINT32_MAX)),
+      retransmits_(0),
+      rtt_(static_cast<uint64_t>(defaultTimeout.count()), static_cast<uint64_t>(minTimeout.count()),
+           maxTimeoutMs_) {}
+
+uint32_t RPCClient::nextTransactionID() {
+    uint32_t id = nextID_.fetch_add(1);
+
+    // Zero is reserved for messages that expect no reply
+    if (id == 0) {
+        id = nextID_.fetch_add(1);
+    }
+
+    return id;
+}
+
+void RPCClient::addPending(uint32_t transactionID, const NodeID& peer, RPCResponseCallback callback,
+                           std::chrono::milliseconds timeout, RPCRetransmitFunction retransmit) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    uint64_t now = utils::getMonotonicTimeMillis();
+    uint64_t timeoutMs = timeout.count() > 0 ? static_cast<uint64_t>(timeout.count()) : rtt_.getTimeout(peer);
+
+    auto timer = timers_.emplace(now + timeoutMs, transactionID);
+    pending_[transactionID] = PendingRequest{peer, std::move(callback), timer, std::move(retransmit),
+                                             now, timeoutMs, 1};
+}
+
+bool RPCClient::handleResponse(const MessageView& response) {
+    RPCResponseCallback callback;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = pending_.find(response.transactionID);
+        if (it == pending_.end()) {
+            return false;
+        }
+
+        // Ignore replies from a node other than the one we asked
+        const PendingRequest& request = it->second;
+        if (request.peer != NodeID() && request.peer != response.sender) {
+            return false;
+        }
+
+        // A reply to a request sent more than once may answer any of the sends, so it is no sample;
+        // instead the peer keeps the longer timeout that got it through until a clean sample arrives
+        if (request.peer != NodeID()) {
+            uint64_t now = utils::getMonotonicTimeMillis();
+            if (request.attempts == 1) {
+                rtt_.addSample(request.peer, now - request.sentMs);
+            } else {
+                rtt_.backoff(request.peer, 1u << std::min<size_t>(request.attempts - 1, 31));
+            }
+        }
+
+        callback = takePending(it);
+    }
+
+    if (callback) {
+        callback(true, response);
+    }
+
+    return true;
+}
+
+bool RPCClient::isPending(uint32_t transactionID) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_.find(transactionID) != pending_.end();
+}
+
+bool RPCClient::cancel(uint32_t transactionID) {
+    RPCResponseCallback callback;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = pending_.find(transactionID);
+        if (it == pending_.end()) {
+            return false;
+        }
+
+        callback = takePending(it);
+    }
+
+    if (callback) {
+        callback(false, MessageView());
+    }
+
+    return true;
+}
+
+size_t RPCClient::expire() {
+    std::vector<RPCResponseCallback> expired;
+    std::vector<RPCRetransmitFunction> retries;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        uint64_t now = utils::getMonotonicTimeMillis();
+
+        // Timers are ordered by deadline, so stop at the first one still in the future
+        while (!timers_.empty() && timers_.begin()->first <= now) {
+            auto it = pending_.find(timers_.begin()->second);
+            if (it == pending_.end()) {
+                timers_.erase(timers_.begin());
+                continue;
+            }
+
+            PendingRequest& request = it->second;
+            if (!request.retransmit || request.attempts > maxRetries_) {
+                expired.push_back(takePending(it));
+                continue;
+            }
+
+            // Send again and wait twice as long as the attempt before
+            request.attempts++;
+            request.timeoutMs = std::min(request.timeoutMs * 2, std::max(maxTimeoutMs_, request.timeoutMs));
+            timers_.erase(request.timer);
+            request.timer = timers_.emplace(now + request.timeoutMs, it->first);
+            retries.push_back(request.retransmit);
+        }
+    }
+
+    // A retry that cannot be sent waits out its deadline like a lost one
+    retransmits_.fetch_add(retries.size(), std::memory_order_relaxed);
+    for (const auto& retransmit : retries) {
+        retransmit();
+    }
+
+    for (const auto& callback : expired) {
+        if (callback) {
+            callback(false, MessageView());
+        }
+    }
+
+    return expired.size();
+}
+
+void RPCClient::cancelAll() {
+    std::vector<RPCResponseCallback> cancelled;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        for (auto& entry : pending_) {
+            cancelled.push_back(std::move(entry.second.callback));
+        }
+
+        pending_.clear();
+        timers_.clear();
+    }
+
+    for (const auto& callback : cancelled) {
+        if (callback) {
+            callback(false, MessageView());
+        }
+    }
+}
+
+size_t RPCClient::pendingCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_.size();
+}
+
+std::chrono::milliseconds RPCClient::getDefaultTimeout() const {
+    return defaultTimeout_;
+}
+
+std::chrono::milliseconds RPCClient::getTimeout(const NodeID& peer) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::chrono::milliseconds(rtt_.getTimeout(peer));
+}
+
+uint64_t RPCClient::getSmoothedRTT(const NodeID& peer) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rtt_.getSmoothedRTT(peer);
+}
+
+uint64_t RPCClient::getNextDeadline() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return timers_.empty() ? 0 : timers_.begin()->first;
+}
+
+uint64_t RPCClient::getRetransmitCount() const {
+    return retransmits_.load(std::memory_order_relaxed);
+}
+
+RPCResponseCallback RPCClient::takePending(std::unordered_map<uint32_t, PendingRequest>::iterator it) {
+    RPCResponseCallback callback = std::move(it->second.callback);
+    timers_.erase(it->second.timer);
+    pending_.erase(it);
+    return callback;
+}
+
+} // namespace kademlia
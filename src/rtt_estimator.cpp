@@ -0,0 +1,75 @@
+#include "../include/rtt_estimator.h"
+#include <algorithm>
+#include <cmath>
+
+namespace kademlia {
+
+RTTEstimator::RTTEstimator(uint64_t initialTimeoutMs, uint64_t minTimeoutMs, uint64_t maxTimeoutMs)
+    : initialTimeoutMs_(initialTimeoutMs), minTimeoutMs_(std::max<uint64_t>(minTimeoutMs, 1)),
+      maxTimeoutMs_(std::max(maxTimeoutMs, std::max<uint64_t>(minTimeoutMs, 1))) {}
+
+void RTTEstimator::addSample(const NodeID& peer, uint64_t rttMs) {
+    Entry& e = entry(peer);
+    double sample = static_cast<double>(rttMs);
+
+    if (e.srtt == 0) {
+        // The first sample sets the estimate and half of it as the deviation
+        e.srtt = std::max(sample, 1.0);
+        e.rttvar = sample / 2;
+    } else {
+        // Gains of 1/4 for the deviation and 1/8 for the mean, as in TCP
+        e.rttvar = 0.75 * e.rttvar + 0.25 * std::fabs(e.srtt - sample);
+        e.srtt = std::max(0.875 * e.srtt + 0.125 * sample, 1.0);
+    }
+
+    e.backoff = 1;
+}
+
+void RTTEstimator::backoff(const NodeID& peer, uint32_t factor) {
+    Entry& e = entry(peer);
+    e.backoff = static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(e.backoff) * factor, MAX_RTT_BACKOFF));
+}
+
+uint64_t RTTEstimator::getTimeout(const NodeID& peer) const {
+    auto it = entries_.find(peer);
+    if (it == entries_.end()) {
+        return std::min(initialTimeoutMs_, maxTimeoutMs_);
+    }
+
+    const Entry& e = it->second;
+    uint64_t timeout = e.srtt == 0 ? initialTimeoutMs_
+                     : std::max(static_cast<uint64_t>(std::ceil(e.srtt + 4 * e.rttvar)), minTimeoutMs_);
+
+    return std::min(timeout * e.backoff, maxTimeoutMs_);
+}
+
+uint64_t RTTEstimator::getSmoothedRTT(const NodeID& peer) const {
+    auto it = entries_.find(peer);
+    return it == entries_.end() ? 0 : static_cast<uint64_t>(std::ceil(it->second.srtt));
+}
+
+size_t RTTEstimator::size() const {
+    return entries_.size();
+}
+
+RTTEstimator::Entry& RTTEstimator::entry(const NodeID& peer) {
+    auto it = entries_.find(peer);
+
+    if (it != entries_.end()) {
+        order_.splice(order_.begin(), order_, it->second.position);
+        return it->second;
+    }
+
+    // A full table forgets the peer it heard from least recently
+    if (entries_.size() >= MAX_RTT_PEERS) {
+        entries_.erase(order_.back());
+        order_.pop_back();
+    }
+
+    order_.push_front(peer);
+    it = entries_.emplace(peer, Entry()).first;
+    it->second.position = order_.begin();
+    return it->second;
+}
+
+} // namespace kademlia
@@ -0,0 +1,447 @@
+#include "../include/storage.h"
+#include "../include/utils.h"
+#include <algorithm>
+
+namespace kademlia {
+
+Storage::~Storage() {
+    close();
+}
+
+bool Storage::open(const std::string& directory, const ValueLogOptions& options, uint64_t now) {
+    if (log_) {
+        return false;
+    }
+
+    // Rebuild the shards from the records in the log, oldest first
+    std::unordered_map<KeyHash, uint64_t> shadows;
+    log_ = std::make_unique<ValueLog>(options);
+    bool opened = log_->open(directory, [this, now, &shadows](LogRecordType type, const KeyHash& key,
+                                                             const LogRecordMeta& meta, const ValueLocation& location) {
+        recover(type, key, meta, location, now, shadows);
+    }, [this](size_t records) {
+        // Overwritten records are counted too, so this may reserve more than the keys need, never less
+        for (Shard& shard : shards_) {
+            shard.records.reserve(records / STORAGE_SHARDS + 1);
+        }
+    });
+    if (!opened) {
+        log_.reset();
+        clearShards();
+        return false;
+    }
+
+    // The expired records that stood in for tombstones may be compacted away from now on
+    for (const auto& shadow : shadows) {
+        appendTombstone(shadow.first, shadow.second);
+    }
+
+    compacting_ = true;
+    compactionThread_ = std::thread(&Storage::runCompaction, this);
+    return true;
+}
+
+void Storage::close() {
+    if (!log_) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(compactionMutex_);
+        compacting_ = false;
+    }
+    compactionWake_.notify_all();
+    if (compactionThread_.joinable()) {
+        compactionThread_.join();
+    }
+
+    log_->close();
+    log_.reset();
+    clearShards();
+}
+
+bool Storage::isPersistent() const {
+    return log_ != nullptr;
+}
+
+bool Storage::put(const KeyHash& key, ByteSpan value, uint64_t ttlMs, const NodeID& publisher, uint64_t now,
+                  bool cached) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto result = shard.records.try_emplace(key);
+    StoredValue& record = result.first->second;
+
+    // The records the key had so far stay in the log until compacted
+    uint64_t shadowedMs = result.second ? 0 : std::max(record.shadowedMs, record.expiresMs);
+
+    // A record that expired but was not removed yet starts over as a new key
+    bool fresh = result.second || now >= record.expiresMs;
+    if (fresh) {
+        record.expiresMs = 0;
+    }
+
+    // A cached copy leaves a replica alone: the replica has the value, its deadline and its republish time
+    if (cached && !fresh && !record.cached) {
+        return false;
+    }
+
+    record.publisher = publisher;
+    record.storedMs = now;
+    record.ttlMs = ttlMs;
+    record.cached = cached;
+
+    // A replica takes the lifetime it was sent, which a republishing replica sets to what the publisher
+    // left, so every copy expires at the publisher's deadline. A short-lived cached copy never shortens
+    // the lifetime of a longer-lived one.
+    record.expiresMs = cached ? std::max(record.expiresMs, now + ttlMs) : now + ttlMs;
+    record.shadowedMs = shadowedMs > record.expiresMs ? shadowedMs : 0;
+
+    // A persistent store keeps the value only in the log, unless it cannot be appended there
+    ValueLocation location;
+    LogRecordMeta meta{publisher, now, ttlMs, record.expiresMs, cached};
+    if (log_ && log_->append(LogRecordType::PUT, key, meta, value, location)) {
+        std::vector<uint8_t>().swap(record.value);
+    } else {
+        record.value.assign(value.begin(), value.end());
+    }
+    if (log_) {
+        log_->release(record.location);
+    }
+    record.location = location;
+
+    // A new key gets a heap entry. An existing one keeps its entry, which is moved when it comes due,
+    // unless its deadline moved before the entry; the entry left behind is dropped when it comes due.
+    if (result.second || record.expiresMs < record.scheduledMs) {
+        record.scheduledMs = record.expiresMs;
+        shard.deadlines.emplace(record.scheduledMs, key);
+    }
+
+    return fresh;
+}
+
+bool Storage::get(const KeyHash& key, std::vector<uint8_t>& value, uint64_t now) const {
+    const Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.records.find(key);
+    if (it == shard.records.end() || now >= it->second.expiresMs) {
+        return false;
+    }
+
+    return readValue(it->second, value);
+}
+
+bool Storage::getRecord(const KeyHash& key, StoredValue& record, uint64_t now) const {
+    const Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.records.find(key);
+    if (it == shard.records.end() || now >= it->second.expiresMs) {
+        return false;
+    }
+
+    record = it->second;
+    return readValue(it->second, record.value);
+}
+
+bool Storage::contains(const KeyHash& key, uint64_t now) const {
+    const Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.records.find(key);
+    return it != shard.records.end() && now < it->second.expiresMs;
+}
+
+bool Storage::touch(const KeyHash& key, uint64_t now) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.records.find(key);
+    if (it == shard.records.end()) {
+        return false;
+    }
+    it->second.storedMs = now;
+    return true;
+}
+
+bool Storage::erase(const KeyHash& key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.records.find(key);
+    if (it == shard.records.end()) {
+        return false;
+    }
+
+    // The tombstone keeps the key's earlier records from coming back on the next open. It is needed
+    // only until the last of them would have expired.
+    if (log_) {
+        appendTombstone(key, std::max(it->second.expiresMs, it->second.shadowedMs));
+        log_->release(it->second.location);
+    }
+
+    shard.records.erase(it);
+    return true;
+}
+
+size_t Storage::expire(uint64_t now, size_t limit) {
+    size_t removed = 0;
+
+    // Visit the shards in turn, taking at most one batch from each per lock hold, until nothing is due
+    bool pending = true;
+    while (pending && removed < limit) {
+        pending = false;
+
+        for (Shard& shard : shards_) {
+            size_t batch = std::min(STORAGE_EXPIRE_BATCH, limit - removed);
+            if (batch == 0) {
+                break;
+            }
+
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (expireShard(shard, now, batch, removed)) {
+                pending = true;
+            }
+        }
+    }
+
+    return removed;
+}
+
+uint64_t Storage::getNextExpiry() const {
+    uint64_t next = UINT64_MAX;
+    for (const Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (!shard.deadlines.empty()) {
+            next = std::min(next, shard.deadlines.top().first);
+        }
+    }
+    return next;
+}
+
+bool Storage::compact(uint64_t now) {
+    uint32_t segment = 0;
+    if (!log_ || !log_->findCompactionCandidate(segment)) {
+        return false;
+    }
+
+    std::vector<uint8_t> value;
+    bool failed = false;
+    bool visited = log_->forEachRecord(segment, [&](LogRecordType type, const KeyHash& key,
+                                                    const LogRecordMeta& meta, const ValueLocation& location) {
+        if (failed) {
+            return;
+        }
+
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.records.find(key);
+
+        if (type == LogRecordType::ERASE) {
+            // A tombstone goes once the records it hides have expired. Moving it past a record that stored
+            // the key again would erase that record on the next open, so the record takes over its duty.
+            if (now >= meta.expiresMs) {
+                return;
+            }
+            if (it != shard.records.end()) {
+                it->second.shadowedMs = std::max(it->second.shadowedMs, meta.expiresMs);
+                return;
+            }
+            ValueLocation moved;
+            if (!log_->append(LogRecordType::ERASE, key, meta, ByteSpan(), moved)) {
+                failed = true;
+            }
+            return;
+        }
+
+        // Only the key's current record is kept, with the key's current metadata
+        if (it == shard.records.end() || !(it->second.location == location) || now >= it->second.expiresMs) {
+            return;
+        }
+        StoredValue& record = it->second;
+
+        // A record that fails its checksum cannot be kept; the key is dropped rather than keep the segment
+        if (!log_->read(location, value)) {
+            shard.records.erase(it);
+            return;
+        }
+
+        ValueLocation moved;
+        if (!log_->append(LogRecordType::PUT, key, {record.publisher, record.storedMs, record.ttlMs, record.expiresMs,
+                                                       record.cached},
+                          value, moved)) {
+            failed = true;
+            return;
+        }
+
+        // Counted as dead, so a segment kept below is picked again and dropped once nothing in it is current
+        log_->release(location);
+        record.location = moved;
+    });
+
+    // The segment stays if any of its current records could not be moved, or the copies may not be durable:
+    // until they are, it holds the only copy that would survive a crash
+    if (!visited || failed || !log_->sync()) {
+        return false;
+    }
+    log_->dropSegment(segment);
+    return true;
+}
+
+bool Storage::sync() {
+    return !log_ || log_->sync();
+}
+
+ValueLogStats Storage::getLogStats() const {
+    return log_ ? log_->getStats() : ValueLogStats();
+}
+
+size_t Storage::size() const {
+    size_t total = 0;
+    for (const Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.records.size();
+    }
+    return total;
+}
+
+bool Storage::expireShard(Shard& shard, uint64_t now, size_t limit, size_t& removed) {
+    for (size_t popped = 0; popped < limit; ++popped) {
+        if (shard.deadlines.empty() || shard.deadlines.top().first > now) {
+            return false;
+        }
+
+        Deadline deadline = shard.deadlines.top();
+        shard.deadlines.pop();
+
+        // An entry left behind by an erased key, or by a key erased and stored again, is dropped
+        auto it = shard.records.find(deadline.second);
+        if (it == shard.records.end() || it->second.scheduledMs != deadline.first) {
+            continue;
+        }
+
+        StoredValue& record = it->second;
+        if (now >= record.expiresMs) {
+            if (log_) {
+                // Expiry leaves no record of its own; compaction may drop this one before the earlier ones
+                if (record.shadowedMs > now) {
+                    appendTombstone(deadline.second, record.shadowedMs);
+                }
+                log_->release(record.location);
+            }
+            shard.records.erase(it);
+            removed++;
+        } else {
+            // Stored again since the entry was pushed: move it to the current expiry
+            record.scheduledMs = record.expiresMs;
+            shard.deadlines.emplace(record.scheduledMs, deadline.second);
+        }
+    }
+
+    // The batch ran out; more entries may be due
+    return true;
+}
+
+void Storage::recover(LogRecordType type, const KeyHash& key, const LogRecordMeta& meta,
+                      const ValueLocation& location, uint64_t now, std::unordered_map<KeyHash, uint64_t>& shadows) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    // An erase, or a value that has expired since, removes whatever earlier records stored for the key
+    if (type == LogRecordType::ERASE || now >= meta.expiresMs) {
+        auto it = shard.records.find(key);
+        if (it != shard.records.end()) {
+            // Only the expired record keeps the earlier ones hidden, and it has no tombstone to outlast them
+            uint64_t shadowedMs = std::max(it->second.expiresMs, it->second.shadowedMs);
+            if (type == LogRecordType::PUT && shadowedMs > now) {
+                uint64_t& until = shadows[key];
+                until = std::max(until, shadowedMs);
+            }
+            log_->release(it->second.location);
+            shard.records.erase(it);
+        }
+
+        // A tombstone stays live while the value it erased could still come back
+        if (type == LogRecordType::PUT || now >= meta.expiresMs) {
+            log_->release(location);
+        }
+        return;
+    }
+
+    auto result = shard.records.try_emplace(key);
+    StoredValue& record = result.first->second;
+    log_->release(record.location);
+
+    // The record replaced, and any the key had before it expired, stay in the log
+    uint64_t shadowedMs = result.second ? 0 : std::max(record.shadowedMs, record.expiresMs);
+    auto shadow = shadows.find(key);
+    if (shadow != shadows.end()) {
+        shadowedMs = std::max(shadowedMs, shadow->second);
+        shadows.erase(shadow);
+    }
+
+    record.publisher = meta.publisher;
+    record.storedMs = meta.storedMs;
+    record.ttlMs = meta.ttlMs;
+    record.expiresMs = meta.expiresMs;
+    record.cached = meta.cached;
+    record.shadowedMs = shadowedMs > record.expiresMs ? shadowedMs : 0;
+    record.location = location;
+
+    // A key seen before keeps its heap entry unless the entry is now too late
+    if (result.second || record.expiresMs < record.scheduledMs) {
+        record.scheduledMs = record.expiresMs;
+        shard.deadlines.emplace(record.scheduledMs, key);
+    }
+}
+
+void Storage::appendTombstone(const KeyHash& key, uint64_t untilMs) {
+    LogRecordMeta meta;
+    meta.expiresMs = untilMs;
+    ValueLocation location;
+    log_->append(LogRecordType::ERASE, key, meta, ByteSpan(), location);
+}
+
+bool Storage::readValue(const StoredValue& record, std::vector<uint8_t>& value) const {
+    if (record.location.length == 0) {
+        value = record.value;
+        return true;
+    }
+    return log_->read(record.location, value);
+}
+
+void Storage::clearShards() {
+    for (Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.records.clear();
+        shard.deadlines = decltype(shard.deadlines)();
+    }
+}
+
+void Storage::runCompaction() {
+    std::unique_lock<std::mutex> lock(compactionMutex_);
+
+    while (compacting_) {
+        lock.unlock();
+        bool compacted = compact(utils::getCurrentTimeMillis());
+        lock.lock();
+
+        // Go straight on to the next segment while any is past the threshold
+        if (!compacted) {
+            compactionWake_.wait_for(lock, STORAGE_COMPACTION_INTERVAL, [this]() {
+                return !compacting_;
+            });
+        }
+    }
+}
+
+Storage::Shard& Storage::shardFor(const KeyHash& key) {
+    return shards_[key.getWord(1) % STORAGE_SHARDS];
+}
+
+const Storage::Shard& Storage::shardFor(const KeyHash& key) const {
+    return shards_[key.getWord(1) % STORAGE_SHARDS];
+}
+
+} // namespace kademlia
@@ -0,0 +1,589 @@
+#include "../include/transport.h"
+#include "../include/io_uring_loop.h"
+#include <cstring>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <cerrno>
+#include <algorithm>
+#include <optional>
+
+namespace kademlia {
+
+namespace {
+
+// Innermost send batch opened on this thread
+thread_local SendBatch* activeBatch = nullptr;
+
+// Transport and socket owned by this thread if it is an event loop thread
+thread_local const UDPTransport* loopTransport = nullptr;
+thread_local int loopSocket = -1;
+
+// Ring owned by this thread if it is an io_uring event loop thread
+thread_local IOUringLoop* loopRing = nullptr;
+
+// Batches drained per wakeup before ticking, so a flood cannot starve timers
+constexpr int BATCHES_PER_WAKEUP = 8;
+
+// Requested socket receive buffer, enough for a few windows of fragments in flight
+constexpr size_t SOCKET_RECEIVE_BUFFER = 4 * 1024 * 1024;
+
+// Convert a source address to text
+void fillSource(const struct sockaddr_in& address, std::string& ip, uint16_t& port) {
+    char ipBuffer[INET_ADDRSTRLEN];
+    if (inet_ntop(AF_INET, &address.sin_addr, ipBuffer, sizeof(ipBuffer)) != nullptr) {
+        ip = ipBuffer;
+    }
+    port = ntohs(address.sin_port);
+}
+
+} // namespace
+
+// ReceiveBatch implementation
+ReceiveBatch::ReceiveBatch(size_t maxDatagrams, size_t datagramCapacity)
+    : datagramCapacity_(datagramCapacity), count_(0), pool_(datagramCapacity, maxDatagrams) {
+    if (maxDatagrams == 0) {
+        maxDatagrams = 1;
+    }
+    
+    buffers_.resize(maxDatagrams);
+    datagrams_.resize(maxDatagrams);
+    headers_.resize(maxDatagrams);
+    iovecs_.resize(maxDatagrams);
+    addresses_.resize(maxDatagrams);
+    
+    // Point each message header at its own buffer and source address
+    for (size_t i = 0; i < maxDatagrams; ++i) {
+        buffers_[i] = pool_.acquire();
+        iovecs_[i].iov_base = buffers_[i].data();
+        iovecs_[i].iov_len = datagramCapacity;
+        
+        memset(&headers_[i], 0, sizeof(headers_[i]));
+        headers_[i].msg_hdr.msg_iov = &iovecs_[i];
+        headers_[i].msg_hdr.msg_iovlen = 1;
+        headers_[i].msg_hdr.msg_name = &addresses_[i];
+        
+        datagrams_[i].data = buffers_[i].data();
+        datagrams_[i].buffer = &buffers_[i];
+    }
+}
+
+void ReceiveBatch::replaceRetainedBuffers() {
+    // Only slots filled by the last call can have been retained
+    for (size_t i = 0; i < count_; ++i) {
+        if (buffers_[i].useCount() > 1) {
+            buffers_[i] = pool_.acquire();
+            iovecs_[i].iov_base = buffers_[i].data();
+            datagrams_[i].data = buffers_[i].data();
+        }
+    }
+}
+
+size_t ReceiveBatch::size() const {
+    return count_;
+}
+
+size_t ReceiveBatch::capacity() const {
+    return datagrams_.size();
+}
+
+const Datagram& ReceiveBatch::operator[](size_t index) const {
+    return datagrams_[index];
+}
+
+// SendBuffers implementation
+size_t SendBuffers::size() const {
+    return offsets.size();
+}
+
+void SendBuffers::prepare() {
+    size_t count = offsets.size();
+    headers.resize(count);
+    iovecs.resize(count);
+    
+    for (size_t i = 0; i < count; ++i) {
+        size_t end = i + 1 < count ? offsets[i + 1] : data.size();
+        iovecs[i].iov_base = data.data() + offsets[i];
+        iovecs[i].iov_len = end - offsets[i];
+        
+        memset(&headers[i], 0, sizeof(headers[i]));
+        headers[i].msg_hdr.msg_iov = &iovecs[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+        headers[i].msg_hdr.msg_name = &destinations[i];
+        headers[i].msg_hdr.msg_namelen = sizeof(destinations[i]);
+    }
+}
+
+void SendBuffers::clear() {
+    data.clear();
+    offsets.clear();
+    destinations.clear();
+}
+
+// SendBatch implementation
+SendBatch::SendBatch(UDPTransport& transport, size_t maxDatagrams)
+    : transport_(transport), previous_(activeBatch), maxDatagrams_(maxDatagrams > 0 ? maxDatagrams : 1) {
+    buffers_.offsets.reserve(maxDatagrams_);
+    buffers_.destinations.reserve(maxDatagrams_);
+    activeBatch = this;
+}
+
+SendBatch::~SendBatch() {
+    flush();
+    activeBatch = previous_;
+}
+
+bool SendBatch::add(const struct sockaddr_in& destination, const uint8_t* data, size_t length) {
+    if (buffers_.size() >= maxDatagrams_) {
+        flush();
+    }
+    
+    // Copy the datagram; callers reuse their encode buffers
+    buffers_.offsets.push_back(buffers_.data.size());
+    buffers_.destinations.push_back(destination);
+    buffers_.data.insert(buffers_.data.end(), data, data + length);
+    return true;
+}
+
+size_t SendBatch::flush() {
+    size_t count = buffers_.size();
+    if (count == 0) {
+        return 0;
+    }
+    
+    buffers_.prepare();
+    
+    // On an io_uring loop thread the ring takes the buffers and sends them with its next submission
+    if (loopRing != nullptr && loopTransport == &transport_) {
+        loopRing->submitSends(std::move(buffers_));
+        buffers_ = loopRing->takeSpareBuffers();
+        return count;
+    }
+    
+    size_t sent = 0;
+    size_t next = 0;
+    
+    int sockfd = transport_.socketForThread();
+    
+    while (next < count && sockfd >= 0) {
+        int result = sendmmsg(sockfd, buffers_.headers.data() + next, static_cast<unsigned int>(count - next), 0);
+        transport_.counters_.syscalls.fetch_add(1, std::memory_order_relaxed);
+        
+        if (result > 0) {
+            sent += static_cast<size_t>(result);
+            next += static_cast<size_t>(result);
+        } else if (result < 0 && errno == EINTR) {
+            continue;
+        } else {
+            // Drop the datagram that failed, as a failed sendto would, and keep going
+            next++;
+        }
+    }
+    
+    transport_.counters_.datagramsSent.fetch_add(sent, std::memory_order_relaxed);
+    buffers_.clear();
+    return sent;
+}
+
+// Transport implementation
+bool Transport::send(const std::string& ip, uint16_t port, const uint8_t* data, size_t length) {
+    struct in_addr address;
+    if (inet_pton(AF_INET, ip.c_str(), &address) != 1) {
+        return false;
+    }
+    return send(static_cast<uint32_t>(address.s_addr), port, data, length);
+}
+
+// UDPTransport implementation
+UDPTransport::UDPTransport(size_t sockets, IOBackend backend, size_t batchSize)
+    : startSockets_(std::max<size_t>(sockets, 1)), startBackend_(backend), startBatchSize_(batchSize),
+      port_(0), wakeFd_(-1), backend_(IOBackend::EPOLL), looping_(false) {}
+
+UDPTransport::~UDPTransport() {
+    close();
+}
+
+bool UDPTransport::start(uint16_t port, ReceiveHandler onReceive, TickHandler onTick) {
+    if (!open(port, startSockets_)) {
+        return false;
+    }
+
+    if (!startLoop(startBackend_, startBatchSize_, std::move(onReceive), std::move(onTick))) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void UDPTransport::stop() {
+    close();
+}
+
+bool UDPTransport::open(uint16_t port, size_t sockets) {
+    if (!sockfds_.empty() || sockets == 0) {
+        return false;
+    }
+
+    for (size_t i = 0; i < sockets; ++i) {
+        // Create the socket
+        int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sockfd < 0) {
+            close();
+            return false;
+        }
+
+        // Set socket to non-blocking
+        int flags = fcntl(sockfd, F_GETFL, 0);
+        fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
+
+        // Room for bursts of fragments of large messages; the kernel caps this at net.core.rmem_max
+        int receiveBuffer = static_cast<int>(SOCKET_RECEIVE_BUFFER);
+        setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+
+        // Let the kernel spread datagrams across sockets sharing the port
+        if (sockets > 1) {
+            #ifdef SO_REUSEPORT
+            int optval = 1;
+            setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval));
+            #endif
+        }
+
+        // Bind to the local port; later sockets join the port the first one got
+        struct sockaddr_in localAddr;
+        memset(&localAddr, 0, sizeof(localAddr));
+        localAddr.sin_family = AF_INET;
+        localAddr.sin_addr.s_addr = INADDR_ANY;
+        localAddr.sin_port = htons(port);
+
+        if (bind(sockfd, (struct sockaddr*)&localAddr, sizeof(localAddr)) < 0) {
+            ::close(sockfd);
+            close();
+            return false;
+        }
+
+        // Read back the port in case the OS chose one
+        socklen_t addrLen = sizeof(localAddr);
+        if (getsockname(sockfd, (struct sockaddr*)&localAddr, &addrLen) == 0) {
+            port = ntohs(localAddr.sin_port);
+        }
+
+        sockfds_.push_back(sockfd);
+    }
+
+    port_ = port;
+    return true;
+}
+
+void UDPTransport::close() {
+    stopLoop();
+
+    for (int sockfd : sockfds_) {
+        ::close(sockfd);
+    }
+    sockfds_.clear();
+}
+
+bool UDPTransport::isOpen() const {
+    return !sockfds_.empty();
+}
+
+uint16_t UDPTransport::getPort() const {
+    return port_;
+}
+
+size_t UDPTransport::getSocketCount() const {
+    return sockfds_.size();
+}
+
+int UDPTransport::socketForThread() const {
+    if (loopTransport == this) {
+        return loopSocket;
+    }
+    return sockfds_.empty() ? -1 : sockfds_[0];
+}
+
+bool UDPTransport::send(uint32_t ip, uint16_t port, const uint8_t* data, size_t length) {
+    if (sockfds_.empty()) {
+        return false;
+    }
+
+    // Set up the destination address
+    struct sockaddr_in destAddr;
+    memset(&destAddr, 0, sizeof(destAddr));
+    destAddr.sin_family = AF_INET;
+    destAddr.sin_addr.s_addr = ip;
+    destAddr.sin_port = htons(port);
+
+    // Queue into the innermost batch for this transport, if one is open on this thread
+    for (SendBatch* batch = activeBatch; batch != nullptr; batch = batch->previous_) {
+        if (&batch->transport_ == this) {
+            return batch->add(destAddr, data, length);
+        }
+    }
+
+    return sendTo(destAddr, data, length);
+}
+
+bool UDPTransport::sendTo(const struct sockaddr_in& destination, const uint8_t* data, size_t length) {
+    ssize_t bytesSent = sendto(socketForThread(), data, length, 0,
+                              (const struct sockaddr*)&destination, sizeof(destination));
+    counters_.syscalls.fetch_add(1, std::memory_order_relaxed);
+
+    if (bytesSent <= 0) {
+        return false;
+    }
+
+    counters_.datagramsSent.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+ssize_t UDPTransport::receive(uint8_t* buffer, size_t capacity, std::string& fromIP, uint16_t& fromPort, int timeoutMs) {
+    if (sockfds_.empty()) {
+        return -1;
+    }
+
+    int sockfd = sockfds_[0];
+
+    // Wait for a datagram
+    struct pollfd pfd;
+    pfd.fd = sockfd;
+    pfd.events = POLLIN;
+
+    counters_.syscalls.fetch_add(1, std::memory_order_relaxed);
+    if (poll(&pfd, 1, timeoutMs) <= 0) {
+        return 0;
+    }
+
+    struct sockaddr_in fromAddr;
+    socklen_t fromLen = sizeof(fromAddr);
+
+    ssize_t bytesRead = recvfrom(sockfd, buffer, capacity, 0,
+                                (struct sockaddr*)&fromAddr, &fromLen);
+    counters_.syscalls.fetch_add(1, std::memory_order_relaxed);
+
+    if (bytesRead > 0) {
+        fillSource(fromAddr, fromIP, fromPort);
+        counters_.datagramsReceived.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return bytesRead;
+}
+
+size_t UDPTransport::receiveBatch(ReceiveBatch& batch, int timeoutMs) {
+    if (sockfds_.empty()) {
+        batch.count_ = 0;
+        return 0;
+    }
+
+    return receiveFrom(sockfds_[0], batch, timeoutMs);
+}
+
+size_t UDPTransport::receiveFrom(int sockfd, ReceiveBatch& batch, int timeoutMs) {
+    batch.replaceRetainedBuffers();
+    batch.count_ = 0;
+
+    size_t capacity = batch.capacity();
+    auto drain = [&]() {
+        for (size_t i = 0; i < capacity; ++i) {
+            batch.headers_[i].msg_hdr.msg_namelen = sizeof(batch.addresses_[i]);
+            batch.headers_[i].msg_hdr.msg_flags = 0;
+        }
+        counters_.syscalls.fetch_add(1, std::memory_order_relaxed);
+        return recvmmsg(sockfd, batch.headers_.data(), static_cast<unsigned int>(capacity), MSG_DONTWAIT, nullptr);
+    };
+
+    // Under load datagrams are already queued, so try before paying for a poll
+    int count = drain();
+    if (count <= 0) {
+        struct pollfd pfd;
+        pfd.fd = sockfd;
+        pfd.events = POLLIN;
+
+        if (timeoutMs == 0) {
+            return 0;
+        }
+
+        counters_.syscalls.fetch_add(1, std::memory_order_relaxed);
+        if (poll(&pfd, 1, timeoutMs) <= 0) {
+            return 0;
+        }
+
+        count = drain();
+        if (count <= 0) {
+            return 0;
+        }
+    }
+
+    for (size_t i = 0; i < static_cast<size_t>(count); ++i) {
+        Datagram& datagram = batch.datagrams_[i];
+        datagram.length = batch.headers_[i].msg_len;
+        datagram.fromIP = batch.addresses_[i].sin_addr.s_addr;
+        datagram.fromPort = ntohs(batch.addresses_[i].sin_port);
+    }
+
+    batch.count_ = static_cast<size_t>(count);
+    counters_.datagramsReceived.fetch_add(batch.count_, std::memory_order_relaxed);
+    return batch.count_;
+}
+
+bool UDPTransport::startLoop(IOBackend backend, size_t batchSize, ReceiveHandler onReceive, TickHandler onTick,
+                             int tickMs) {
+    if (sockfds_.empty() || !loopThreads_.empty()) {
+        return false;
+    }
+
+    // Fall back to epoll when io_uring or the features the loop needs are missing
+    backend_ = backend == IOBackend::IO_URING && IOUringLoop::isSupported() ? IOBackend::IO_URING : IOBackend::EPOLL;
+
+    // Stopping the loop signals this descriptor to wake every thread
+    wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd_ < 0) {
+        return false;
+    }
+
+    onReceive_ = std::move(onReceive);
+    onTick_ = std::move(onTick);
+    looping_ = true;
+
+    for (int sockfd : sockfds_) {
+        auto body = backend_ == IOBackend::IO_URING ? &UDPTransport::runURingLoop : &UDPTransport::runLoop;
+        loopThreads_.emplace_back(body, this, sockfd, std::max<size_t>(batchSize, 1), tickMs);
+    }
+
+    return true;
+}
+
+void UDPTransport::stopLoop() {
+    if (loopThreads_.empty()) {
+        return;
+    }
+
+    looping_ = false;
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd_, &one, sizeof(one));
+    (void)written;
+
+    for (auto& thread : loopThreads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    loopThreads_.clear();
+
+    ::close(wakeFd_);
+    wakeFd_ = -1;
+}
+
+void UDPTransport::runLoop(int sockfd, size_t batchSize, int tickMs) {
+    // Sends from this thread leave from its own socket
+    loopTransport = this;
+    loopSocket = sockfd;
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        return;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = sockfd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, sockfd, &event);
+    event.data.fd = wakeFd_;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, wakeFd_, &event);
+
+    ReceiveBatch batch(batchSize);
+
+    // Replies and requests sent from this thread are queued and flushed together once per wakeup
+    std::optional<SendBatch> sends;
+    if (batchSize > 1) {
+        sends.emplace(*this, batchSize);
+    }
+
+    struct epoll_event events[2];
+
+    while (looping_) {
+        int ready = epoll_wait(epfd, events, 2, tickMs);
+        counters_.syscalls.fetch_add(1, std::memory_order_relaxed);
+
+        if (ready > 0) {
+            for (int round = 0; round < BATCHES_PER_WAKEUP; ++round) {
+                size_t count = receiveFrom(sockfd, batch, 0);
+
+                for (size_t i = 0; i < count; ++i) {
+                    onReceive_(batch[i]);
+                }
+
+                if (count < batch.capacity()) {
+                    break;
+                }
+            }
+        }
+
+        if (onTick_) {
+            onTick_();
+        }
+
+        if (sends) {
+            sends->flush();
+        }
+    }
+
+    sends.reset();
+    ::close(epfd);
+    loopTransport = nullptr;
+    loopSocket = -1;
+}
+
+void UDPTransport::runURingLoop(int sockfd, size_t batchSize, int tickMs) {
+    IOUringLoop ring;
+
+    // Keep a few batches of provided buffers so receives continue while handlers run
+    if (!ring.init(sockfd, wakeFd_, batchSize * 2, 65536, &counters_)) {
+        runLoop(sockfd, batchSize, tickMs);
+        return;
+    }
+
+    // Sends from this thread leave from its own socket, through the ring
+    loopTransport = this;
+    loopSocket = sockfd;
+    loopRing = &ring;
+
+    std::optional<SendBatch> sends;
+    sends.emplace(*this, batchSize);
+
+    while (looping_) {
+        ring.poll(tickMs, onReceive_);
+
+        if (onTick_) {
+            onTick_();
+        }
+
+        sends->flush();
+    }
+
+    sends.reset();
+    loopRing = nullptr;
+    loopTransport = nullptr;
+    loopSocket = -1;
+}
+
+IOBackend UDPTransport::getBackend() const {
+    return backend_;
+}
+
+TransportStats UDPTransport::getStats() const {
+    TransportStats stats;
+    stats.syscalls = counters_.syscalls.load(std::memory_order_relaxed);
+    stats.datagramsReceived = counters_.datagramsReceived.load(std::memory_order_relaxed);
+    stats.datagramsSent = counters_.datagramsSent.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // namespace kademlia
@@ -37,39 +37,72 @@ std::string bytesToHex(const std::vector<uint8_t>& bytes) {
     return ss.str();
 }
 
+namespace {
+
+// Replacement clock installed by setTimeSource, if any
+TimeSource timeSource;
+
+} // namespace
+
+void setTimeSource(TimeSource source) {
+    timeSource = std::move(source);
+}
+
 uint64_t getCurrentTimeMillis() {
+    if (timeSource) {
+        return timeSource();
+    }
+    
     auto now = std::chrono::system_clock::now();
     auto duration = now.time_since_epoch();
     return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
 }
 
+uint64_t getMonotonicTimeMillis() {
+    if (timeSource) {
+        return timeSource();
+    }
+    
+    auto duration = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+}
+
+std::mt19937_64& randomEngine() {
+    thread_local std::mt19937_64 engine(std::random_device{}());
+    return engine;
+}
+
+void seedRandom(uint64_t seed) {
+    randomEngine().seed(seed);
+}
+
 NodeID calculateDistance(const NodeID& a, const NodeID& b) {
     return a.distance(b);
 }
 
 size_t getCommonPrefixLength(const NodeID& a, const NodeID& b) {
-    size_t commonPrefixLength = 0;
-    
-    for (size_t i = 0; i < KEY_BITS; ++i) {
-        if (a.getBit(i) != b.getBit(i)) {
-            break;
-        }
-        commonPrefixLength++;
-    }
-    
-    return commonPrefixLength;
+    return a.commonPrefixLength(b);
 }
 
 std::vector<NodePtr> sortNodesByDistance(const std::vector<NodePtr>& nodes, const NodeID& targetID) {
-    std::vector<NodePtr> sortedNodes = nodes;
+    // Compute each distance once instead of twice per comparison
+    std::vector<std::pair<NodeID, size_t>> order;
+    order.reserve(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        order.emplace_back(nodes[i]->getID().distance(targetID), i);
+    }
     
-    std::sort(sortedNodes.begin(), sortedNodes.end(), 
-        [&targetID](const NodePtr& a, const NodePtr& b) {
-            NodeID distA = a->getID().distance(targetID);
-            NodeID distB = b->getID().distance(targetID);
-            return distA < distB;
+    std::sort(order.begin(), order.end(),
+        [](const std::pair<NodeID, size_t>& a, const std::pair<NodeID, size_t>& b) {
+            return a.first < b.first;
         });
     
+    std::vector<NodePtr> sortedNodes;
+    sortedNodes.reserve(nodes.size());
+    for (const auto& entry : order) {
+        sortedNodes.push_back(nodes[entry.second]);
+    }
+    
     return sortedNodes;
 }
 
@@ -81,10 +114,14 @@ bool isNodeInList(const NodePtr& node, const std::vector<NodePtr>& nodes) {
 }
 
 NodeID hashKey(const std::vector<uint8_t>& key) {
+    return hashKey(key.data(), key.size());
+}
+
+NodeID hashKey(const uint8_t* data, size_t length) {
     std::array<uint8_t, KEY_BYTES> hash;
     
     // Use SHA-1 to hash the key
-    SHA1(key.data(), key.size(), hash.data());
+    SHA1(data, length, hash.data());
     
     return NodeID(hash);
 }
@@ -107,6 +144,25 @@ bool isValidIP(const std::string& ip) {
     return inet_pton(AF_INET, ip.c_str(), &(sa.sin_addr)) != 0;
 }
 
+bool ipToBinary(const std::string& ip, uint32_t& binary) {
+    struct in_addr addr;
+    if (inet_pton(AF_INET, ip.c_str(), &addr) != 1) {
+        return false;
+    }
+    binary = addr.s_addr;
+    return true;
+}
+
+std::string binaryToIP(uint32_t binary) {
+    struct in_addr addr;
+    addr.s_addr = binary;
+    char ipBuffer[INET_ADDRSTRLEN];
+    if (inet_ntop(AF_INET, &addr, ipBuffer, sizeof(ipBuffer)) == nullptr) {
+        return std::string();
+    }
+    return ipBuffer;
+}
+
 bool isValidPort(uint16_t port) {
     // Ports 0 and 1-1023 are reserved
     return port > 1023;
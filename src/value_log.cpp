@@ -0,0 +1,755 @@
+#include "../include/value_log.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <iterator>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace kademlia {
+
+namespace {
+
+// Bytes of one footer index entry: type, flags, key, publisher, three times, offset and length
+constexpr size_t FOOTER_ENTRY_SIZE = 1 + 1 + KEY_BYTES + KEY_BYTES + 8 + 8 + 8 + 4 + 4;
+
+// Record flag: the value is a cached copy
+constexpr uint8_t RECORD_FLAG_CACHED = 0x01;
+
+// Bytes of the trailer ending a sealed segment: magic, entry count, index offset and index checksum
+constexpr size_t TRAILER_SIZE = 4 + 4 + 8 + 4;
+
+constexpr uint32_t TRAILER_MAGIC = 0x4B564C46;
+
+const char SEGMENT_PREFIX[] = "segment-";
+const char SEGMENT_SUFFIX[] = ".log";
+
+// CRC-32C (Castagnoli) lookup tables for slicing by 8 bytes
+struct CRCTables {
+    std::array<std::array<uint32_t, 256>, 8> table;
+
+    CRCTables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+            }
+            table[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (size_t slice = 1; slice < 8; ++slice) {
+                table[slice][i] = (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+const CRCTables crcTables;
+
+uint32_t crc32c(const uint8_t* data, size_t length) {
+    const auto& t = crcTables.table;
+    uint32_t crc = 0xFFFFFFFF;
+
+    while (length >= 8) {
+        uint32_t low = crc ^ (static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+                              (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24));
+        crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+              t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+        data += 8;
+        length -= 8;
+    }
+    while (length-- > 0) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+    }
+
+    return crc ^ 0xFFFFFFFF;
+}
+
+inline uint8_t* putU32(uint8_t* out, uint32_t value) {
+    for (int i = 3; i >= 0; --i) {
+        *out++ = static_cast<uint8_t>(value >> (i * 8));
+    }
+    return out;
+}
+
+inline uint8_t* putU64(uint8_t* out, uint64_t value) {
+    for (int i = 7; i >= 0; --i) {
+        *out++ = static_cast<uint8_t>(value >> (i * 8));
+    }
+    return out;
+}
+
+inline uint32_t getU32(const uint8_t* in) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+inline uint64_t getU64(const uint8_t* in) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+// Write the fields a record header and a footer entry share: type, flags, key, publisher and times
+uint8_t* putMeta(uint8_t* out, LogRecordType type, const KeyHash& key, const LogRecordMeta& meta) {
+    *out++ = static_cast<uint8_t>(type);
+    *out++ = meta.cached ? RECORD_FLAG_CACHED : 0;
+    key.copyTo(out);
+    out += KEY_BYTES;
+    meta.publisher.copyTo(out);
+    out += KEY_BYTES;
+    out = putU64(out, meta.storedMs);
+    out = putU64(out, meta.ttlMs);
+    return putU64(out, meta.expiresMs);
+}
+
+const uint8_t* getMeta(const uint8_t* in, LogRecordType& type, KeyHash& key, LogRecordMeta& meta) {
+    type = static_cast<LogRecordType>(*in++);
+    meta.cached = (*in++ & RECORD_FLAG_CACHED) != 0;
+    key = NodeID::fromBytes(in);
+    in += KEY_BYTES;
+    meta.publisher = NodeID::fromBytes(in);
+    in += KEY_BYTES;
+    meta.storedMs = getU64(in);
+    meta.ttlMs = getU64(in + 8);
+    meta.expiresMs = getU64(in + 16);
+    return in + 24;
+}
+
+bool validType(LogRecordType type) {
+    return type == LogRecordType::PUT || type == LogRecordType::ERASE;
+}
+
+bool writeAll(int fd, const uint8_t* data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        ssize_t written = pwrite(fd, data, length, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        length -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+    return true;
+}
+
+bool readAll(int fd, uint8_t* data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        ssize_t count = pread(fd, data, length, static_cast<off_t>(offset));
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (count == 0) {
+            return false;
+        }
+        data += count;
+        length -= static_cast<size_t>(count);
+        offset += static_cast<uint64_t>(count);
+    }
+    return true;
+}
+
+std::string segmentPath(const std::string& directory, uint32_t id) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%s%08u%s", SEGMENT_PREFIX, id, SEGMENT_SUFFIX);
+    return directory + "/" + name;
+}
+
+// Parse a segment ID from a file name; returns false for other files
+bool parseSegmentName(const char* name, uint32_t& id) {
+    size_t prefixLength = sizeof(SEGMENT_PREFIX) - 1;
+    size_t suffixLength = sizeof(SEGMENT_SUFFIX) - 1;
+    size_t length = std::strlen(name);
+    if (length != prefixLength + 8 + suffixLength || std::strncmp(name, SEGMENT_PREFIX, prefixLength) != 0 ||
+        std::strcmp(name + prefixLength + 8, SEGMENT_SUFFIX) != 0) {
+        return false;
+    }
+
+    id = 0;
+    for (size_t i = prefixLength; i < prefixLength + 8; ++i) {
+        if (name[i] < '0' || name[i] > '9') {
+            return false;
+        }
+        id = id * 10 + static_cast<uint32_t>(name[i] - '0');
+    }
+    return true;
+}
+
+} // namespace
+
+ValueLog::Segment::~Segment() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+ValueLog::ValueLog(const ValueLogOptions& options)
+    : options_(options), snapshot_(std::make_shared<const SegmentMap>()), nextSegmentID_(1), dirty_(false),
+      directoryDirty_(false), sealRequested_(false), running_(false), syncs_(0), compactedSegments_(0),
+      recoveryBytes_(0) {
+}
+
+ValueLog::~ValueLog() {
+    close();
+}
+
+bool ValueLog::open(const std::string& directory, const LogRecoveryVisitor& visitor,
+                    const std::function<void(size_t records)>& expect) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_ || !segments_.empty()) {
+            return false;
+        }
+    }
+
+    // Nothing else uses the log until it is open, and the visitor may call release(), so recovery runs
+    // without the lock
+    directory_ = directory;
+    if (mkdir(directory_.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cerr << "Cannot create storage directory " << directory_ << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Find the segment files and load them oldest first, so later records override earlier ones
+    DIR* dir = opendir(directory_.c_str());
+    if (dir == nullptr) {
+        std::cerr << "Cannot open storage directory " << directory_ << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    std::vector<uint32_t> ids;
+    while (dirent* entry = readdir(dir)) {
+        uint32_t id = 0;
+        if (parseSegmentName(entry->d_name, id)) {
+            ids.push_back(id);
+        }
+    }
+    closedir(dir);
+    std::sort(ids.begin(), ids.end());
+
+    // Open every segment first and register it, so the visitor may release records in any of them
+    std::vector<SegmentPtr> found;
+    size_t expected = 0;
+    for (uint32_t id : ids) {
+        auto segment = std::make_shared<Segment>();
+        segment->id = id;
+        segment->path = segmentPath(directory_, id);
+        segment->fd = ::open(segment->path.c_str(), O_RDWR | O_CLOEXEC);
+        if (segment->fd < 0) {
+            std::cerr << "Cannot open segment " << segment->path << ": " << std::strerror(errno) << std::endl;
+            std::lock_guard<std::mutex> lock(mutex_);
+            segments_.clear();
+            publishSegments();
+            return false;
+        }
+
+        uint32_t count = 0;
+        uint64_t indexOffset = 0;
+        uint32_t checksum = 0;
+        if (readTrailer(*segment, count, indexOffset, checksum)) {
+            expected += count;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        segments_[id] = segment;
+        found.push_back(segment);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        publishSegments();
+    }
+    if (expect) {
+        expect(expected);
+    }
+
+    recoveryBytes_ = 0;
+    for (const SegmentPtr& segment : found) {
+        uint32_t id = segment->id;
+        if (!recoverSegment(segment, visitor)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            segments_.clear();
+            publishSegments();
+            return false;
+        }
+        nextSegmentID_ = id + 1;
+
+        // A segment that never got a record is of no use
+        if (segment->size == 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            unlink(segment->path.c_str());
+            segments_.erase(id);
+            publishSegments();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    active_ = createSegment();
+    if (!active_) {
+        segments_.clear();
+        publishSegments();
+        return false;
+    }
+
+    running_ = true;
+    syncThread_ = std::thread(&ValueLog::runSync, this);
+    return true;
+}
+
+void ValueLog::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+    }
+    syncWake_.notify_all();
+    if (syncThread_.joinable()) {
+        syncThread_.join();
+    }
+
+    // Seal the segments the sync thread had not reached yet
+    sync();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Seal the active segment so the next open reads its footer instead of its records
+    if (active_) {
+        if (active_->size == 0) {
+            unlink(active_->path.c_str());
+            segments_.erase(active_->id);
+        } else {
+            writeFooter(*active_, activeEntries_);
+            active_->sealed = true;
+        }
+    }
+
+    active_.reset();
+    activeEntries_.clear();
+    pendingSeals_.clear();
+    segments_.clear();
+    publishSegments();
+}
+
+bool ValueLog::append(LogRecordType type, const KeyHash& key, const LogRecordMeta& meta, ByteSpan value,
+                      ValueLocation& location) {
+    size_t length = VALUE_LOG_RECORD_HEADER_SIZE + value.size;
+    if (length > UINT32_MAX) {
+        return false;
+    }
+
+    // Encode and checksum the record before taking the lock, which only orders the writes
+    // checksum(4) type(1) flags(1) key(20) publisher(20) storedMs(8) ttlMs(8) expiresMs(8) valueLength(4) value
+    thread_local std::vector<uint8_t> buffer;
+    buffer.resize(length);
+    uint8_t* out = putMeta(buffer.data() + 4, type, key, meta);
+    out = putU32(out, static_cast<uint32_t>(value.size));
+    if (value.size > 0) {
+        std::memcpy(out, value.data, value.size);
+    }
+    putU32(buffer.data(), crc32c(buffer.data() + 4, length - 4));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_) {
+        return false;
+    }
+
+    // Start a new segment rather than let this one pass its size, unless the record is alone in it
+    if (active_->size > 0 && active_->size + length > options_.segmentBytes) {
+        if (!rollSegment()) {
+            return false;
+        }
+    }
+
+    if (!writeAll(active_->fd, buffer.data(), length, active_->size)) {
+        return false;
+    }
+
+    location.segment = active_->id;
+    location.offset = static_cast<uint32_t>(active_->size);
+    location.length = static_cast<uint32_t>(length);
+    activeEntries_.push_back({type, key, meta, location.offset, location.length});
+    active_->size += length;
+    dirty_ = true;
+    return true;
+}
+
+bool ValueLog::read(const ValueLocation& location, std::vector<uint8_t>& value) const {
+    SegmentPtr segment = findSegment(location.segment);
+    if (!segment || location.length < VALUE_LOG_RECORD_HEADER_SIZE) {
+        return false;
+    }
+
+    // Read the whole record into a per-thread buffer to check it, then copy out the value
+    thread_local std::vector<uint8_t> buffer;
+    buffer.resize(location.length);
+    if (!readAll(segment->fd, buffer.data(), location.length, location.offset)) {
+        return false;
+    }
+    if (getU32(buffer.data()) != crc32c(buffer.data() + 4, location.length - 4)) {
+        std::cerr << "Checksum mismatch in " << segment->path << " at offset " << location.offset << std::endl;
+        return false;
+    }
+
+    uint32_t valueLength = getU32(buffer.data() + VALUE_LOG_RECORD_HEADER_SIZE - 4);
+    if (VALUE_LOG_RECORD_HEADER_SIZE + valueLength != location.length) {
+        return false;
+    }
+    value.assign(buffer.begin() + VALUE_LOG_RECORD_HEADER_SIZE, buffer.end());
+    return true;
+}
+
+void ValueLog::release(const ValueLocation& location) {
+    if (location.length == 0) {
+        return;
+    }
+
+    SegmentPtr segment = findSegment(location.segment);
+    if (segment) {
+        segment->deadBytes += location.length;
+    }
+}
+
+bool ValueLog::sync() {
+    // Wait for a sync in progress, which may have taken the records appended so far
+    std::lock_guard<std::mutex> syncLock(syncMutex_);
+
+    std::vector<PendingSeal> seals;
+    SegmentPtr segment;
+    bool directory = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        seals.swap(pendingSeals_);
+        sealRequested_ = false;
+        if (dirty_ && active_) {
+            segment = active_;
+            dirty_ = false;
+            syncs_++;
+        }
+        directory = directoryDirty_;
+        directoryDirty_ = false;
+    }
+
+    // Seal the full segments, which syncs their records along with the footer
+    std::vector<PendingSeal> failed;
+    for (auto& seal : seals) {
+        if (writeFooter(*seal.segment, seal.entries)) {
+            seal.segment->sealed = true;
+        } else {
+            failed.push_back(std::move(seal));
+        }
+    }
+    bool directorySynced = !directory || syncDirectory();
+    bool segmentSynced = !segment || fdatasync(segment->fd) == 0;
+
+    if (failed.empty() && directorySynced && segmentSynced) {
+        return true;
+    }
+
+    // Leave whatever failed to the next sync
+    std::lock_guard<std::mutex> lock(mutex_);
+    pendingSeals_.insert(pendingSeals_.begin(), std::make_move_iterator(failed.begin()),
+                         std::make_move_iterator(failed.end()));
+    directoryDirty_ = directoryDirty_ || !directorySynced;
+    dirty_ = dirty_ || !segmentSynced;
+    return false;
+}
+
+bool ValueLog::findCompactionCandidate(uint32_t& segment) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    double best = options_.compactionThreshold;
+    bool found = false;
+    for (const auto& entry : segments_) {
+        const Segment& candidate = *entry.second;
+        if (!candidate.sealed || candidate.size == 0) {
+            continue;
+        }
+
+        double dead = static_cast<double>(candidate.deadBytes.load()) / static_cast<double>(candidate.size);
+        if (dead >= best) {
+            best = dead;
+            segment = candidate.id;
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool ValueLog::forEachRecord(uint32_t id, const LogRecoveryVisitor& visitor) const {
+    SegmentPtr segment = findSegment(id);
+    if (!segment || !segment->sealed) {
+        return false;
+    }
+
+    std::vector<IndexEntry> entries;
+    uint64_t recordBytes = 0;
+    if (!readFooter(*segment, entries, recordBytes)) {
+        return false;
+    }
+
+    for (const auto& entry : entries) {
+        visitor(entry.type, entry.key, entry.meta, ValueLocation{id, entry.offset, entry.length});
+    }
+    return true;
+}
+
+void ValueLog::dropSegment(uint32_t id) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = segments_.find(id);
+        if (it == segments_.end() || it->second == active_) {
+            return;
+        }
+
+        // Readers holding the segment keep its file open until they finish
+        unlink(it->second->path.c_str());
+        segments_.erase(it);
+        publishSegments();
+        compactedSegments_++;
+    }
+
+    // Make the removal durable, so a restart cannot find the segment again after its records have moved on
+    syncDirectory();
+}
+
+ValueLogStats ValueLog::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    ValueLogStats stats;
+    stats.segments = segments_.size();
+    for (const auto& entry : segments_) {
+        stats.bytes += entry.second->size;
+        stats.deadBytes += entry.second->deadBytes;
+    }
+    stats.syncs = syncs_;
+    stats.compactedSegments = compactedSegments_;
+    stats.recoveryBytes = recoveryBytes_;
+    return stats;
+}
+
+bool ValueLog::recoverSegment(const SegmentPtr& segment, const LogRecoveryVisitor& visitor) {
+    std::vector<IndexEntry> entries;
+    uint64_t recordBytes = 0;
+
+    if (readFooter(*segment, entries, recordBytes)) {
+        segment->size = recordBytes;
+        segment->sealed = true;
+        recoveryBytes_ += entries.size() * FOOTER_ENTRY_SIZE + TRAILER_SIZE;
+    } else {
+        // No footer: the node stopped while this segment was active. Scan its records and keep those
+        // before the first one that is cut short or fails its checksum.
+        struct stat info;
+        if (fstat(segment->fd, &info) != 0) {
+            return false;
+        }
+        std::vector<uint8_t> bytes(static_cast<size_t>(info.st_size));
+        if (!bytes.empty() && !readAll(segment->fd, bytes.data(), bytes.size(), 0)) {
+            return false;
+        }
+        recoveryBytes_ += bytes.size();
+
+        uint64_t offset = 0;
+        while (offset + VALUE_LOG_RECORD_HEADER_SIZE <= bytes.size()) {
+            const uint8_t* record = bytes.data() + offset;
+            uint64_t length = VALUE_LOG_RECORD_HEADER_SIZE + getU32(record + VALUE_LOG_RECORD_HEADER_SIZE - 4);
+            if (offset + length > bytes.size() || getU32(record) != crc32c(record + 4, length - 4)) {
+                break;
+            }
+
+            IndexEntry entry;
+            getMeta(record + 4, entry.type, entry.key, entry.meta);
+            if (!validType(entry.type)) {
+                break;
+            }
+            entry.offset = static_cast<uint32_t>(offset);
+            entry.length = static_cast<uint32_t>(length);
+            entries.push_back(entry);
+            offset += length;
+        }
+
+        if (offset < bytes.size()) {
+            std::cerr << "Discarding " << bytes.size() - offset << " damaged bytes at the end of " << segment->path
+                      << std::endl;
+        }
+
+        // Seal it, so the next open reads only its footer
+        segment->size = offset;
+        if (!writeFooter(*segment, entries)) {
+            return false;
+        }
+        segment->sealed = true;
+    }
+
+    for (const auto& entry : entries) {
+        visitor(entry.type, entry.key, entry.meta, ValueLocation{segment->id, entry.offset, entry.length});
+    }
+    return true;
+}
+
+bool ValueLog::readTrailer(const Segment& segment, uint32_t& count, uint64_t& indexOffset, uint32_t& checksum) const {
+    struct stat info;
+    if (fstat(segment.fd, &info) != 0 || static_cast<uint64_t>(info.st_size) < TRAILER_SIZE) {
+        return false;
+    }
+    uint64_t fileSize = static_cast<uint64_t>(info.st_size);
+
+    // magic(4) count(4) indexOffset(8) indexChecksum(4)
+    uint8_t trailer[TRAILER_SIZE];
+    if (!readAll(segment.fd, trailer, TRAILER_SIZE, fileSize - TRAILER_SIZE) || getU32(trailer) != TRAILER_MAGIC) {
+        return false;
+    }
+    count = getU32(trailer + 4);
+    indexOffset = getU64(trailer + 8);
+    checksum = getU32(trailer + 16);
+
+    // The index must fill the space between the records and the trailer
+    return indexOffset + static_cast<uint64_t>(count) * FOOTER_ENTRY_SIZE + TRAILER_SIZE == fileSize;
+}
+
+bool ValueLog::readFooter(const Segment& segment, std::vector<IndexEntry>& entries, uint64_t& recordBytes) const {
+    uint32_t count = 0;
+    uint64_t indexOffset = 0;
+    uint32_t checksum = 0;
+    if (!readTrailer(segment, count, indexOffset, checksum)) {
+        return false;
+    }
+    uint64_t indexBytes = static_cast<uint64_t>(count) * FOOTER_ENTRY_SIZE;
+
+    std::vector<uint8_t> index(static_cast<size_t>(indexBytes));
+    if (!index.empty() && !readAll(segment.fd, index.data(), index.size(), indexOffset)) {
+        return false;
+    }
+    if (crc32c(index.data(), index.size()) != checksum) {
+        return false;
+    }
+
+    // type(1) flags(1) key(20) publisher(20) storedMs(8) ttlMs(8) expiresMs(8) offset(4) length(4)
+    entries.resize(count);
+    const uint8_t* in = index.data();
+    for (auto& entry : entries) {
+        in = getMeta(in, entry.type, entry.key, entry.meta);
+        entry.offset = getU32(in);
+        entry.length = getU32(in + 4);
+        in += 8;
+        if (!validType(entry.type) || static_cast<uint64_t>(entry.offset) + entry.length > indexOffset) {
+            return false;
+        }
+    }
+
+    recordBytes = indexOffset;
+    return true;
+}
+
+bool ValueLog::writeFooter(Segment& segment, const std::vector<IndexEntry>& entries) {
+    std::vector<uint8_t> footer(entries.size() * FOOTER_ENTRY_SIZE + TRAILER_SIZE);
+
+    uint8_t* out = footer.data();
+    for (const auto& entry : entries) {
+        out = putMeta(out, entry.type, entry.key, entry.meta);
+        out = putU32(out, entry.offset);
+        out = putU32(out, entry.length);
+    }
+    size_t indexBytes = entries.size() * FOOTER_ENTRY_SIZE;
+    out = putU32(out, TRAILER_MAGIC);
+    out = putU32(out, static_cast<uint32_t>(entries.size()));
+    out = putU64(out, segment.size);
+    putU32(out, crc32c(footer.data(), indexBytes));
+
+    // Anything past the records, such as a damaged tail, is replaced by the footer
+    if (ftruncate(segment.fd, static_cast<off_t>(segment.size)) != 0 ||
+        !writeAll(segment.fd, footer.data(), footer.size(), segment.size) || fdatasync(segment.fd) != 0) {
+        std::cerr << "Cannot seal segment " << segment.path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool ValueLog::rollSegment() {
+    SegmentPtr next = createSegment();
+    if (!next) {
+        return false;
+    }
+
+    // The sync thread writes the footer, which also makes the segment's records durable, so neither this
+    // lock nor the caller's waits for the disk
+    pendingSeals_.push_back(PendingSeal{active_, std::move(activeEntries_)});
+    activeEntries_.clear();
+    active_ = next;
+    dirty_ = false;
+    sealRequested_ = true;
+    syncWake_.notify_one();
+    return true;
+}
+
+ValueLog::SegmentPtr ValueLog::createSegment() {
+    auto segment = std::make_shared<Segment>();
+    segment->id = nextSegmentID_++;
+    segment->path = segmentPath(directory_, segment->id);
+    segment->fd = ::open(segment->path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (segment->fd < 0) {
+        std::cerr << "Cannot create segment " << segment->path << ": " << std::strerror(errno) << std::endl;
+        return nullptr;
+    }
+
+    // The new file's directory entry is made durable with the first records in it
+    directoryDirty_ = true;
+
+    segments_[segment->id] = segment;
+    publishSegments();
+    return segment;
+}
+
+void ValueLog::publishSegments() {
+    std::atomic_store(&snapshot_, std::shared_ptr<const SegmentMap>(std::make_shared<SegmentMap>(segments_)));
+}
+
+ValueLog::SegmentPtr ValueLog::findSegment(uint32_t id) const {
+    std::shared_ptr<const SegmentMap> segments = std::atomic_load(&snapshot_);
+    auto it = segments->find(id);
+    return it != segments->end() ? it->second : nullptr;
+}
+
+bool ValueLog::syncDirectory() const {
+    int dir = ::open(directory_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir < 0) {
+        return false;
+    }
+    bool synced = fsync(dir) == 0;
+    ::close(dir);
+    return synced;
+}
+
+void ValueLog::runSync() {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (running_) {
+        syncWake_.wait_for(lock, options_.syncInterval, [this]() {
+            return !running_ || sealRequested_;
+        });
+
+        // One fdatasync covers every record appended since the last one; full segments are sealed at once
+        if ((dirty_ && active_) || directoryDirty_ || !pendingSeals_.empty()) {
+            lock.unlock();
+            sync();
+            lock.lock();
+        }
+    }
+}
+
+} // namespace kademlia
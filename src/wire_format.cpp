@@ -0,0 +1,338 @@
+#include "../include/wire_format.h"
+#include "../include/utils.h"
+#include <algorithm>
+#include <cstring>
+
+namespace kademlia {
+namespace wire {
+
+namespace {
+
+// Big-endian helpers writing into and reading from raw buffers
+
+inline uint8_t* putU16(uint8_t* out, uint16_t value) {
+    out[0] = static_cast<uint8_t>(value >> 8);
+    out[1] = static_cast<uint8_t>(value);
+    return out + 2;
+}
+
+inline uint8_t* putU32(uint8_t* out, uint32_t value) {
+    out[0] = static_cast<uint8_t>(value >> 24);
+    out[1] = static_cast<uint8_t>(value >> 16);
+    out[2] = static_cast<uint8_t>(value >> 8);
+    out[3] = static_cast<uint8_t>(value);
+    return out + 4;
+}
+
+inline uint8_t* putID(uint8_t* out, const NodeID& id) {
+    id.copyTo(out);
+    return out + KEY_BYTES;
+}
+
+inline uint16_t getU16(const uint8_t* in) {
+    return static_cast<uint16_t>((in[0] << 8) | in[1]);
+}
+
+inline uint32_t getU32(const uint8_t* in) {
+    return (static_cast<uint32_t>(in[0]) << 24) | (static_cast<uint32_t>(in[1]) << 16) |
+           (static_cast<uint32_t>(in[2]) << 8) | static_cast<uint32_t>(in[3]);
+}
+
+inline NodeID getID(const uint8_t* in) {
+    return NodeID::fromBytes(in);
+}
+
+} // namespace
+
+size_t encodeMessage(const RPCMessage& message, uint8_t* buffer, size_t capacity) {
+    size_t total = HEADER_SIZE + message.payload.size();
+    if (total > capacity || message.payload.size() > UINT32_MAX) {
+        return 0;
+    }
+
+    uint8_t* out = buffer;
+    *out++ = MAGIC;
+    *out++ = VERSION;
+    *out++ = static_cast<uint8_t>(message.type);
+    *out++ = message.isResponse ? FLAG_RESPONSE : 0;
+    out = putU32(out, message.transactionID);
+    out = putID(out, message.sender);
+    out = putID(out, message.receiver);
+    out = putU16(out, message.senderPort);
+    out = putU32(out, static_cast<uint32_t>(message.payload.size()));
+
+    if (!message.payload.empty()) {
+        std::memcpy(out, message.payload.data(), message.payload.size());
+    }
+
+    return total;
+}
+
+bool decodeMessage(const uint8_t* data, size_t length, RPCMessage& message) {
+    MessageView view;
+    if (!decodeMessage(data, length, view)) {
+        return false;
+    }
+
+    message.type = view.type;
+    message.isResponse = view.isResponse;
+    message.transactionID = view.transactionID;
+    message.sender = view.sender;
+    message.receiver = view.receiver;
+    message.senderPort = view.senderPort;
+    message.payload.assign(view.payload.begin(), view.payload.end());
+    return true;
+}
+
+bool decodeMessage(const uint8_t* data, size_t length, MessageView& message) {
+    if (length < HEADER_SIZE || data[0] != MAGIC || data[1] != VERSION) {
+        return false;
+    }
+
+    if (data[2] > static_cast<uint8_t>(RPCType::HOLE_PUNCH_RESPONSE)) {
+        return false;
+    }
+
+    const uint8_t* in = data;
+    message.type = static_cast<RPCType>(in[2]);
+    message.isResponse = (in[3] & FLAG_RESPONSE) != 0;
+    in += 4;
+    message.transactionID = getU32(in);
+    in += 4;
+    message.sender = getID(in);
+    in += KEY_BYTES;
+    message.receiver = getID(in);
+    in += KEY_BYTES;
+    message.senderPort = getU16(in);
+    in += 2;
+    uint32_t payloadLength = getU32(in);
+    in += 4;
+
+    // The payload must exactly fill the rest of the datagram
+    if (payloadLength != length - HEADER_SIZE) {
+        return false;
+    }
+
+    message.payload = ByteSpan(in, payloadLength);
+    return true;
+}
+
+uint8_t frameKind(const uint8_t* data, size_t length) {
+    if (length < 3 || data[0] != MAGIC || data[1] != VERSION) {
+        return 0;
+    }
+    return data[2] == FRAME_FRAGMENT || data[2] == FRAME_FRAGMENT_ACK ? data[2] : 0;
+}
+
+size_t encodeFragment(const FragmentHeader& header, const uint8_t* chunk, size_t length,
+                      uint8_t* buffer, size_t capacity) {
+    size_t total = FRAGMENT_HEADER_SIZE + length;
+    if (total > capacity) {
+        return 0;
+    }
+
+    uint8_t* out = buffer;
+    *out++ = MAGIC;
+    *out++ = VERSION;
+    *out++ = FRAME_FRAGMENT;
+    *out++ = 0;
+    out = putU32(out, header.messageID);
+    out = putU32(out, header.totalLength);
+    out = putU32(out, header.index);
+    out = putU16(out, header.fragmentSize);
+
+    if (length > 0) {
+        std::memcpy(out, chunk, length);
+    }
+
+    return total;
+}
+
+bool decodeFragment(const uint8_t* data, size_t length, FragmentHeader& header, ByteSpan& chunk) {
+    if (length < FRAGMENT_HEADER_SIZE || frameKind(data, length) != FRAME_FRAGMENT) {
+        return false;
+    }
+
+    const uint8_t* in = data + 4;
+    header.messageID = getU32(in);
+    header.totalLength = getU32(in + 4);
+    header.index = getU32(in + 8);
+    header.fragmentSize = getU16(in + 12);
+
+    if (header.fragmentSize == 0 || header.totalLength == 0) {
+        return false;
+    }
+
+    // The fragment must start inside the message and be full-sized unless it is the last one
+    uint64_t offset = static_cast<uint64_t>(header.index) * header.fragmentSize;
+    if (offset >= header.totalLength) {
+        return false;
+    }
+
+    size_t expected = static_cast<size_t>(std::min<uint64_t>(header.fragmentSize, header.totalLength - offset));
+    if (length - FRAGMENT_HEADER_SIZE != expected) {
+        return false;
+    }
+
+    chunk = ByteSpan(data + FRAGMENT_HEADER_SIZE, expected);
+    return true;
+}
+
+size_t encodeFragmentAck(uint32_t messageID, uint32_t contiguous, const uint8_t* bitmap, size_t bitmapLength,
+                         uint8_t* buffer, size_t capacity) {
+    size_t total = FRAGMENT_ACK_HEADER_SIZE + bitmapLength;
+    if (total > capacity) {
+        return 0;
+    }
+
+    uint8_t* out = buffer;
+    *out++ = MAGIC;
+    *out++ = VERSION;
+    *out++ = FRAME_FRAGMENT_ACK;
+    *out++ = 0;
+    out = putU32(out, messageID);
+    out = putU32(out, contiguous);
+
+    if (bitmapLength > 0) {
+        std::memcpy(out, bitmap, bitmapLength);
+    }
+
+    return total;
+}
+
+bool decodeFragmentAck(const uint8_t* data, size_t length, uint32_t& messageID, uint32_t& contiguous,
+                       ByteSpan& bitmap) {
+    if (length < FRAGMENT_ACK_HEADER_SIZE || frameKind(data, length) != FRAME_FRAGMENT_ACK) {
+        return false;
+    }
+
+    messageID = getU32(data + 4);
+    contiguous = getU32(data + 8);
+    bitmap = ByteSpan(data + FRAGMENT_ACK_HEADER_SIZE, length - FRAGMENT_ACK_HEADER_SIZE);
+    return true;
+}
+
+void encodeStorePayload(const KeyHash& key, ByteSpan value, uint32_t ttlSeconds, uint8_t flags,
+                        std::vector<uint8_t>& payload) {
+    payload.clear();
+    appendStoreRecord(key, value, ttlSeconds, flags, payload);
+}
+
+void appendStoreRecord(const KeyHash& key, ByteSpan value, uint32_t ttlSeconds, uint8_t flags,
+                       std::vector<uint8_t>& payload) {
+    // key(20) ttl(4) flags(1) valueLength(4) value
+    size_t offset = payload.size();
+    payload.resize(offset + STORE_RECORD_HEADER_SIZE + value.size);
+
+    uint8_t* out = payload.data() + offset;
+    out = putID(out, key);
+    out = putU32(out, ttlSeconds);
+    *out++ = flags;
+    out = putU32(out, static_cast<uint32_t>(value.size));
+    if (value.size > 0) {
+        std::memcpy(out, value.data, value.size);
+    }
+}
+
+bool decodeStoreRecord(ByteSpan& payload, KeyHash& key, ByteSpan& value, uint32_t& ttlSeconds, uint8_t& flags) {
+    if (payload.size < STORE_RECORD_HEADER_SIZE) {
+        return false;
+    }
+
+    const uint8_t* in = payload.data;
+    uint32_t valueLength = getU32(in + KEY_BYTES + 5);
+    if (payload.size - STORE_RECORD_HEADER_SIZE < valueLength) {
+        return false;
+    }
+
+    key = getID(in);
+    ttlSeconds = getU32(in + KEY_BYTES);
+    flags = in[KEY_BYTES + 4];
+    value = ByteSpan(in + STORE_RECORD_HEADER_SIZE, valueLength);
+
+    size_t consumed = STORE_RECORD_HEADER_SIZE + valueLength;
+    payload = ByteSpan(payload.data + consumed, payload.size - consumed);
+    return true;
+}
+
+void encodeContacts(const std::vector<NodePtr>& nodes, std::vector<uint8_t>& payload) {
+    size_t count = std::min<size_t>(nodes.size(), UINT8_MAX);
+    payload.resize(1 + count * CONTACT_SIZE);
+
+    uint8_t* out = payload.data();
+    *out++ = static_cast<uint8_t>(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        const NodePtr& node = nodes[i];
+        out = putID(out, node->getID());
+
+        uint32_t ip = 0;
+        utils::ipToBinary(node->getIP(), ip);
+        std::memcpy(out, &ip, 4); // Already in network byte order
+        out += 4;
+        out = putU16(out, node->getPort());
+    }
+}
+
+void encodeContacts(const std::vector<Contact>& contacts, std::vector<uint8_t>& payload) {
+    size_t count = std::min<size_t>(contacts.size(), UINT8_MAX);
+    payload.resize(1 + count * CONTACT_SIZE);
+
+    uint8_t* out = payload.data();
+    *out++ = static_cast<uint8_t>(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        const Contact& contact = contacts[i];
+        out = putID(out, contact.id);
+        std::memcpy(out, &contact.ip, 4); // Already in network byte order
+        out += 4;
+        out = putU16(out, contact.port);
+    }
+}
+
+bool decodeContacts(ByteSpan payload, std::vector<NodePtr>& nodes) {
+    if (payload.empty()) {
+        return false;
+    }
+
+    size_t count = payload.data[0];
+    if (payload.size != 1 + count * CONTACT_SIZE) {
+        return false;
+    }
+
+    nodes.clear();
+    nodes.reserve(count);
+
+    const uint8_t* in = payload.data + 1;
+    for (size_t i = 0; i < count; ++i) {
+        NodeID id = getID(in);
+        in += KEY_BYTES;
+
+        uint32_t ip;
+        std::memcpy(&ip, in, 4);
+        in += 4;
+
+        uint16_t port = getU16(in);
+        in += 2;
+
+        nodes.push_back(std::make_shared<Node>(id, utils::binaryToIP(ip), port));
+    }
+
+    return true;
+}
+
+void encodeNodeID(const NodeID& id, std::vector<uint8_t>& payload) {
+    payload.resize(KEY_BYTES);
+    putID(payload.data(), id);
+}
+
+bool decodeNodeID(ByteSpan payload, NodeID& id) {
+    if (payload.size != KEY_BYTES) {
+        return false;
+    }
+    id = getID(payload.data);
+    return true;
+}
+
+} // namespace wire
+} // namespace kademlia